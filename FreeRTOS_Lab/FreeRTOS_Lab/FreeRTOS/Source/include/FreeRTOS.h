@@ -235,6 +235,38 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 #endif
 
 
+#ifndef configUSE_HEAP_POOL
+	#define configUSE_HEAP_POOL 0
+#endif
+
+#ifndef configUSE_OPTIMISED_TASK_SELECTION
+	#define configUSE_OPTIMISED_TASK_SELECTION 0
+#endif
+
+#ifndef configUSE_TIMING_WHEEL
+	#define configUSE_TIMING_WHEEL 0
+#endif
+
+#ifndef configTIMING_WHEEL_SLOTS
+	#define configTIMING_WHEEL_SLOTS 16
+#endif
+
+#ifndef configUSE_TICKLESS_IDLE
+	#define configUSE_TICKLESS_IDLE 0
+#endif
+
+#ifndef configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+	#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP 2
+#endif
+
+#if configEXPECTED_IDLE_TIME_BEFORE_SLEEP < 2
+	#error configEXPECTED_IDLE_TIME_BEFORE_SLEEP must not be less than 2
+#endif
+
+#ifndef portSUPPRESS_TICKS_AND_SLEEP
+	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )
+#endif
+
 #ifndef portSET_INTERRUPT_MASK_FROM_ISR
 	#define portSET_INTERRUPT_MASK_FROM_ISR() 0
 #endif
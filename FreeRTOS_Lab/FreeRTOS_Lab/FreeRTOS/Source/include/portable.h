@@ -87,6 +87,10 @@
 	#include "../portable/GCC/ATMega323/portmacro.h"
 #endif
 
+#ifdef POSIX_SIM
+	#include "../portable/GCC/Posix_Sim/portmacro.h"
+#endif
+
 #ifdef IAR_MEGA_AVR
 	#include "../portable/IAR/ATMega323/portmacro.h"
 #endif
@@ -370,6 +374,26 @@ void vPortFree( void *pv ) PRIVILEGED_FUNCTION;
 void vPortInitialiseBlocks( void ) PRIVILEGED_FUNCTION;
 size_t xPortGetFreeHeapSize( void ) PRIVILEGED_FUNCTION;
 
+#if ( configUSE_HEAP_POOL == 1 )
+
+/* Occupancy of one heap_pool.c size class. */
+typedef struct xHEAP_CLASS_STATS
+{
+	unsigned short usBlockSize;		/* Bytes per block. */
+	unsigned char ucBlocks;			/* Blocks in the class. */
+	unsigned char ucInUse;			/* Blocks currently allocated. */
+	unsigned char ucMostInUse;		/* High-water mark of ucInUse. */
+	unsigned short usSpilled;		/* Allocations served here because a smaller class was full. */
+	unsigned short usFailed;		/* Requests that fit this class but found no free block in it or above. */
+} xHeapClassStats;
+
+size_t xPortGetMinimumEverFreeHeapSize( void ) PRIVILEGED_FUNCTION;
+unsigned portBASE_TYPE uxPortGetHeapClassCount( void ) PRIVILEGED_FUNCTION;
+void vPortGetHeapClassStats( unsigned portBASE_TYPE uxClass, xHeapClassStats *pxStats ) PRIVILEGED_FUNCTION;
+unsigned short usPortGetFailedAllocations( void ) PRIVILEGED_FUNCTION;
+
+#endif
+
 /*
  * Setup the hardware ready for the scheduler to take control.  This generally
  * sets up a tick interrupt and sets timers for the correct tick frequency.
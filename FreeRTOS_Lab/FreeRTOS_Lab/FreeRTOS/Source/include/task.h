@@ -131,6 +131,19 @@ typedef struct xTASK_PARAMTERS
 	xMemoryRegion xRegions[ portNUM_CONFIGURABLE_REGIONS ];
 } xTaskParameters;
 
+/*
+ * One task's entry in the table filled by uxTaskGetRunTimeRecords().
+ */
+typedef struct xTASK_RUN_TIME_RECORD
+{
+	signed char pcTaskName[ configMAX_TASK_NAME_LEN ];
+	unsigned long ulRunTimeCounter;			/* Run time counter counts spent running. */
+	unsigned long ulSwitchInCount;			/* Times the task was switched in from another task. */
+	unsigned short usStackHighWaterMark;	/* Least free stack so far, in portSTACK_TYPE units. */
+	unsigned char ucPriority;
+	signed char cState;						/* 'R'eady, 'B'locked, 'D'eleted or 'S'uspended. */
+} xTaskRunTimeRecord;
+
 /*
  * Defines the priority used by the idle task.  This must not be modified.
  *
@@ -1085,6 +1098,34 @@ void vTaskList( signed char *pcWriteBuffer ) PRIVILEGED_FUNCTION;
  */
 void vTaskGetRunTimeStats( signed char *pcWriteBuffer ) PRIVILEGED_FUNCTION;
 
+/**
+ * task. h
+ * <PRE>unsigned portBASE_TYPE uxTaskGetRunTimeRecords( xTaskRunTimeRecord *pxRecords, unsigned portBASE_TYPE uxMaxRecords, unsigned long *pulTotalRunTime );</PRE>
+ *
+ * configGENERATE_RUN_TIME_STATS must be defined as 1 for this function
+ * to be available.  The stack high water marks are only filled in if
+ * INCLUDE_uxTaskGetStackHighWaterMark is also 1, else they are 0.
+ *
+ * Binary equivalent of vTaskGetRunTimeStats() for targets that cannot
+ * afford sprintf() or a text buffer: one xTaskRunTimeRecord is written per
+ * task, leaving the formatting to whoever reads them.  The scheduler is
+ * suspended, but interrupts are left enabled, while the table is filled.
+ *
+ * @param pxRecords Table to fill, one record per task.
+ *
+ * @param uxMaxRecords Size of pxRecords.  Tasks beyond it are left out.
+ *
+ * @param pulTotalRunTime Set to the run time counter value at the time the
+ * table was filled.  Each task's share of the CPU is its ulRunTimeCounter
+ * divided by this.
+ *
+ * @return The number of records written.
+ *
+ * \page uxTaskGetRunTimeRecords uxTaskGetRunTimeRecords
+ * \ingroup TaskUtils
+ */
+unsigned portBASE_TYPE uxTaskGetRunTimeRecords( xTaskRunTimeRecord *pxRecords, unsigned portBASE_TYPE uxMaxRecords, unsigned long *pulTotalRunTime ) PRIVILEGED_FUNCTION;
+
 /**
  * task. h
  * <PRE>void vTaskStartTrace( char * pcBuffer, unsigned portBASE_TYPE uxBufferSize );</PRE>
@@ -1326,6 +1367,53 @@ unsigned portBASE_TYPE uxTaskGetTaskNumber( xTaskHandle xTask );
  */
 void vTaskSetTaskNumber( xTaskHandle xTask, unsigned portBASE_TYPE uxHandle );
 
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+/* Returned by eTaskConfirmSleepModeStatus(). */
+typedef enum
+{
+	eAbortSleep = 0,		/* A task has been made ready or a context switch pended since portSUPPRESS_TICKS_AND_SLEEP() was called - abort entering a sleep mode. */
+	eStandardSleep			/* Enter a sleep mode that will not last any longer than the expected idle time. */
+} eSleepModeStatus;
+
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS ONLY
+ * INTENDED FOR USE WHEN IMPLEMENTING A PORT OF THE SCHEDULER AND IS
+ * AN INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE SCHEDULER.
+ *
+ * Called by the port's portSUPPRESS_TICKS_AND_SLEEP() implementation, with
+ * interrupts disabled, to move the tick count on by the number of whole tick
+ * periods that passed while the tick interrupt was suppressed.  The caller
+ * must not step past the expected idle time it was given.
+ */
+void vTaskStepTick( portTickType xTicksToJump ) PRIVILEGED_FUNCTION;
+
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS ONLY
+ * INTENDED FOR USE WHEN IMPLEMENTING A PORT OF THE SCHEDULER AND IS
+ * AN INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE SCHEDULER.
+ *
+ * Called with interrupts disabled while the idle task is the running task.
+ * Returns the number of tick periods before a delayed task is due to wake,
+ * which may be passed to vTaskStepTick() less one, or 0 if the next tick
+ * must be processed.
+ */
+portTickType xTaskGetExpectedIdleTime( void ) PRIVILEGED_FUNCTION;
+
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS ONLY
+ * INTENDED FOR USE WHEN IMPLEMENTING A PORT OF THE SCHEDULER AND IS
+ * AN INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE SCHEDULER.
+ *
+ * Called by the port's portSUPPRESS_TICKS_AND_SLEEP() implementation, with
+ * interrupts disabled, as the last check before sleeping.  Returns
+ * eAbortSleep if an interrupt readied a task, requested a context switch or
+ * delivered a tick after the idle task decided to sleep.
+ */
+eSleepModeStatus eTaskConfirmSleepModeStatus( void ) PRIVILEGED_FUNCTION;
+
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -130,6 +130,14 @@ extern void vPortYield( void ) __attribute__ ( ( naked ) );
 #define portYIELD()					vPortYield()
 /*-----------------------------------------------------------*/
 
+/* Tickless idle.  Timer 1 is reprogrammed to sleep through up to ~0.5s of
+idle ticks in IDLE sleep mode; see vPortSuppressTicksAndSleep() in port.c. */
+#if ( configUSE_TICKLESS_IDLE != 0 )
+	extern void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime );
+	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+/*-----------------------------------------------------------*/
+
 /* Task function macros as described on the FreeRTOS.org WEB site. */
 #define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
 #define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
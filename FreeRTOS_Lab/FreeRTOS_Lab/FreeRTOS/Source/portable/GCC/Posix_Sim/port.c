@@ -0,0 +1,534 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+	
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+/*
+ * Linux host simulation port.  See portmacro.h.
+ *
+ * Each task runs on a ucontext with its own host stack.  The tick is
+ * SIGALRM from an interval timer; masking SIGALRM is "disabling interrupts".
+ * A context switch from the tick happens inside the signal handler: the
+ * interrupted task's context is saved with swapcontext() and the handler
+ * returns only when that task is resumed.
+ *
+ * Every switch is made with SIGALRM blocked and every saved context has it
+ * blocked, so swapcontext() never changes the mask.  (It sets the mask
+ * before loading the new registers; a tick in between would run on the old
+ * stack as the new task.)  The resumed code unblocks it itself: the handler
+ * by returning, vPortYield() by leaving its critical section and a new task
+ * in prvTaskStart().
+ *
+ * The tick handler also steps the emulated AVR peripherals in Sim/sim_io.c,
+ * whose ISRs then run in the handler as they would in interrupt context.
+ * While the firmware has cleared the SREG I bit with cli(), ticks are held
+ * pending and caught up at the first tick after sei().
+ *
+ * With SIM_VIRTUAL set there is no timer.  Whenever only the idle task is
+ * left to run, prvSwitchContext() steps the ticks itself until a task wakes.
+ * It jumps over the ticks before the next task is due to wake
+ * (vTaskStepTick()) in which the peripherals have nothing to do
+ * (Sim_SkipTicks()), so time the firmware would spend idle costs only the
+ * ticks that do something.  Busy waits advance time through Sim_Micros(),
+ * which raises the tick.
+ *
+ * CPU time is accounted per task for vPortSimReportTasks() in simulated time
+ * (Sim_Now()), which is host time unless SIM_VIRTUAL is set; time spent
+ * stepping idle ticks is charged to the idle task.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <avr/io.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sim.h"
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the host simulation.
+ *----------------------------------------------------------*/
+
+/* Host stack per task.  The firmware's stack sizes are tuned for AVR code
+and cannot hold host frames, so they only reserve FreeRTOS heap. */
+#define portSIM_STACK_SIZE					( 64 * 1024 )
+
+/* SREG global interrupt enable bit. */
+#define portSREG_I							( ( unsigned char ) 0x80 )
+
+/* Tasks listed by vPortSimReportTasks(). */
+#define portSIM_MAX_TASKS					16
+
+typedef struct xSIM_TASK
+{
+	ucontext_t xContext;
+	unsigned portBASE_TYPE uxCriticalNesting;
+	pdTASK_CODE pxCode;
+	void *pvParameters;
+	xTaskHandle xHandle;				/* Set when the task first runs. */
+	unsigned long long ullRunUs;		/* Simulated time spent running. */
+	unsigned long ulSwitchesIn;
+	unsigned char ucStack[ portSIM_STACK_SIZE ];
+} xSimTask;
+
+/* We require the address of the pxCurrentTCB variable, but don't want to know
+any details of its type. */
+typedef void tskTCB;
+extern volatile tskTCB * volatile pxCurrentTCB;
+
+/* The first member of the TCB, pxTopOfStack, points to the task's xSimTask. */
+#define portCURRENT_SIM_TASK()				( *( xSimTask * volatile * ) pxCurrentTCB )
+
+/* Critical nesting of the running task; saved in its xSimTask while it is
+switched out. */
+static unsigned portBASE_TYPE uxCriticalNesting = 0;
+
+/* Non-zero while the tick handler runs emulated ISRs. */
+static volatile portBASE_TYPE xInterruptNesting = 0;
+
+/* Set by a yield from an ISR; the switch is made when the handler ends. */
+static volatile portBASE_TYPE xYieldPending = pdFALSE;
+
+/* Ticks that arrived while the SREG I bit was clear. */
+static volatile unsigned long ulPendingTicks = 0;
+
+/* Where vPortEndScheduler() returns to. */
+static ucontext_t xSchedulerContext;
+
+/* Ticks are stepped by prvSwitchContext() instead of a timer. */
+static portBASE_TYPE xVirtualTime = pdFALSE;
+
+/* Simulated time of the last switch, and the tasks for the report. */
+static unsigned long ulLastSwitchUs = 0;
+static xSimTask *pxSimTasks[ portSIM_MAX_TASKS ];
+static unsigned portBASE_TYPE uxSimTasks = 0;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Blocks or unblocks the tick signal for the calling context.
+ */
+static void prvMaskInterrupts( int iHow );
+
+/*
+ * Selects the next task and, if it differs, switches to it.  Must be called
+ * with the tick signal blocked.
+ */
+static void prvSwitchContext( void );
+
+/*
+ * Entry point of every task context.
+ */
+static void prvTaskStart( void );
+
+/*
+ * The tick: steps the peripherals and the kernel, then switches task if
+ * required.
+ */
+static void prvTickSignalHandler( int iSignal );
+
+/*
+ * Virtual time: steps ticks while the idle task is the only one to run.
+ */
+static void prvStepIdleTicks( void );
+
+/*-----------------------------------------------------------*/
+
+/* 
+ * See header file for description. 
+ */
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
+{
+xSimTask *pxTask;
+
+	/* The FreeRTOS allocated stack is not used. */
+	( void ) pxTopOfStack;
+
+	pxTask = ( xSimTask * ) malloc( sizeof( xSimTask ) );
+	if( pxTask == NULL )
+	{
+		abort();
+	}
+
+	getcontext( &( pxTask->xContext ) );
+	pxTask->xContext.uc_stack.ss_sp = pxTask->ucStack;
+	pxTask->xContext.uc_stack.ss_size = sizeof( pxTask->ucStack );
+	pxTask->xContext.uc_link = NULL;
+
+	/* Interrupts are enabled by prvTaskStart(). */
+	sigemptyset( &( pxTask->xContext.uc_sigmask ) );
+	sigaddset( &( pxTask->xContext.uc_sigmask ), SIGALRM );
+	pxTask->uxCriticalNesting = 0;
+	pxTask->pxCode = pxCode;
+	pxTask->pvParameters = pvParameters;
+	pxTask->xHandle = NULL;
+	pxTask->ullRunUs = 0;
+	pxTask->ulSwitchesIn = 0;
+	if( uxSimTasks < portSIM_MAX_TASKS )
+	{
+		pxSimTasks[ uxSimTasks++ ] = pxTask;
+	}
+	makecontext( &( pxTask->xContext ), prvTaskStart, 0 );
+
+	/* Becomes the TCB's pxTopOfStack. */
+	return ( portSTACK_TYPE * ) pxTask;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPortStartScheduler( void )
+{
+struct sigaction xAction;
+struct itimerval xTimer;
+unsigned long ulTickUs;
+
+	Sim_Init();
+	ulTickUs = Sim_TickPeriodUs();
+	xVirtualTime = Sim_Virtual() ? pdTRUE : pdFALSE;
+
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_handler = prvTickSignalHandler;
+	sigemptyset( &( xAction.sa_mask ) );
+	xAction.sa_flags = SA_RESTART;
+	sigaction( SIGALRM, &xAction, NULL );
+
+	if( xVirtualTime == pdFALSE )
+	{
+		xTimer.it_interval.tv_sec = ulTickUs / 1000000UL;
+		xTimer.it_interval.tv_usec = ulTickUs % 1000000UL;
+		xTimer.it_value = xTimer.it_interval;
+		setitimer( ITIMER_REAL, &xTimer, NULL );
+	}
+
+	/* Start the first task. */
+	uxCriticalNesting = 0;
+	ulLastSwitchUs = Sim_Now();
+	portCURRENT_SIM_TASK()->ulSwitchesIn++;
+	swapcontext( &xSchedulerContext, &( portCURRENT_SIM_TASK()->xContext ) );
+
+	/* Should not get here unless vTaskEndScheduler() is called. */
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval xTimer;
+
+	memset( &xTimer, 0, sizeof( xTimer ) );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+	setcontext( &xSchedulerContext );
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	if( xInterruptNesting != 0 )
+	{
+		/* taskYIELD() from an ISR. */
+		xYieldPending = pdTRUE;
+		return;
+	}
+
+	vPortEnterCritical();
+	prvSwitchContext();
+	vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	prvMaskInterrupts( SIG_BLOCK );
+	uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	if( uxCriticalNesting > 0 )
+	{
+		uxCriticalNesting--;
+
+		/* The handler keeps the signal blocked until it returns. */
+		if( ( uxCriticalNesting == 0 ) && ( xInterruptNesting == 0 ) )
+		{
+			prvMaskInterrupts( SIG_UNBLOCK );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	prvMaskInterrupts( SIG_BLOCK );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	if( xInterruptNesting == 0 )
+	{
+		prvMaskInterrupts( SIG_UNBLOCK );
+	}
+}
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime )
+	{
+	sigset_t xWaitMask;
+
+		/* Ticks are not suppressed; the host just sleeps until the next
+		one, which is handled as a missed tick of the suspended scheduler. */
+		( void ) xExpectedIdleTime;
+
+		prvMaskInterrupts( SIG_BLOCK );
+		if( eTaskConfirmSleepModeStatus() != eAbortSleep )
+		{
+			if( xVirtualTime != pdFALSE )
+			{
+				/* No timer to wait for: the tick is due now. */
+				raise( SIGALRM );
+			}
+			else
+			{
+				sigemptyset( &xWaitMask );
+				sigsuspend( &xWaitMask );
+			}
+		}
+		prvMaskInterrupts( SIG_UNBLOCK );
+	}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
+static void prvMaskInterrupts( int iHow )
+{
+sigset_t xSignals;
+
+	sigemptyset( &xSignals );
+	sigaddset( &xSignals, SIGALRM );
+	sigprocmask( iHow, &xSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+xSimTask *pxFrom = portCURRENT_SIM_TASK();
+xSimTask *pxTo;
+unsigned long ulNow = Sim_Now();
+
+	pxFrom->ullRunUs += ulNow - ulLastSwitchUs;
+	ulLastSwitchUs = ulNow;
+
+	vTaskSwitchContext();
+	if( xVirtualTime != pdFALSE )
+	{
+		prvStepIdleTicks();
+	}
+	pxTo = portCURRENT_SIM_TASK();
+
+	if( pxTo != pxFrom )
+	{
+		pxTo->ulSwitchesIn++;
+		pxFrom->uxCriticalNesting = uxCriticalNesting;
+		swapcontext( &( pxFrom->xContext ), &( pxTo->xContext ) );
+
+		/* Resumed. */
+		uxCriticalNesting = pxFrom->uxCriticalNesting;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskStart( void )
+{
+xSimTask *pxTask = portCURRENT_SIM_TASK();
+
+	/* Start tasks with interrupts enabled. */
+	pxTask->xHandle = ( xTaskHandle ) pxCurrentTCB;
+	uxCriticalNesting = 0;
+	prvMaskInterrupts( SIG_UNBLOCK );
+	pxTask->pxCode( pxTask->pvParameters );
+
+	/* Tasks must not return. */
+	abort();
+}
+/*-----------------------------------------------------------*/
+
+static void prvTickSignalHandler( int iSignal )
+{
+	( void ) iSignal;
+
+	ulPendingTicks++;
+	if( ( SREG & portSREG_I ) == 0 )
+	{
+		/* Interrupts disabled by the firmware: the tick stays pending. */
+		return;
+	}
+
+	xInterruptNesting++;
+	while( ulPendingTicks > 0 )
+	{
+		ulPendingTicks--;
+		Sim_PeripheralTick();
+		vTaskIncrementTick();
+	}
+	xInterruptNesting--;
+
+	#if configUSE_PREEMPTION == 1
+		xYieldPending = pdTRUE;
+	#endif
+
+	if( xYieldPending != pdFALSE )
+	{
+		xYieldPending = pdFALSE;
+		prvSwitchContext();
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvStepIdleTicks( void )
+{
+xTaskHandle xIdle;
+xSimTask *pxIdle;
+portTickType xSkip;
+unsigned long ulStart;
+
+	/* Ticks cannot run while the scheduler is suspended (the switch is
+	then only noted as missed) or the firmware has interrupts disabled. */
+	if( ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) || ( ( SREG & portSREG_I ) == 0 ) )
+	{
+		return;
+	}
+
+	xIdle = xTaskGetIdleTaskHandle();
+	if( ( xTaskHandle ) pxCurrentTCB != xIdle )
+	{
+		return;
+	}
+
+	ulStart = Sim_Now();
+	for( ;; )
+	{
+		/* Let any other idle priority task run first. */
+		vTaskSwitchContext();
+		if( ( xTaskHandle ) pxCurrentTCB != xIdle )
+		{
+			break;
+		}
+
+		/* Jump to the tick before the next wake or peripheral event. */
+		xSkip = xTaskGetExpectedIdleTime();
+		if( xSkip > ( portTickType ) 1 )
+		{
+			vTaskStepTick( ( portTickType ) Sim_SkipTicks( xSkip - 1 ) );
+		}
+
+		xInterruptNesting++;
+		Sim_PeripheralTick();
+		vTaskIncrementTick();
+		xInterruptNesting--;
+
+		xYieldPending = pdFALSE;
+		vTaskSwitchContext();
+		if( ( xTaskHandle ) pxCurrentTCB != xIdle )
+		{
+			break;
+		}
+	}
+
+	pxIdle = *( xSimTask ** ) xIdle;
+	pxIdle->xHandle = xIdle;
+	ulLastSwitchUs = Sim_Now();
+	pxIdle->ullRunUs += ulLastSwitchUs - ulStart;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSimReportTasks( int iFd )
+{
+unsigned long long ullTotal = 0;
+unsigned portBASE_TYPE ux;
+xSimTask *pxTask;
+const char *pcName;
+
+	/* The running task's share since its last switch is not counted. */
+	for( ux = 0; ux < uxSimTasks; ux++ )
+	{
+		ullTotal += pxSimTasks[ ux ]->ullRunUs;
+	}
+
+	for( ux = 0; ux < uxSimTasks; ux++ )
+	{
+		pxTask = pxSimTasks[ ux ];
+		pcName = ( pxTask->xHandle != NULL ) ? ( const char * ) pcTaskGetTaskName( pxTask->xHandle ) : "(unrun)";
+		dprintf( iFd, "sim:   %-8s %5.1f%% %10.3f ms %10lu switches in\n", pcName,
+			( ullTotal != 0 ) ? ( 100.0 * pxTask->ullRunUs ) / ullTotal : 0.0,
+			pxTask->ullRunUs / 1e3, pxTask->ulSwitchesIn );
+	}
+}
@@ -86,15 +86,57 @@
 #define configUSE_TICK_HOOK			0
 #define configCPU_CLOCK_HZ			( ( unsigned long ) 8000000 )
 #define configTICK_RATE_HZ			( ( portTickType ) 1000 )
-#define configMAX_PRIORITIES		( ( unsigned portBASE_TYPE ) 4 )
+#ifndef configMAX_PRIORITIES	/* Sim/bench_switch.sh builds other counts */
+	#define configMAX_PRIORITIES	( 4 )
+#endif
 #define configMINIMAL_STACK_SIZE	( ( unsigned short ) 85 )
-#define configTOTAL_HEAP_SIZE		( (size_t ) ( 1500 ) )
+#ifdef POSIX_SIM
+	/* Host pointers double the size of TCBs and queues. */
+	#define configTOTAL_HEAP_SIZE	( (size_t ) ( 6000 ) )
+#else
+	/* uC2 allocates 2070 bytes (uC1 1088): 13 queue structures of 33 bytes
+	and 277 bytes of queue storage, 8 TCBs of 43 bytes (the idle task's
+	included), 4 stacks of configMINIMAL_STACK_SIZE and 4 of twice that.
+	Sim/bench_heap.sh replays the list.  heap_1.c keeps the last byte, so
+	this leaves 57 bytes; a new task or queue needs its own here and in
+	heap_pool.c's classes. */
+	#define configTOTAL_HEAP_SIZE	( (size_t ) ( 2128 ) )
+#endif
+#ifndef configUSE_HEAP_POOL
+	#define configUSE_HEAP_POOL		0	/* 1: heap_pool.c (size classes, vPortFree, stats) instead of heap_1.c (Sim/bench_heap.sh) */
+#endif
+#ifndef configUSE_OPTIMISED_TASK_SELECTION
+	#define configUSE_OPTIMISED_TASK_SELECTION	0	/* 1: ready priority bitmap, at most 8 priorities (Sim/bench_switch.sh) */
+#endif
+#ifndef configUSE_TIMING_WHEEL
+	#define configUSE_TIMING_WHEEL		0	/* 1: delayed tasks in a hashed timing wheel instead of sorted lists (Sim/bench_delay.sh) */
+#endif
+#ifndef configTIMING_WHEEL_SLOTS
+	#define configTIMING_WHEEL_SLOTS	16	/* Power of 2 */
+#endif
 #define configMAX_TASK_NAME_LEN		( 8 )
-#define configUSE_TRACE_FACILITY	0
+#define configUSE_TRACE_FACILITY	1	/* Task and queue numbers for the trace recorder */
 #define configUSE_16_BIT_TICKS		1
 #define configIDLE_SHOULD_YIELD		1
+#define configUSE_TICKLESS_IDLE		1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP	2
 #define configQUEUE_REGISTRY_SIZE	0
 
+/* Run time statistics, counted in Timer3 counts (1 MHz, see timing.h) and
+extended to 32 bits by its overflow interrupt.  The functions are defined
+in runtime_stats.h, which the application must include. */
+#define configGENERATE_RUN_TIME_STATS	1
+extern void RunTime_TimerInit( void );
+extern unsigned long RunTime_Now( void );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	RunTime_TimerInit()
+#define portGET_RUN_TIME_COUNTER_VALUE()			RunTime_Now()
+
+/* Binary trace of context switches and queue operations, timestamped with
+the run time counter.  The hooks are defined in trace_hooks.h (included at
+the end of this file) and the recorder in trace_recorder.h, which the
+application must include. */
+#define configUSE_TRACE_RECORDER		1
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 		1
 #define configMAX_CO_ROUTINE_PRIORITIES ( 2 )
@@ -109,6 +151,16 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend			0
 #define INCLUDE_vTaskDelayUntil			1
 #define INCLUDE_vTaskDelay				1
-
+#define INCLUDE_xTaskGetSchedulerState	1
+#define INCLUDE_uxTaskGetStackHighWaterMark	1
+#ifdef POSIX_SIM
+	/* The host simulation's per task CPU report and virtual time. */
+	#define INCLUDE_xTaskGetIdleTaskHandle	1
+	#define INCLUDE_pcTaskGetTaskName		1
+#endif
+
+#if ( configUSE_TRACE_RECORDER == 1 )
+	#include "trace_hooks.h"
+#endif
 
 #endif /* FREERTOS_CONFIG_H */
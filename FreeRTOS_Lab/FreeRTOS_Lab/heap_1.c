@@ -84,6 +84,9 @@ task.h is included from an application file. */
 
 #undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
+/* heap_pool.c provides the allocator instead when configUSE_HEAP_POOL is 1. */
+#if ( configUSE_HEAP_POOL == 0 )
+
 /* Allocate the memory for the heap.  The struct is used to force byte
 alignment without using any non-portable code. */
 static union xRTOS_HEAP
@@ -161,5 +164,7 @@ size_t xPortGetFreeHeapSize( void )
 	return ( configTOTAL_HEAP_SIZE - xNextFreeByte );
 }
 
+#endif /* configUSE_HEAP_POOL */
+
 
 
@@ -0,0 +1,138 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Free-running ADC sampler for FreeRTOS builds.
+// The ADC conversion complete ISR stores samples into one half of a double
+// buffer while a task processes the other half. When a block fills, its index
+// is posted to a queue so the consumer sleeps until a whole block is ready
+// instead of polling ADC on a fixed period.
+// Relies on free-running mode (ADATE) being enabled by the caller.
+// With ADC_CHANNELS above 1 the ISR scans ADC0 to ADC_CHANNELS - 1 in turn,
+// and the blocks hold the channels interleaved: sample i of a block is from
+// channel i % ADC_CHANNELS. In free-running mode the next conversion has
+// already started when the ISR runs, so a new MUX setting applies to the
+// conversion after next; the ISR follows which channel each result came
+// from and drops the results that would put a channel out of place (only
+// the first few, while the scan gets going).
+
+#ifndef ADC_1284_H
+#define ADC_1284_H
+
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h" // FreeRTOS queue.h; Includes/queue.h shares its guard
+
+// Samples per block, override before including this file if needed
+#ifndef ADC_BLOCK_SIZE
+#define ADC_BLOCK_SIZE 32
+#endif
+
+// Channels scanned, ADC0 up; override before including this file if needed
+#ifndef ADC_CHANNELS
+#define ADC_CHANNELS 1
+#endif
+
+#if (ADC_BLOCK_SIZE % ADC_CHANNELS) != 0
+#error ADC_BLOCK_SIZE must be a multiple of ADC_CHANNELS
+#endif
+
+#define ADC_MUX_MASK 0x1F	// MUX4:0 in ADMUX
+
+// Prescaler /128: 62.5 kHz ADC clock at 8 MHz, 13 cycles per conversion
+// gives ~4800 samples/s (the old 5 tick poll read 200 samples/s)
+#define ADC_PRESCALE_128 ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))
+#define ADC_SAMPLE_RATE (8000000UL / 128 / 13)	// Over all channels
+
+volatile unsigned short adcBlocks[2][ADC_BLOCK_SIZE];
+volatile unsigned char adcBlockBusy[2];		// Set while a task owns the block
+volatile unsigned char adcFillBlock = 0;	// Block the ISR is writing
+volatile unsigned char adcFillIndex = 0;	// Next sample slot in that block
+volatile unsigned short adcOverruns = 0;	// Blocks discarded: consumer too slow
+xQueueHandle adcReadyQueue;					// Indices of completed blocks
+unsigned char adcReadyBlock;				// Block handed out by ADC_WaitForBlock
+#if (ADC_CHANNELS > 1)
+unsigned char adcMuxStarted = 0xFF;			// Channel of the conversion running, 0xFF unknown
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sets the sample rate and enables the conversion complete ISR
+//Parameter: None
+//Returns: 1 if set up else 0 (no heap for the queue)
+unsigned char ADC_SamplerInit(void)
+{
+	adcReadyQueue = xQueueCreate(2, sizeof(unsigned char));
+	if (!adcReadyQueue) {
+		return 0;
+	}
+	adcBlockBusy[0] = adcBlockBusy[1] = 0;
+	adcFillBlock = 0;
+	adcFillIndex = 0;
+#if (ADC_CHANNELS > 1)
+	ADMUX &= ~ADC_MUX_MASK;
+#endif
+
+	ADCSRA = (ADCSRA & ~ADC_PRESCALE_128) | ADC_PRESCALE_128 | (1 << ADIE);
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Blocks the calling task until a sample block is complete
+//Parameter: ticks is the maximum time to wait
+//Returns: Pointer to ADC_BLOCK_SIZE samples, or NULL on timeout.
+//		   The block must be handed back with ADC_ReleaseBlock()
+const volatile unsigned short* ADC_WaitForBlock(portTickType ticks)
+{
+	if (xQueueReceive(adcReadyQueue, &adcReadyBlock, ticks) != pdPASS) {
+		return NULL;
+	}
+	return adcBlocks[adcReadyBlock];
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Returns the block from ADC_WaitForBlock() to the ISR
+//Parameter: None
+//Returns: None
+void ADC_ReleaseBlock(void)
+{
+	adcBlockBusy[adcReadyBlock] = 0;
+}
+
+ISR(ADC_vect)
+{
+	signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	unsigned char block = adcFillBlock;
+	unsigned char index = adcFillIndex;
+#if (ADC_CHANNELS > 1)
+	unsigned char channel = adcMuxStarted;
+	unsigned char mux = ADMUX & ADC_MUX_MASK;
+
+	// The conversion started when this one ended used the MUX as it is now
+	adcMuxStarted = mux;
+	ADMUX = (ADMUX & ~ADC_MUX_MASK) | ((mux + 1 < ADC_CHANNELS) ? mux + 1 : 0);
+	if (channel != index % ADC_CHANNELS) {
+		return;
+	}
+#endif
+
+	adcBlocks[block][index++] = ADC;
+	if (index < ADC_BLOCK_SIZE) {
+		adcFillIndex = index;
+		return;
+	}
+
+	// Block complete: hand it over and continue in the other half
+	adcFillIndex = 0;
+	if (adcBlockBusy[block ^ 1]) {
+		adcOverruns++; // Refill this block; the consumer still owns the other
+		return;
+	}
+	adcBlockBusy[block] = 1;
+	adcFillBlock = block ^ 1;
+	xQueueSendFromISR(adcReadyQueue, &block, &xHigherPriorityTaskWoken);
+	if (xHigherPriorityTaskWoken != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+#endif //ADC_1284_H
@@ -0,0 +1,259 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Streaming line parser for commands from the Bluetooth module.
+// Bytes are fed one at a time as they come out of the USART RX buffer and
+// each is looked at once: letters build the keyword in a fixed buffer of
+// BT_WORD_LENGTH, digits are accumulated straight into the argument, so a
+// line is never stored. No heap and no hardware access, so a recorded
+// command stream can be fed to it anywhere (see Sim/bench_parse.c).
+// A line ends at CR, LF or ';'. Keywords are not case sensitive and tokens
+// are separated by spaces or tabs:
+//   ORDER p [p ...]   buy products p in order, up to BT_MAX_ARGS of them
+//   STATUS            balance and dispenses in progress
+//   PRICE p           price of product p
+//   STATS (or S)      run-time statistics dump (runtime_stats.h)
+// Products are numbered 1 to BT_PRODUCTS. For the single character
+// selections the Bluetooth module used to send, a number at the start of a
+// line starts an order, as if after ORDER; a digit that cannot start a
+// longer product number is a one item order right away, without waiting
+// for the end of the line.
+// A bad line gives one BT_ERROR when it ends, with the reason.
+
+#ifndef BT_COMMAND_H
+#define BT_COMMAND_H
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#define BT_WORD_LENGTH 6	// Longest keyword
+#ifndef BT_MAX_ARGS
+#define BT_MAX_ARGS 6		// Items in one order
+#endif
+#ifndef BT_PRODUCTS
+#define BT_PRODUCTS 2
+#endif
+
+// Commands
+#define BT_NONE		0	// Nothing complete yet
+#define BT_ORDER	1	// args: products
+#define BT_STATUS	2
+#define BT_PRICE	3	// args: product
+#define BT_STATS	4
+#define BT_ERROR	5	// args: [BT_ERR_ code]
+
+// BT_ERROR codes
+#define BT_ERR_UNKNOWN	1	// Not a keyword
+#define BT_ERR_SYNTAX	2	// Unexpected character
+#define BT_ERR_ARGS		3	// Too few or too many arguments
+#define BT_ERR_RANGE	4	// No such product
+
+typedef struct _BtCommand
+{
+	unsigned char type;		// BT_ORDER ... BT_ERROR
+	unsigned char count;	// Arguments
+	unsigned char args[BT_MAX_ARGS];
+} BtCommand;
+
+typedef struct _BtKeyword
+{
+	char name[BT_WORD_LENGTH + 1];
+	unsigned char type;
+	unsigned char minArgs;
+	unsigned char maxArgs;
+} BtKeyword;
+
+const BtKeyword btKeywords[] PROGMEM = {
+	{"ORDER",  BT_ORDER,  1, BT_MAX_ARGS},
+	{"STATUS", BT_STATUS, 0, 0},
+	{"PRICE",  BT_PRICE,  1, 1},
+	{"STATS",  BT_STATS,  0, 0},
+	{"S",      BT_STATS,  0, 0},
+};
+#define BT_KEYWORDS (sizeof(btKeywords) / sizeof(btKeywords[0]))
+
+enum BtParseState {BTP_START,BTP_WORD,BTP_ARGS,BTP_NUMBER,BTP_SKIP};
+
+typedef struct _BtParser
+{
+	unsigned char state;
+	char word[BT_WORD_LENGTH + 1];	// Keyword so far
+	unsigned char wordLen;
+	unsigned char keyword;			// Index into btKeywords once the keyword ends
+	unsigned short value;			// Argument so far
+	unsigned char error;			// BT_ERR_ code of the line, in BTP_SKIP
+	BtCommand cmd;					// Being built
+	unsigned long lines;			// Statistics: commands and errors returned
+	unsigned long errors;
+} BtParser;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Resets a parser to the start of a line
+//Parameter: p is the parser
+//Returns: None
+void BtParser_Init(BtParser* p)
+{
+	memset(p, 0, sizeof(BtParser));
+	p->state = BTP_START;
+}
+
+// Starts the next line
+static void BtParser_Restart(BtParser* p)
+{
+	p->state = BTP_START;
+	p->wordLen = 0;
+	p->cmd.count = 0;
+}
+
+// Ignores the rest of the line, which ends in a BT_ERROR
+static void BtParser_Fail(BtParser* p, unsigned char error)
+{
+	p->state = BTP_SKIP;
+	p->error = error;
+}
+
+// Looks up the keyword just ended; 0 if there is no such keyword
+static unsigned char BtParser_EndWord(BtParser* p)
+{
+	unsigned char i;
+
+	p->word[p->wordLen] = '\0';
+	for (i = 0; i < BT_KEYWORDS; i++) {
+		if (!strcmp_P(p->word, btKeywords[i].name)) {
+			p->keyword = i;
+			p->cmd.type = pgm_read_byte(&btKeywords[i].type);
+			p->state = BTP_ARGS;
+			return 1;
+		}
+	}
+	BtParser_Fail(p, BT_ERR_UNKNOWN);
+	return 0;
+}
+
+// Adds the argument just ended to the command
+static void BtParser_EndNumber(BtParser* p)
+{
+	if (p->cmd.count >= pgm_read_byte(&btKeywords[p->keyword].maxArgs)) {
+		BtParser_Fail(p, BT_ERR_ARGS);
+	} else if (p->value < 1 || p->value > BT_PRODUCTS) {
+		BtParser_Fail(p, BT_ERR_RANGE);
+	} else {
+		p->cmd.args[p->cmd.count++] = p->value;
+		p->state = BTP_ARGS;
+	}
+}
+
+// Hands out the finished line's command, or its error
+static unsigned char BtParser_EndLine(BtParser* p, BtCommand* cmd)
+{
+	unsigned char type = BT_NONE;
+
+	if (p->state == BTP_WORD) {
+		BtParser_EndWord(p);
+	} else if (p->state == BTP_NUMBER) {
+		BtParser_EndNumber(p);
+	}
+	if (p->state == BTP_ARGS && p->cmd.count < pgm_read_byte(&btKeywords[p->keyword].minArgs)) {
+		BtParser_Fail(p, BT_ERR_ARGS);
+	}
+	if (p->state == BTP_ARGS) {
+		*cmd = p->cmd;
+		type = cmd->type;
+		p->lines++;
+	} else if (p->state == BTP_SKIP) {
+		cmd->type = type = BT_ERROR;
+		cmd->count = 1;
+		cmd->args[0] = p->error;
+		p->errors++;
+	}
+	BtParser_Restart(p);
+	return type;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Parses one received byte
+//Parameter: p is the parser, data the byte, cmd receives the command when
+//			 one is complete
+//Returns: The command's type (BT_ORDER ... BT_ERROR) when data completed
+//		   one, else BT_NONE
+unsigned char BtParser_Feed(BtParser* p, unsigned char data, BtCommand* cmd)
+{
+	if (data == '\r' || data == '\n' || data == ';') {
+		return BtParser_EndLine(p, cmd);
+	}
+	if (data >= 'a' && data <= 'z') {
+		data -= 'a' - 'A';
+	}
+
+	switch (p->state) {
+		case BTP_START:
+			if (data >= '1' && data <= '9' && (data - '0') * 10U <= BT_PRODUCTS) {
+				// May start a longer product number: an order, ended with the line
+				p->keyword = 0; // ORDER, first in btKeywords
+				p->cmd.type = BT_ORDER;
+				p->value = data - '0';
+				p->state = BTP_NUMBER;
+				break;
+			}
+			if (data >= '0' && data <= '9') {
+				// Single character selection: an order of one, right away
+				if (data < '1' || data > '0' + BT_PRODUCTS) {
+					cmd->type = BT_ERROR;
+					cmd->args[0] = BT_ERR_RANGE;
+					p->errors++;
+				} else {
+					cmd->type = BT_ORDER;
+					cmd->args[0] = data - '0';
+					p->lines++;
+				}
+				cmd->count = 1;
+				return cmd->type;
+			}
+			if (data >= 'A' && data <= 'Z') {
+				p->word[0] = data;
+				p->wordLen = 1;
+				p->state = BTP_WORD;
+			} else if (data != ' ' && data != '\t') {
+				BtParser_Fail(p, BT_ERR_SYNTAX);
+			}
+			break;
+		case BTP_WORD:
+			if (data >= 'A' && data <= 'Z') {
+				if (p->wordLen < BT_WORD_LENGTH) {
+					p->word[p->wordLen++] = data;
+				} else {
+					BtParser_Fail(p, BT_ERR_UNKNOWN); // Longer than any keyword
+				}
+			} else if (data == ' ' || data == '\t') {
+				BtParser_EndWord(p);
+			} else {
+				BtParser_Fail(p, BT_ERR_SYNTAX);
+			}
+			break;
+		case BTP_ARGS:
+			if (data >= '0' && data <= '9') {
+				p->value = data - '0';
+				p->state = BTP_NUMBER;
+			} else if (data != ' ' && data != '\t') {
+				BtParser_Fail(p, BT_ERR_SYNTAX);
+			}
+			break;
+		case BTP_NUMBER:
+			if (data >= '0' && data <= '9') {
+				if (p->value < 1000) {
+					p->value = p->value * 10 + (data - '0'); // Out of range anyway past 999
+				}
+			} else if (data == ' ' || data == '\t') {
+				BtParser_EndNumber(p);
+			} else {
+				BtParser_Fail(p, BT_ERR_SYNTAX);
+			}
+			break;
+		default:
+			break; // BTP_SKIP: wait for the end of the line
+	}
+	return BT_NONE;
+}
+
+#endif //BT_COMMAND_H
@@ -0,0 +1,113 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Edge-triggered coin pulse detector for the IR beam ADC samples.
+// A coin shows up as a dip below the idle (unblocked beam) level. The idle
+// level is tracked by a slow moving average that is frozen while a pulse is
+// in progress. A pulse starts when a sample drops CD_ENTER_DROP below the
+// baseline and ends when it recovers to within CD_EXIT_DROP of it, giving a
+// hysteresis band so noise around a single threshold cannot split one coin
+// into several. A coin is counted once, on the falling edge of the pulse
+// (beam restored), and only if the pulse width is plausible for a coin.
+// No hardware access, so ADC traces can be replayed through it on a host
+// (Sim/replay_coin.sh).
+
+#ifndef COIN_DETECTOR_H
+#define COIN_DETECTOR_H
+
+// Detector tuning, in ADC counts and samples (ADC_SAMPLE_RATE per second)
+#ifndef CD_ENTER_DROP
+#define CD_ENTER_DROP 100		// Dip below baseline that starts a pulse
+#endif
+#ifndef CD_EXIT_DROP
+#define CD_EXIT_DROP 50			// Dip below baseline that still counts as a pulse
+#endif
+#ifndef CD_MIN_WIDTH
+#define CD_MIN_WIDTH 5			// ~1 ms: shorter dips are noise
+#endif
+#ifndef CD_MAX_WIDTH
+#define CD_MAX_WIDTH 960		// ~200 ms: longer means the beam is blocked/jammed
+#endif
+#define CD_BASELINE_SHIFT 6		// Baseline moving average weight 1/64
+
+enum CDState {CD_IDLE,CD_PULSE};
+
+typedef struct _CoinDetector
+{
+	unsigned long baseline;		// Idle level << CD_BASELINE_SHIFT
+	unsigned char state;		// CD_IDLE or CD_PULSE
+	unsigned short width;		// Samples in the current pulse
+	volatile unsigned short coinCount;	// Coins seen, only ever increases
+	unsigned short rejected;	// Pulses discarded for bad width
+} CoinDetector;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Resets a detector
+//Parameter: cd is the detector, idleLevel is an ADC reading with beam unblocked
+//Returns: None
+void CoinDetector_Init(CoinDetector* cd, unsigned short idleLevel)
+{
+	cd->baseline = (unsigned long)idleLevel << CD_BASELINE_SHIFT;
+	cd->state = CD_IDLE;
+	cd->width = 0;
+	cd->coinCount = 0;
+	cd->rejected = 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Processes one ADC sample
+//Parameter: cd is the detector, sample is the ADC reading
+//Returns: 1 if this sample completed a valid coin pulse else 0
+unsigned char CoinDetector_Feed(CoinDetector* cd, unsigned short sample)
+{
+	unsigned short base = cd->baseline >> CD_BASELINE_SHIFT;
+	unsigned short enter = (base > CD_ENTER_DROP) ? base - CD_ENTER_DROP : 0;
+	unsigned short exit = (base > CD_EXIT_DROP) ? base - CD_EXIT_DROP : 0;
+
+	switch(cd->state){
+		case CD_IDLE:
+			if (sample < enter) {
+				cd->state = CD_PULSE;
+				cd->width = 1;
+			} else {
+				// Track slow drift (LED ageing, ambient light) while idle
+				cd->baseline -= cd->baseline >> CD_BASELINE_SHIFT;
+				cd->baseline += sample;
+			}
+			break;
+		case CD_PULSE:
+			if (sample < exit) {
+				if (cd->width < 0xFFFF)
+					cd->width++;
+				break;
+			}
+			// Falling edge of the coin pulse: beam restored
+			cd->state = CD_IDLE;
+			if (cd->width >= CD_MIN_WIDTH && cd->width <= CD_MAX_WIDTH) {
+				cd->coinCount++;
+				return 1;
+			}
+			cd->rejected++;
+			break;
+		default:
+			cd->state = CD_IDLE;
+			break;
+	}
+	return 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Processes a block of ADC samples
+//Parameter: cd is the detector, samples/count is the block
+//Returns: Number of coins completed within the block
+unsigned char CoinDetector_FeedBlock(CoinDetector* cd, const volatile unsigned short* samples, unsigned char count)
+{
+	unsigned char coins = 0;
+	unsigned char i;
+	for (i = 0; i < count; i++) {
+		coins += CoinDetector_Feed(cd, samples[i]);
+	}
+	return coins;
+}
+
+#endif //COIN_DETECTOR_H
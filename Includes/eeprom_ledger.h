@@ -0,0 +1,258 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Wear-levelled EEPROM ledger for FreeRTOS builds.
+// The machine's credit, sales and dispenses in progress (LedgerState) are
+// kept as a journal: every change appends a whole record to the next of
+// LEDGER_SLOTS slots in a circular region, never rewriting a slot until
+// the ring comes round, so each cell takes one write per LEDGER_SLOTS
+// records. A record is (multi-byte fields in CPU byte order):
+//   SEQ[2] VERSION PRODUCTS STATE[sizeof(LedgerState)] CRC8
+// SEQ goes up by one per record (wrapping at 16 bits). VERSION is
+// LEDGER_VERSION and PRODUCTS is LEDGER_PRODUCTS: a record written with
+// another STATE layout is ignored rather than misread. The CRC (Link_Crc8)
+// covers everything before it.
+// A slot is rewritten VERSION first, as LEDGER_TORN, and VERSION last, so
+// a record cut short by a reset or brown-out is ignored whatever its CRC:
+// the stale CRC of the record it replaced matches the mix of old and new
+// bytes 1 time in 256. VERSION thus takes two writes per record.
+// Slots 0..n hold consecutive sequence numbers counting up from slot 0's,
+// and every slot after the newest, n, is erased, torn or a lap behind, so
+// Ledger_Recover() finds n by binary search: 1 + log2(LEDGER_SLOTS) record
+// reads at boot instead of reading the whole ring.
+// Ledger_Save() only copies the state; Ledger_Task, at low priority, writes
+// it and sleeps through each byte's 3.3 ms EEPROM write time instead of
+// busy waiting, so no periodic task waits on the EEPROM. Saves made while
+// a record is being written are merged into the next record.
+// LedgerState grows with LEDGER_PRODUCTS, so it is only ever passed by
+// pointer; the record being read or written is kept in ledgerRecord, not
+// on a task's stack.
+
+#ifndef EEPROM_LEDGER_H
+#define EEPROM_LEDGER_H
+
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "link_protocol.h" // Link_Crc8
+
+// Region, override before including this file if needed
+#ifndef LEDGER_START
+#define LEDGER_START 0		// EEPROM address of slot 0
+#endif
+#ifndef LEDGER_SLOTS
+#define LEDGER_SLOTS ((E2END + 1 - LEDGER_START) / LEDGER_RECORD_SIZE)	// The rest of the EEPROM
+#endif
+#ifndef LEDGER_PRODUCTS
+#define LEDGER_PRODUCTS 2	// Catalog slots (product_catalog.h) counted
+#endif
+
+#define LEDGER_CRC_SEED 0x4C	// An erased slot (all 0xFF) does not check
+#define LEDGER_VERSION 2		// Record layout, bumped whenever LedgerState changes
+#define LEDGER_TORN 0xFF		// VERSION while a slot is rewritten; erased EEPROM too
+
+typedef struct _LedgerState
+{
+	unsigned short refunds;		// Dispenses refunded: jams and resets mid-dispense
+	unsigned short boots;		// Resets survived
+	unsigned char coins;		// Credit
+	unsigned short sold[LEDGER_PRODUCTS];		// Items dispensed, per slot
+	unsigned char pending[LEDGER_PRODUCTS];	// Dispenses paid for but not finished, per slot
+} LedgerState;
+
+typedef struct _LedgerRecord
+{
+	unsigned short seq;
+	unsigned char version;		// LEDGER_VERSION
+	unsigned char products;		// LEDGER_PRODUCTS
+	LedgerState state;
+	unsigned char crc;
+} LedgerRecord;
+
+// Bytes a record takes in EEPROM, and the checked part of it
+#define LEDGER_RECORD_SIZE (offsetof(LedgerRecord, crc) + 1)
+#define LEDGER_SIZE ((unsigned short)(LEDGER_RECORD_SIZE * LEDGER_SLOTS))
+
+// Fails to compile if the ring runs past the end of the EEPROM
+typedef char LedgerFitsEeprom[LEDGER_START + LEDGER_RECORD_SIZE * LEDGER_SLOTS <= E2END + 1 ? 1 : -1];
+
+LedgerState ledgerPending;				// Latest Ledger_Save
+LedgerState ledgerNewest;				// State in the newest record
+LedgerRecord ledgerRecord;				// Record being read or written
+unsigned short ledgerSeq;				// SEQ of the newest record
+unsigned short ledgerSlot;				// Slot of the newest record
+unsigned char ledgerEmpty;				// No record found at boot, none written yet
+unsigned long ledgerWrites;				// Statistics: records written since boot
+unsigned char ledgerBootReads;			// Records read by Ledger_Recover
+xSemaphoreHandle ledgerSignal;			// Given by Ledger_Save
+
+// CRC of everything in a record before the CRC
+static unsigned char Ledger_Crc(const LedgerRecord* r)
+{
+	const unsigned char* p = (const unsigned char*)r;
+	unsigned char crc = LEDGER_CRC_SEED;
+	unsigned short i; // Records outgrow 255 bytes with many products
+
+	for (i = 0; i < offsetof(LedgerRecord, crc); i++) {
+		crc = Link_Crc8(crc, p[i]);
+	}
+	return crc;
+}
+
+// Reads a slot; 0 if it holds no complete record
+static unsigned char Ledger_Read(unsigned short slot, LedgerRecord* r)
+{
+	eeprom_read_block(r, (const void*)(LEDGER_START + slot * LEDGER_RECORD_SIZE), LEDGER_RECORD_SIZE);
+	ledgerBootReads++;
+	return r->crc == Ledger_Crc(r) && r->version == LEDGER_VERSION && r->products == LEDGER_PRODUCTS;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Finds the newest record and makes it the one the next
+//				  record follows
+//Parameter: state receives the newest record's state, or all zero if
+//			 there is none
+//Returns: 1 if a record was found, else 0
+unsigned char Ledger_Recover(LedgerState* state)
+{
+	LedgerRecord* r = &ledgerRecord;
+	unsigned short first, lo, hi, mid;
+	unsigned char held = 1; // ledgerRecord holds slot lo
+
+	ledgerBootReads = 0;
+	ledgerEmpty = 0;
+
+	if (Ledger_Read(0, r)) {
+		// Slot 0 is the start of the newest run: the last slot in it
+		// holding SEQ first + slot is the newest record
+		first = r->seq;
+		lo = 0;
+		hi = LEDGER_SLOTS;
+		while (hi - lo > 1) {
+			mid = lo + (hi - lo) / 2;
+			held = Ledger_Read(mid, r) && r->seq == (unsigned short)(first + mid);
+			if (held) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		if (!held) {
+			Ledger_Read(lo, r);
+		}
+	} else if (Ledger_Read(LEDGER_SLOTS - 1, r)) {
+		// Slot 0 was being rewritten when the ring came round: the last
+		// slot is the newest
+		lo = LEDGER_SLOTS - 1;
+	} else {
+		memset(state, 0, sizeof(LedgerState));
+		memset(&ledgerPending, 0, sizeof(LedgerState));
+		memset(&ledgerNewest, 0, sizeof(LedgerState));
+		ledgerSeq = 0xFFFF;
+		ledgerSlot = LEDGER_SLOTS - 1; // The first record goes to slot 0
+		ledgerEmpty = 1;
+		return 0;
+	}
+	ledgerSeq = r->seq;
+	ledgerSlot = lo;
+	*state = r->state;
+	ledgerPending = ledgerNewest = r->state;
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Restores the ledger; call before the scheduler starts
+//Parameter: state receives the newest record's state, or all zero if
+//			 there is none (ledgerEmpty is then set)
+//Returns: 1 if set up else 0 (no heap for the semaphore)
+unsigned char Ledger_Init(LedgerState* state)
+{
+	vSemaphoreCreateBinary(ledgerSignal);
+	if (!ledgerSignal) {
+		return 0;
+	}
+	xSemaphoreTake(ledgerSignal, 0);
+	ledgerWrites = 0;
+	Ledger_Recover(state);
+	return 1;
+}
+// Writes one EEPROM byte, sleeping until the previous write is done
+static void Ledger_WriteByte(unsigned char* address, unsigned char data)
+{
+	while (!eeprom_is_ready()) {
+		vTaskDelay(1);
+	}
+	eeprom_update_byte(address, data);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Appends a record to the ring, sleeping through each
+//				  byte's EEPROM write time; called by Ledger_Task
+//				  The slot is marked LEDGER_TORN until its last byte
+//Parameter: state is the state to record; may be &ledgerRecord.state
+//Returns: None
+void Ledger_Write(const LedgerState* state)
+{
+	LedgerRecord* r = &ledgerRecord;
+	unsigned char* p = (unsigned char*)r;
+	unsigned char* address;
+	unsigned short i;
+
+	if (state != &r->state) {
+		r->state = *state;
+	}
+	r->seq = ledgerSeq + 1;
+	r->version = LEDGER_VERSION;
+	r->products = LEDGER_PRODUCTS;
+	r->crc = Ledger_Crc(r);
+	ledgerSlot = (ledgerSlot + 1) % LEDGER_SLOTS;
+	address = (unsigned char*)(LEDGER_START + ledgerSlot * LEDGER_RECORD_SIZE);
+
+	Ledger_WriteByte(address + offsetof(LedgerRecord, version), LEDGER_TORN);
+	for (i = 0; i < LEDGER_RECORD_SIZE; i++) {
+		if (i != offsetof(LedgerRecord, version)) {
+			Ledger_WriteByte(address + i, p[i]);
+		}
+	}
+	Ledger_WriteByte(address + offsetof(LedgerRecord, version), LEDGER_VERSION);
+	ledgerSeq = r->seq;
+	ledgerNewest = r->state;
+	ledgerEmpty = 0;
+	ledgerWrites++;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Hands a new state to Ledger_Task to record
+//Parameter: state is the state to record
+//Returns: None
+void Ledger_Save(const LedgerState* state)
+{
+	taskENTER_CRITICAL();
+	ledgerPending = *state;
+	taskEXIT_CRITICAL();
+	xSemaphoreGive(ledgerSignal);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Task body: records the state whenever it is saved and
+//				  differs from the newest record
+//				  Create at a lower priority than the tasks that save
+//Parameter: None
+//Returns: None
+void Ledger_Task()
+{
+	LedgerState* state = &ledgerRecord.state;
+
+	for(;;)
+	{
+		xSemaphoreTake(ledgerSignal, portMAX_DELAY);
+		taskENTER_CRITICAL();
+		*state = ledgerPending;
+		taskEXIT_CRITICAL();
+		if (ledgerEmpty || memcmp(state, &ledgerNewest, sizeof(LedgerState))) {
+			Ledger_Write(state);
+		}
+	}
+}
+
+#endif //EEPROM_LEDGER_H
@@ -2,6 +2,7 @@
 #include <avr/interrupt.h>
 #include <stdio.h>
 #include "io.h"
+#include "timing.h"
 
 #define SET_BIT(p,i) ((p) |= (1 << (i)))
 #define CLR_BIT(p,i) ((p) &= ~(1 << (i)))
@@ -37,7 +38,10 @@ void LCD_WriteCommand (unsigned char Command) {
    SET_BIT(CONTROL_BUS,E);
    asm("nop");
    CLR_BIT(CONTROL_BUS,E);
-   delay_ms(2); // ClearScreen requires 1.52ms to execute
+   if (Command <= 0x03)
+      delay_ms(2); // ClearScreen/ReturnHome require 1.52ms to execute
+   else
+      delay_us(40); // All other commands take 37us
 }
 
 void LCD_WriteData(unsigned char Data) {
@@ -46,7 +50,7 @@ void LCD_WriteData(unsigned char Data) {
    SET_BIT(CONTROL_BUS,E);
    asm("nop");
    CLR_BIT(CONTROL_BUS,E);
-   delay_ms(1);
+   delay_us(40);
 }
 
 void LCD_DisplayString( unsigned char column, const unsigned char* string) {
@@ -68,13 +72,3 @@ void LCD_Cursor(unsigned char column) {
    }
 }
 
-void delay_ms(int miliSec) //for 8 Mhz crystal
-
-{
-    int i,j;
-    for(i=0;i<miliSec;i++)
-    for(j=0;j<775;j++)
-  {
-   asm("nop");
-  }
-}
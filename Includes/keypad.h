@@ -20,8 +20,10 @@
 #define KEYPAD_H
 
 #include <bit.h>
+#include "timing.h"
 
 // Keypad Setup Values
+#define KEYPAD_SETTLE_US 2 // Time for a column line to settle before reading rows
 #define KEYPADPORT PORTC
 #define KEYPADPIN  PINC
 #define ROW1 0
@@ -41,7 +43,7 @@ unsigned char GetKeypadKey() {
 
 	// Check keys in col 1
 	KEYPADPORT = SetBit(0xFF,COL1,0); // Set Px4 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
+	delay_us(KEYPAD_SETTLE_US); // allow PORTx to stabilize before checking
 	if ( GetBit(~KEYPADPIN,ROW1) ) { return '1'; }
 	if ( GetBit(~KEYPADPIN,ROW2) ) { return '4'; }
 	if ( GetBit(~KEYPADPIN,ROW3) ) { return '7'; }
@@ -49,7 +51,7 @@ unsigned char GetKeypadKey() {
 
 	// Check keys in col 2
 	KEYPADPORT = SetBit(0xFF,COL2,0); // Set Px5 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
+	delay_us(KEYPAD_SETTLE_US); // allow PORTx to stabilize before checking
 	if ( GetBit(~KEYPADPIN,ROW1) ) { return '2'; }
 	if ( GetBit(~KEYPADPIN,ROW2) ) { return '5'; }
 	if ( GetBit(~KEYPADPIN,ROW3) ) { return '8'; }
@@ -57,7 +59,7 @@ unsigned char GetKeypadKey() {
 
 	// Check keys in col 3
 	KEYPADPORT = SetBit(0xFF,COL3,0); // Set Px6 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
+	delay_us(KEYPAD_SETTLE_US); // allow PORTx to stabilize before checking
 	if ( GetBit(~KEYPADPIN,ROW1) ) { return '3'; }
 	if ( GetBit(~KEYPADPIN,ROW2) ) { return '6'; }
 	if ( GetBit(~KEYPADPIN,ROW3) ) { return '9'; }
@@ -65,7 +67,7 @@ unsigned char GetKeypadKey() {
 
 	// Check keys in col 4
 	KEYPADPORT = SetBit(0xFF,COL4,0); // Set Px7 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
+	delay_us(KEYPAD_SETTLE_US); // allow PORTx to stabilize before checking
 	if (GetBit(~KEYPADPIN,ROW1) ) { return 'A'; }
 	if (GetBit(~KEYPADPIN,ROW2) ) { return 'B'; }
 	if (GetBit(~KEYPADPIN,ROW3) ) { return 'C'; }
@@ -73,5 +75,24 @@ unsigned char GetKeypadKey() {
 	
 	return '\0';
 }
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads every key of the keypad at once
+//Parameter: None
+//Returns: Bit row * 4 + col (both from 0) set for each key held, e.g. bit 0
+//		   for '1' and bit 15 for 'D'. Leaves the last column driven low
+unsigned short GetKeypadKeys() {
+	unsigned short keys = 0;
+	unsigned char col;
+
+	for (col = 0; col < 4; col++) {
+		KEYPADPORT = SetBit(0xFF,COL1 + col,0); // Drive this column low; others 1
+		delay_us(KEYPAD_SETTLE_US); // allow PORTx to stabilize before checking
+		if ( GetBit(~KEYPADPIN,ROW1) ) { keys |= 1U << (0 + col); }
+		if ( GetBit(~KEYPADPIN,ROW2) ) { keys |= 1U << (4 + col); }
+		if ( GetBit(~KEYPADPIN,ROW3) ) { keys |= 1U << (8 + col); }
+		if ( GetBit(~KEYPADPIN,ROW4) ) { keys |= 1U << (12 + col); }
+	}
+	return keys;
+}
 
 #endif //KEYPAD_H
@@ -0,0 +1,165 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Interrupt driven keypad scanner for FreeRTOS builds, for the keypad wiring
+// of keypad.h (rows on Px0-Px3 with pull-ups, columns on Px4-Px7).
+// While no key is down every column is driven low, so pressing any key
+// pulls its row low and raises the pin change interrupt; until then the
+// keypad costs nothing. The pin change ISR hands over to a scan of the whole
+// matrix every KEYPAD_SCAN_US, run by the Timer3 compare B interrupt on the
+// timing.h timebase. A new reading is accepted once it has been the same for
+// KEYPAD_DEBOUNCE_SCANS scans in a row, and each key that went down or up is
+// posted to keypadQueue as a KeyEvent stamped with the tick. When every key
+// is up the scan stops and the pin change interrupt is armed again.
+// So a press is reported KEYPAD_DEBOUNCE_SCANS scans after its contacts
+// stop bouncing, a held key gives one press and one release, and several
+// keys may be down at once.
+
+#ifndef KEYPAD_ISR_H
+#define KEYPAD_ISR_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h" // And the FreeRTOS queue.h
+#include "timing.h"
+#include "keypad.h"
+
+// Pin change interrupt of KEYPADPORT (port C: PCINT16-23)
+#ifndef KEYPAD_PCMSK
+#define KEYPAD_PCMSK PCMSK2
+#define KEYPAD_PCIE PCIE2
+#define KEYPAD_PCIF PCIF2
+#define KEYPAD_PCINT_vect PCINT2_vect
+#endif
+
+#ifndef KEYPAD_SCAN_US
+#define KEYPAD_SCAN_US 1000			// Time between scans while a key is down
+#endif
+#ifndef KEYPAD_DEBOUNCE_SCANS
+#define KEYPAD_DEBOUNCE_SCANS 5		// Equal scans that accept a change
+#endif
+#ifndef KEYPAD_QUEUE_LENGTH
+#define KEYPAD_QUEUE_LENGTH 8
+#endif
+
+#define KEYPAD_ROWS 0x0F	// Row bits of KEYPADPORT
+#define KEYPAD_IDLE 0x0F	// Columns low, row pull-ups on
+
+typedef struct _KeyEvent
+{
+	unsigned char key;		// '0'-'9', 'A'-'D', '*' or '#'
+	unsigned char pressed;	// 1 when the key went down, 0 when it came up
+	portTickType time;		// Tick the change was accepted on
+} KeyEvent;
+
+const char keypadKeys[16] = "123A456B789C*0#D"; // By GetKeypadKeys() bit
+
+xQueueHandle keypadQueue;		// KeyEvents
+xSemaphoreHandle keypadWake;	// Given after posting events; may be NULL
+unsigned short keypadDown;		// Keys accepted as held
+unsigned short keypadReading;	// Last scan
+unsigned char keypadSame;		// Scans in a row that read keypadReading
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Creates the event queue and arms the pin change interrupt
+//				  Call before the scheduler starts, after Timing_Init(),
+//				  with the keypad's port directions already set
+//Parameter: wake is a semaphore to give whenever events are posted, so a
+//			 task can sleep on it for other inputs as well, or NULL
+//Returns: 1 if set up else 0 (no heap for the queue)
+unsigned char Keypad_Init(xSemaphoreHandle wake)
+{
+	keypadQueue = xQueueCreate(KEYPAD_QUEUE_LENGTH, sizeof(KeyEvent));
+	if (!keypadQueue) {
+		return 0;
+	}
+	keypadWake = wake;
+	keypadDown = 0;
+	KEYPADPORT = KEYPAD_IDLE;
+	KEYPAD_PCMSK |= KEYPAD_ROWS;
+	PCIFR = (1 << KEYPAD_PCIF);
+	PCICR |= (1 << KEYPAD_PCIE);
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Takes the next key event without blocking
+//Parameter: event receives it
+//Returns: 1 if there was one else 0
+unsigned char Keypad_Read(KeyEvent* event)
+{
+	return xQueueReceive(keypadQueue, event, 0) == pdPASS;
+}
+
+// Starts scanning; called from the ISRs
+static void Keypad_StartScan(void)
+{
+	PCICR &= ~(1 << KEYPAD_PCIE); // The scan watches the keys until all are up
+	keypadReading = keypadDown;
+	keypadSame = 0;
+	OCR3B = TCNT3 + KEYPAD_SCAN_US * TIMING_TICKS_PER_US;
+	TIFR3 = (1 << OCF3B);	// Clear an old match
+	TIMSK3 |= (1 << OCIE3B);
+}
+
+ISR(KEYPAD_PCINT_vect)
+{
+	Keypad_StartScan();
+}
+
+ISR(TIMER3_COMPB_vect)
+{
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	unsigned short keys = GetKeypadKeys();
+	unsigned short changed;
+	unsigned char i;
+	KeyEvent event;
+
+	OCR3B += KEYPAD_SCAN_US * TIMING_TICKS_PER_US;
+	if (keys != keypadReading) {
+		keypadReading = keys; // Still bouncing
+		keypadSame = 1;
+	} else if (keypadSame < KEYPAD_DEBOUNCE_SCANS) {
+		keypadSame++;
+	}
+	if (keypadSame < KEYPAD_DEBOUNCE_SCANS) {
+		KEYPADPORT = KEYPAD_IDLE;
+		return;
+	}
+
+	changed = keys ^ keypadDown;
+	if (changed) {
+		keypadDown = keys;
+		event.time = xTaskGetTickCountFromISR();
+		for (i = 0; i < 16; i++) {
+			if (changed & (1U << i)) {
+				event.key = keypadKeys[i];
+				event.pressed = (keys >> i) & 1;
+				xQueueSendFromISR(keypadQueue, &event, &xHigherPriorityTaskWoken);
+			}
+		}
+		if (keypadWake) {
+			xSemaphoreGiveFromISR(keypadWake, &xHigherPriorityTaskWoken);
+		}
+	}
+
+	KEYPADPORT = KEYPAD_IDLE;
+	if (!keypadDown) {
+		// All up: sleep until the next press
+		TIMSK3 &= ~(1 << OCIE3B);
+		delay_us(KEYPAD_SETTLE_US);
+		PCIFR = (1 << KEYPAD_PCIF); // Raised by the scan itself
+		PCICR |= (1 << KEYPAD_PCIE);
+		if ((~KEYPADPIN) & KEYPAD_ROWS) {
+			Keypad_StartScan(); // Pressed while re-arming
+		}
+	}
+	if (xHigherPriorityTaskWoken != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+#endif //KEYPAD_ISR_H
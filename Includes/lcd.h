@@ -5,6 +5,7 @@
 #define LCD_H
 
 #include <stdio.h>
+#include "timing.h"
 
 #define SET_BIT(p,i) ((p) |= (1 << (i)))
 #define CLR_BIT(p,i) ((p) &= ~(1 << (i)))
@@ -19,24 +20,25 @@
 
 /*-------------------------------------------------------------------------*/
 
-void delay_ms(int miliSec) { //for 8 Mhz crystal
-	int i,j;
-	for(i=0;i<miliSec;i++) {
-		for(j=0;j<775;j++) {
-			asm("nop");
-		}
-	}
-}
-
-/*-------------------------------------------------------------------------*/
-
-void LCD_WriteCommand (unsigned char Command) {
-	CLR_BIT(CONTROL_BUS,RS);
-	DATA_BUS = Command;
+// Latches one byte into the LCD without waiting for it to execute
+// rs = 0 for a command, 1 for character data
+void LCD_BusWrite(unsigned char rs, unsigned char value) {
+	if (rs)
+		SET_BIT(CONTROL_BUS,RS);
+	else
+		CLR_BIT(CONTROL_BUS,RS);
+	DATA_BUS = value;
 	SET_BIT(CONTROL_BUS,E);
 	asm("nop");
 	CLR_BIT(CONTROL_BUS,E);
-	delay_ms(2); // ClearScreen requires 1.52ms to execute
+}
+
+void LCD_WriteCommand (unsigned char Command) {
+	LCD_BusWrite(0, Command);
+	if (Command <= 0x03)
+		delay_ms(2); // ClearScreen/ReturnHome require 1.52ms to execute
+	else
+		delay_us(40); // All other commands take 37us
 }
 
 void LCD_ClearScreen(void) {
@@ -53,12 +55,8 @@ void LCD_init(void) {
 }
 
 void LCD_WriteData(unsigned char Data) {
-	SET_BIT(CONTROL_BUS,RS);
-	DATA_BUS = Data;
-	SET_BIT(CONTROL_BUS,E);
-	asm("nop");
-	CLR_BIT(CONTROL_BUS,E);
-	delay_ms(1);
+	LCD_BusWrite(1, Data);
+	delay_us(40);
 }
 
 void LCD_Cursor(unsigned char column) {
@@ -0,0 +1,164 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Frame buffered 16x2 LCD for FreeRTOS builds.
+// Tasks draw into a 32 byte shadow of the display, which costs no bus time.
+// Each changed cell is marked dirty and LCDBuf_FlushTask, running at low
+// priority, writes only the cells that differ from what the LCD already
+// shows. Consecutive cells share one address command (the HD44780 auto-
+// increments). Clearing is done in the buffer, so the slow clear display
+// command is only used once, at init.
+// Cells are numbered 1-32 as in LCD_Cursor(): 1-16 top row, 17-32 bottom.
+
+#ifndef LCD_BUFFER_H
+#define LCD_BUFFER_H
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "lcd.h"
+
+#define LCD_CELLS 32
+
+unsigned char lcdFrame[LCD_CELLS];		// What the tasks want shown
+unsigned char lcdShown[LCD_CELLS];		// What the LCD currently shows
+volatile unsigned long lcdDirty;		// Bit n set: cell n+1 changed since last flush
+unsigned short lcdBusWrites;			// Bus writes since init (flush cost)
+unsigned short lcdFlushes;				// Flushes that wrote at least one cell
+xSemaphoreHandle lcdDirtySignal;		// Given when a cell becomes dirty
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes one byte to the LCD and waits for it to execute
+//Parameter: rs = 0 for a command, 1 for data
+//Returns: None
+void LCDBuf_BusWrite(unsigned char rs, unsigned char value)
+{
+	LCD_BusWrite(rs, value);
+	delay_us(40); // HD44780 data and address writes take 37 us
+	lcdBusWrites++;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Initializes the LCD and a blank frame buffer
+//				  Call before the scheduler starts (LCD_init busy-waits)
+//Parameter: None
+//Returns: 1 if set up else 0 (no heap for the semaphore)
+unsigned char LCDBuf_Init(void)
+{
+	LCD_init(); // Ends with a clear display, so the LCD is all spaces
+	memset(lcdFrame, ' ', LCD_CELLS);
+	memset(lcdShown, ' ', LCD_CELLS);
+	lcdDirty = 0;
+	lcdBusWrites = 0;
+	lcdFlushes = 0;
+	vSemaphoreCreateBinary(lcdDirtySignal);
+	if (!lcdDirtySignal) {
+		return 0;
+	}
+	xSemaphoreTake(lcdDirtySignal, 0);
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Puts a character into the frame buffer
+//Parameter: column is the cell (1-32), c is the character
+//Returns: None
+void LCDBuf_WriteChar(unsigned char column, unsigned char c)
+{
+	unsigned char cell = column - 1;
+
+	if (cell >= LCD_CELLS || lcdFrame[cell] == c) {
+		return;
+	}
+	lcdFrame[cell] = c;
+	taskENTER_CRITICAL();
+	lcdDirty |= 1UL << cell;
+	taskEXIT_CRITICAL();
+	xSemaphoreGive(lcdDirtySignal);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a string into the frame buffer, clipped at cell 32
+//Parameter: column is the first cell (1-32)
+//Returns: None
+void LCDBuf_WriteString(unsigned char column, const char* string)
+{
+	while (*string && column <= LCD_CELLS) {
+		LCDBuf_WriteChar(column++, *string++);
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Blanks the frame buffer
+//Parameter: None
+//Returns: None
+void LCDBuf_Clear(void)
+{
+	unsigned char column;
+	for (column = 1; column <= LCD_CELLS; column++) {
+		LCDBuf_WriteChar(column, ' ');
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Buffered equivalent of LCD_DisplayString (clear, then write)
+//				  Cells that end up unchanged cost nothing to flush
+//Parameter: column is the first cell (1-32)
+//Returns: None
+void LCDBuf_DisplayString(unsigned char column, const char* string)
+{
+	LCDBuf_Clear();
+	LCDBuf_WriteString(column, string);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes every dirty cell that differs from the display
+//Parameter: None
+//Returns: Number of bus writes made
+unsigned char LCDBuf_Flush(void)
+{
+	unsigned long dirty;
+	unsigned char cell, c, writes = 0;
+	unsigned char nextCell = 0xFF; // Cell the LCD address counter points at
+
+	taskENTER_CRITICAL();
+	dirty = lcdDirty;
+	lcdDirty = 0;
+	taskEXIT_CRITICAL();
+
+	for (cell = 0; dirty; cell++, dirty >>= 1) {
+		if (!(dirty & 1)) {
+			continue;
+		}
+		// A cell rewritten after this point is marked dirty again
+		c = lcdFrame[cell];
+		if (c == lcdShown[cell]) {
+			continue;
+		}
+		if (cell != nextCell) {
+			// Set DDRAM address: top row at 0x00, bottom row at 0x40
+			LCDBuf_BusWrite(0, (cell < 16) ? 0x80 + cell : 0xC0 + cell - 16);
+			writes++;
+		}
+		LCDBuf_BusWrite(1, c);
+		writes++;
+		lcdShown[cell] = c;
+		nextCell = (cell == 15) ? 0xFF : cell + 1; // No wrap to the second row
+	}
+	if (writes) {
+		lcdFlushes++;
+	}
+	return writes;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Task body: flushes the frame buffer whenever it changes
+//				  Create at a lower priority than the tasks that draw
+//Parameter: None
+//Returns: None
+void LCDBuf_FlushTask()
+{
+	for(;;)
+	{
+		xSemaphoreTake(lcdDirtySignal, portMAX_DELAY);
+		LCDBuf_Flush();
+	}
+}
+
+#endif //LCD_BUFFER_H
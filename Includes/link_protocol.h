@@ -0,0 +1,349 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Framed, checksummed message link between the two microcontrollers.
+//
+// Frame layout (all fields one byte):
+//   START(0x7E) LEN SEQ TYPE PAYLOAD[LEN] CRC8
+// LEN is the payload length (0..LINK_MAX_PAYLOAD). CRC8 (poly 0x07, init 0)
+// covers LEN, SEQ, TYPE and the payload. The receiver resynchronises on the
+// next START byte after any bad length or checksum.
+//
+// Data frames are sent stop-and-wait: each must be answered by an ACK frame
+// carrying the same SEQ before the next is sent. A frame is retransmitted on
+// a NAK (bad checksum at the receiver) or after LINK_RETRY_TICKS without an
+// ACK. After LINK_MAX_RETRIES retransmits the peer is taken to be down
+// (resetting, or replaying its ledger) and the wait doubles on each further
+// retransmit, up to LINK_BACKOFF_TICKS; a frame is never given up, as
+// messages carry money. Duplicates caused by a lost ACK are ACKed again but
+// not delivered twice.
+// SEQ starts over at 0 when a microcontroller resets, so Link_Init() queues
+// a LINK_RESET frame ahead of any message: the peer ACKs it and forgets the
+// last SEQ it delivered, so the first message of the new session cannot be
+// taken for a duplicate of the old one's last. A LINK_RESET received also
+// resends the frame awaiting its ACK at once, as the peer is back.
+//
+// Link_Service() does all of the above and is meant to be the body of one
+// task per link. It sleeps on the USART RX semaphore, which Link_Send() also
+// gives to wake it when there is something new to send.
+
+#ifndef LINK_PROTOCOL_H
+#define LINK_PROTOCOL_H
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h" // FreeRTOS queue.h; Includes/queue.h shares its guard
+#include "usart_isr_ATmega1284.h"
+
+#define LINK_START			0x7E
+#define LINK_MAX_PAYLOAD	6
+#define LINK_HEADER_SIZE	4	// START LEN SEQ TYPE
+#define LINK_MAX_FRAME		(LINK_HEADER_SIZE + LINK_MAX_PAYLOAD + 1)
+
+// Retransmit timeout: a maximum frame plus its ACK take ~4 ms at 38400 baud
+// (USART1_BAUD), leaving room for the receiving task to be scheduled
+#ifndef LINK_RETRY_TICKS
+#define LINK_RETRY_TICKS	20
+#endif
+#ifndef LINK_MAX_RETRIES
+#define LINK_MAX_RETRIES	5
+#endif
+// Longest wait between retransmits once the peer is taken to be down
+#ifndef LINK_BACKOFF_TICKS
+#define LINK_BACKOFF_TICKS	500
+#endif
+// Messages Link_Send() can queue ahead of the one being sent
+#ifndef LINK_TX_QUEUE_LENGTH
+#define LINK_TX_QUEUE_LENGTH	4
+#endif
+
+// Message types
+#define LINK_ACK				0x01	// No payload, SEQ = frame acknowledged
+#define LINK_NAK				0x02	// No payload, SEQ = frame rejected
+#define LINK_RESET				0x03	// No payload, first frame after a reset: new session
+#define LINK_COIN_INSERTED		0x10	// No payload
+#define LINK_SELECTION			0x11	// [product, ...]: one or more, bought in order
+#define LINK_DISPENSE_RESULT	0x12	// [product, result, time ms hi, time ms lo]
+#define LINK_BALANCE			0x13	// [coins]
+#define LINK_STATUS_REQUEST		0x14	// No payload
+#define LINK_STATUS				0x15	// [coins, dispenses queued or running]
+#define LINK_PRICE_REQUEST		0x16	// [product]
+#define LINK_PRICE				0x17	// [product, price in coins], price 0: no such product
+
+// LINK_DISPENSE_RESULT result codes
+#define LINK_DISPENSE_OK			0x00
+#define LINK_DISPENSE_INSUFFICIENT	0x01
+#define LINK_DISPENSE_BUSY			0x02	// The product's dispense queue is full
+#define LINK_DISPENSE_JAMMED		0x03	// Nothing dropped; the price was refunded
+
+typedef struct _LinkMsg
+{
+	unsigned char type;
+	unsigned char len;
+	unsigned char data[LINK_MAX_PAYLOAD];
+} LinkMsg;
+
+enum LinkRxState {LRX_START,LRX_LEN,LRX_SEQ,LRX_TYPE,LRX_DATA,LRX_CRC};
+
+typedef struct _Link
+{
+	unsigned char usartNum;
+	xQueueHandle txQueue;				// LinkMsg waiting to be sent
+	void (*deliver)(const LinkMsg*);	// Called from the link task per new message
+
+	// Receiver
+	unsigned char rxState;
+	unsigned char rxIndex;
+	unsigned char rxCrc;
+	unsigned char rxSeq;
+	unsigned char rxLastSeq;			// SEQ of the last delivered frame
+	unsigned char rxSeqValid;			// rxLastSeq holds a real value
+	LinkMsg rxMsg;
+
+	// Sender
+	LinkMsg pending;					// Frame awaiting its ACK
+	unsigned char pendingValid;
+	unsigned char txSeq;
+	unsigned char retries;
+	portTickType sentAt;
+	portTickType retryTicks;			// Wait for the ACK before resending
+
+	// Statistics
+	unsigned short framesSent;
+	unsigned short retransmits;
+	unsigned short crcErrors;
+	unsigned short duplicates;
+	unsigned short stalls;				// Frames still unACKed after LINK_MAX_RETRIES
+	unsigned short resets;				// LINK_RESETs received: the peer restarted
+} Link;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Updates a CRC-8 (polynomial x^8 + x^2 + x + 1) with one byte
+//Parameter: crc is the running value, data is the next byte
+//Returns: The new CRC value
+unsigned char Link_Crc8(unsigned char crc, unsigned char data)
+{
+	unsigned char i;
+	crc ^= data;
+	for (i = 0; i < 8; i++) {
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+	}
+	return crc;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Initializes a link over a buffered USART and queues the
+//				  LINK_RESET that starts the session
+//Parameter: l is the link, usartNum the USART (already USART_BufferedInit'ed)
+//			 deliver is called for every new message received
+//Returns: 1 if set up else 0 (no heap for the queue)
+unsigned char Link_Init(Link* l, unsigned char usartNum, void (*deliver)(const LinkMsg*))
+{
+	LinkMsg reset;
+
+	memset(l, 0, sizeof(Link));
+	l->usartNum = usartNum;
+	l->deliver = deliver;
+	l->rxState = LRX_START;
+	l->txQueue = xQueueCreate(LINK_TX_QUEUE_LENGTH, sizeof(LinkMsg));
+	if (!l->txQueue) {
+		return 0;
+	}
+	reset.type = LINK_RESET;
+	reset.len = 0;
+	xQueueSend(l->txQueue, &reset, 0);
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Queues a message for reliable delivery
+//Parameter: l is the link, type/data/len the message
+//Returns: 1 if queued else 0 (queue full: the peer has been down a while);
+//		   the caller keeps the message and tries again later
+unsigned char Link_Send(Link* l, unsigned char type, const unsigned char* data, unsigned char len)
+{
+	LinkMsg msg;
+
+	if (len > LINK_MAX_PAYLOAD) {
+		return 0;
+	}
+	msg.type = type;
+	msg.len = len;
+	memcpy(msg.data, data, len);
+	if (xQueueSend(l->txQueue, &msg, 0) != pdPASS) {
+		return 0;
+	}
+	USART_WakeWaiter(l->usartNum); // Wake Link_Service if it is sleeping
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes one frame to the USART TX buffer
+//Parameter: l is the link, seq/type/data/len the frame contents
+//Returns: None
+void Link_WriteFrame(Link* l, unsigned char seq, unsigned char type, const unsigned char* data, unsigned char len)
+{
+	unsigned char frame[LINK_MAX_FRAME];
+	unsigned char crc, i, n = 0;
+
+	frame[n++] = LINK_START;
+	frame[n++] = len;
+	frame[n++] = seq;
+	frame[n++] = type;
+	for (i = 0; i < len; i++) {
+		frame[n++] = data[i];
+	}
+	crc = 0;
+	for (i = 1; i < n; i++) {
+		crc = Link_Crc8(crc, frame[i]);
+	}
+	frame[n++] = crc;
+
+	for (i = 0; i < n; i++) {
+		while (!USART_Write(l->usartNum, frame[i])) {
+			vTaskDelay(1); // TX buffer full; it drains in well under a tick
+		}
+	}
+	l->framesSent++;
+}
+
+// Handles a complete, checksum-valid frame
+static void Link_Dispatch(Link* l)
+{
+	switch(l->rxMsg.type){
+		case LINK_ACK:
+			if (l->pendingValid && l->rxSeq == l->txSeq) {
+				l->pendingValid = 0;
+				l->txSeq++;
+			}
+			break;
+		case LINK_NAK:
+			if (l->pendingValid) {
+				l->sentAt = xTaskGetTickCount() - l->retryTicks; // Resend now
+			}
+			break;
+		case LINK_RESET:
+			// The peer restarted and its SEQ with it; a repeat (our ACK was
+			// lost) comes before any of its messages, so is harmless
+			Link_WriteFrame(l, l->rxSeq, LINK_ACK, NULL, 0);
+			l->rxSeqValid = 0;
+			l->resets++;
+			if (l->pendingValid) {
+				// It is listening again: resend now, not after the backoff
+				l->retries = 0;
+				l->retryTicks = LINK_RETRY_TICKS;
+				l->sentAt = xTaskGetTickCount() - LINK_RETRY_TICKS;
+			}
+			break;
+		default:
+			Link_WriteFrame(l, l->rxSeq, LINK_ACK, NULL, 0);
+			if (l->rxSeqValid && l->rxSeq == l->rxLastSeq) {
+				l->duplicates++; // Our ACK was lost; already delivered
+				break;
+			}
+			l->rxLastSeq = l->rxSeq;
+			l->rxSeqValid = 1;
+			if (l->deliver) {
+				l->deliver(&l->rxMsg);
+			}
+			break;
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Feeds one received byte to the frame decoder
+//Parameter: l is the link, data is the byte
+//Returns: None
+void Link_RxByte(Link* l, unsigned char data)
+{
+	switch(l->rxState){
+		case LRX_START:
+			if (data == LINK_START)
+				l->rxState = LRX_LEN;
+			break;
+		case LRX_LEN:
+			if (data > LINK_MAX_PAYLOAD) {
+				l->rxState = (data == LINK_START) ? LRX_LEN : LRX_START;
+				break;
+			}
+			l->rxMsg.len = data;
+			l->rxCrc = Link_Crc8(0, data);
+			l->rxState = LRX_SEQ;
+			break;
+		case LRX_SEQ:
+			l->rxSeq = data;
+			l->rxCrc = Link_Crc8(l->rxCrc, data);
+			l->rxState = LRX_TYPE;
+			break;
+		case LRX_TYPE:
+			l->rxMsg.type = data;
+			l->rxCrc = Link_Crc8(l->rxCrc, data);
+			l->rxIndex = 0;
+			l->rxState = l->rxMsg.len ? LRX_DATA : LRX_CRC;
+			break;
+		case LRX_DATA:
+			l->rxMsg.data[l->rxIndex++] = data;
+			l->rxCrc = Link_Crc8(l->rxCrc, data);
+			if (l->rxIndex >= l->rxMsg.len)
+				l->rxState = LRX_CRC;
+			break;
+		case LRX_CRC:
+			l->rxState = LRX_START;
+			if (data != l->rxCrc) {
+				l->crcErrors++;
+				if (l->rxMsg.type != LINK_ACK && l->rxMsg.type != LINK_NAK)
+					Link_WriteFrame(l, l->rxSeq, LINK_NAK, NULL, 0);
+				break;
+			}
+			Link_Dispatch(l);
+			break;
+		default:
+			l->rxState = LRX_START;
+			break;
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs the link once: decodes received bytes, sends the next
+//				  queued message, retransmits on timeout, then sleeps until a
+//				  byte arrives, a message is queued or the retransmit is due
+//Parameter: l is the link
+//Returns: None
+void Link_Service(Link* l)
+{
+	unsigned char data;
+	portTickType now, wait;
+
+	while (USART_Read(l->usartNum, &data)) {
+		Link_RxByte(l, data);
+	}
+
+	if (!l->pendingValid && xQueueReceive(l->txQueue, &l->pending, 0) == pdPASS) {
+		l->pendingValid = 1;
+		l->retries = 0;
+		l->retryTicks = LINK_RETRY_TICKS;
+		Link_WriteFrame(l, l->txSeq, l->pending.type, l->pending.data, l->pending.len);
+		l->sentAt = xTaskGetTickCount();
+	}
+
+	wait = portMAX_DELAY;
+	if (l->pendingValid) {
+		now = xTaskGetTickCount();
+		if ((portTickType)(now - l->sentAt) >= l->retryTicks) {
+			if (l->retries < LINK_MAX_RETRIES) {
+				l->retries++;
+			} else {
+				// The peer is down: keep trying, less and less often
+				if (l->retryTicks == LINK_RETRY_TICKS) {
+					l->stalls++;
+				}
+				l->retryTicks = (l->retryTicks < LINK_BACKOFF_TICKS / 2) ? l->retryTicks * 2 : LINK_BACKOFF_TICKS;
+			}
+			l->retransmits++;
+			Link_WriteFrame(l, l->txSeq, l->pending.type, l->pending.data, l->pending.len);
+			l->sentAt = now;
+		}
+		wait = l->retryTicks - (portTickType)(now - l->sentAt);
+	}
+	USART_WaitForData(l->usartNum, wait);
+}
+
+#endif //LINK_PROTOCOL_H
@@ -0,0 +1,224 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Periodic tasks for FreeRTOS builds.
+// Each PeriodicTask wraps a state machine's Init and Tick functions in a
+// task released every period ticks by vTaskDelayUntil(), so the period does
+// not stretch by the time the Tick takes, as it does with vTaskDelay().
+// Periodic_Start() assigns priorities rate monotonically (the shorter the
+// period, the higher the priority) and creates the tasks.
+// Per task it counts releases, deadline misses (the Tick finishing deadline
+// or more ticks after its release) and skipped releases: a task still busy
+// when its next release has fully passed waits for the one after instead of
+// running late Ticks back to back. It also measures, with the run-time
+// counter (runtime_stats.h), each release's period jitter (the time since
+// the previous release less the nominal period) and the worst response time
+// (release to the end of the Tick).
+// Periodic_Dump() writes the statistics to a buffered USART for
+// Tools/rtstats.py --periodic to decode (multi-byte fields little-endian):
+//   'P' 'T' VERSION COUNT COUNTS_PER_US TICK_COUNTS[2]
+//   COUNT times: NAME[configMAX_TASK_NAME_LEN] PERIOD[2] DEADLINE[2] PRIORITY
+//                RELEASES[4] MISSES[2] SKIPPED[2] JITTER_MIN[4] JITTER_MAX[4]
+//                JITTER_ABS_SUM[4] WORST_RESPONSE[4]
+//   CRC8
+// As in RunTime_Dump(), the CRC covers everything after 'P' 'T'. Times are
+// in run-time counts; JITTER_MIN and JITTER_MAX are signed.
+
+#ifndef PERIODIC_H
+#define PERIODIC_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "runtime_stats.h" // RunTime_Now, RunTime_WriteByte, RunTime_WriteLong
+
+#define PERIODIC_REQUEST 'P'	// Received byte that asks for a dump
+#define PERIODIC_VERSION 1
+
+// Run-time counts in one tick
+#define PERIODIC_TICK_COUNTS (TIMING_TICKS_PER_US * 1000000UL / configTICK_RATE_HZ)
+
+typedef struct _PeriodicTask
+{
+	// Set by the application, see PERIODIC_TASK
+	const char* name;
+	void (*init)(void);
+	void (*tick)(void);
+	portTickType period;		// Ticks between releases
+	portTickType deadline;		// Ticks after a release the Tick must end by
+	unsigned short stackDepth;
+	// Set by Periodic_Start
+	unsigned portBASE_TYPE priority;
+	// Statistics
+	unsigned long releases;
+	unsigned short misses;		// Ticks that ended at or after the deadline
+	unsigned short skipped;		// Releases passed over while late
+	long jitterMin;				// Period jitter, run-time counts
+	long jitterMax;
+	unsigned long jitterAbsSum;	// Sum of |jitter|, for the mean
+	unsigned long worstResponse;	// Release to end of Tick, run-time counts
+} PeriodicTask;
+
+// Initializer for a PeriodicTask array entry; deadline == period is usual.
+// stackDepth covers Periodic_Task's own frame as well as the Tick's: about
+// 40 bytes on the AVR, as its statistics locals are 32-bit
+#define PERIODIC_TASK(name, init, tick, period, deadline, stackDepth) \
+	{ (name), (init), (tick), (period), (deadline), (stackDepth), \
+	  0, 0, 0, 0, 0x7FFFFFFFL, -0x7FFFFFFFL - 1, 0, 0 }
+
+PeriodicTask* periodicTasks;
+unsigned char periodicCount;
+PeriodicTask periodicSnapshot;	// Filled by Periodic_Dump, off the caller's small stack
+
+// Whether tasks[i] is the first of the tasks with its period
+static unsigned char Periodic_FirstOfPeriod(const PeriodicTask* tasks, unsigned char i)
+{
+	unsigned char j;
+
+	for (j = 0; j < i; j++) {
+		if (tasks[j].period == tasks[i].period) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Body of every periodic task: runs init once, then tick
+//				  once per period
+//Parameter: pvParameters is the task's PeriodicTask
+//Returns: Never
+void Periodic_Task(void* pvParameters)
+{
+	PeriodicTask* t = (PeriodicTask*)pvParameters;
+	portTickType lastWake, elapsed;
+	unsigned long start, previous = 0, response, nominal;
+	long jitter;
+	unsigned short periodsSince = 1;	// Periods since the previous release
+
+	t->init();
+	lastWake = xTaskGetTickCount();
+	for(;;)
+	{
+		start = RunTime_Now();
+		if (t->releases) {
+			nominal = (unsigned long)periodsSince * t->period * PERIODIC_TICK_COUNTS;
+			jitter = (long)(start - previous - nominal);
+			if (jitter < t->jitterMin) {
+				t->jitterMin = jitter;
+			}
+			if (jitter > t->jitterMax) {
+				t->jitterMax = jitter;
+			}
+			t->jitterAbsSum += (jitter < 0) ? -jitter : jitter;
+		}
+		previous = start;
+		t->releases++;
+
+		t->tick();
+
+		response = RunTime_Now() - start;
+		if (response > t->worstResponse) {
+			t->worstResponse = response;
+		}
+		elapsed = xTaskGetTickCount() - lastWake;
+		if (elapsed >= t->deadline) {
+			t->misses++;
+		}
+		// A release whose tick is over is skipped; one due this tick runs now
+		periodsSince = 1;
+		while (elapsed > t->period) {
+			lastWake += t->period;
+			elapsed -= t->period;
+			t->skipped++;
+			periodsSince++;
+		}
+		vTaskDelayUntil(&lastWake, t->period);
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Assigns rate monotonic priorities and creates the tasks
+//				  Distinct periods get distinct priorities, from
+//				  lowestPriority up to configMAX_PRIORITIES - 1; if there
+//				  are more periods than that, the longest ones share
+//				  lowestPriority
+//Parameter: tasks and count describe the periodic tasks, which must stay
+//			 valid while the scheduler runs
+//Returns: 1 if every task was created else 0
+unsigned char Periodic_Start(PeriodicTask* tasks, unsigned char count, unsigned portBASE_TYPE lowestPriority)
+{
+	unsigned char i, j, shorter, distinct = 0, created = 1;
+	unsigned portBASE_TYPE top;
+
+	periodicTasks = tasks;
+	periodicCount = count;
+	for (i = 0; i < count; i++) {
+		distinct += Periodic_FirstOfPeriod(tasks, i);
+	}
+	top = lowestPriority + distinct - 1;
+	if (top > configMAX_PRIORITIES - 1) {
+		top = configMAX_PRIORITIES - 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		// Rank = distinct periods shorter than this one
+		shorter = 0;
+		for (j = 0; j < count; j++) {
+			if (tasks[j].period < tasks[i].period) {
+				shorter += Periodic_FirstOfPeriod(tasks, j);
+			}
+		}
+		tasks[i].priority = (top - lowestPriority > shorter) ? top - shorter : lowestPriority;
+		if (xTaskCreate(Periodic_Task, (signed portCHAR *)tasks[i].name, tasks[i].stackDepth,
+				&tasks[i], tasks[i].priority, NULL) != pdPASS) {
+			created = 0;
+		}
+	}
+	return created;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a binary snapshot of the periodic tasks' statistics
+//				  Call from the only task writing to that USART
+//Parameter: usartNum is a USART set up with USART_BufferedInit
+//Returns: None
+void Periodic_Dump(unsigned char usartNum)
+{
+	unsigned char i, j, end;
+	PeriodicTask* t = &periodicSnapshot;
+
+	RunTime_WriteByte(usartNum, 'P');
+	RunTime_WriteByte(usartNum, 'T');
+	runTimeCrc = 0;
+	RunTime_WriteByte(usartNum, PERIODIC_VERSION);
+	RunTime_WriteByte(usartNum, periodicCount);
+	RunTime_WriteByte(usartNum, TIMING_TICKS_PER_US);
+	RunTime_WriteLong(usartNum, PERIODIC_TICK_COUNTS, 2);
+	for (i = 0; i < periodicCount; i++) {
+		// Copied at once, since the task updates it while this writes
+		portENTER_CRITICAL();
+		*t = periodicTasks[i];
+		portEXIT_CRITICAL();
+		end = 0;
+		for (j = 0; j < configMAX_TASK_NAME_LEN; j++) {
+			if (!end && !t->name[j]) {
+				end = 1;
+			}
+			// As the kernel stores it: truncated, no terminator when full
+			RunTime_WriteByte(usartNum, end ? 0 : t->name[j]);
+		}
+		RunTime_WriteLong(usartNum, t->period, 2);
+		RunTime_WriteLong(usartNum, t->deadline, 2);
+		RunTime_WriteByte(usartNum, t->priority);
+		RunTime_WriteLong(usartNum, t->releases, 4);
+		RunTime_WriteLong(usartNum, t->misses, 2);
+		RunTime_WriteLong(usartNum, t->skipped, 2);
+		RunTime_WriteLong(usartNum, t->jitterMin, 4);
+		RunTime_WriteLong(usartNum, t->jitterMax, 4);
+		RunTime_WriteLong(usartNum, t->jitterAbsSum, 4);
+		RunTime_WriteLong(usartNum, t->worstResponse, 4);
+	}
+	RunTime_WriteByte(usartNum, runTimeCrc);
+}
+
+#endif //PERIODIC_H
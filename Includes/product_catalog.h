@@ -0,0 +1,74 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Product catalog, shared by both microcontrollers.
+// Products are numbered by slot, 1 to CATALOG_SLOTS, as customers select
+// them (keypad, Bluetooth ORDER) and as the link carries them. The table
+// is generated from CATALOG_PRODUCTS at compile time and kept in flash,
+// indexed by slot - 1, so a lookup is one pgm_read_byte whatever the
+// number of slots. Slots left out of CATALOG_PRODUCTS read as price 0: no
+// such product. To add a product, add a line:
+//   X(slot, price in coins, motor, display name)
+// motor is the stepper channel (stepper.h) turning the slot's spiral, and
+// the drop beam under it; the name, up to CATALOG_NAME_LENGTH characters,
+// is shown on the LCD while it dispenses.
+
+#ifndef PRODUCT_CATALOG_H
+#define PRODUCT_CATALOG_H
+
+#include <avr/pgmspace.h>
+
+// A board with other products defines its own before including this file
+#ifndef CATALOG_PRODUCTS
+#define CATALOG_PRODUCTS(X) \
+	X(1, 1, 0, "PRODUCT1") \
+	X(2, 2, 1, "PRODUCT2")
+#endif
+
+#define CATALOG_NAME_LENGTH 14	// Fits the LCD row between '<' and '>'
+
+typedef struct _Product
+{
+	unsigned char price;	// Coins, 0: no product in the slot
+	unsigned char motor;	// Stepper channel and drop beam
+	char name[CATALOG_NAME_LENGTH + 1];
+} Product;
+
+#define CATALOG_ENTRY(slot, price, motor, name) [(slot) - 1] = {price, motor, name},
+const Product catalog[] PROGMEM = {
+	CATALOG_PRODUCTS(CATALOG_ENTRY)
+};
+#define CATALOG_SLOTS (sizeof(catalog) / sizeof(catalog[0]))
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Looks up a slot's price
+//Parameter: slot is the slot number (any value)
+//Returns: Price in coins, 0 if there is no product in the slot
+unsigned char Catalog_Price(unsigned char slot)
+{
+	if (slot < 1 || slot > CATALOG_SLOTS) {
+		return 0;
+	}
+	return pgm_read_byte(&catalog[slot - 1].price);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Looks up the motor that dispenses a slot
+//Parameter: slot is the slot number, with a product in it
+//Returns: Stepper channel
+unsigned char Catalog_Motor(unsigned char slot)
+{
+	return pgm_read_byte(&catalog[slot - 1].motor);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Copies a slot's display name out of flash
+//Parameter: slot is the slot number, with a product in it, name receives
+//			 up to CATALOG_NAME_LENGTH characters and a '\0'
+//Returns: None
+void Catalog_Name(unsigned char slot, char* name)
+{
+	memcpy_P(name, catalog[slot - 1].name, CATALOG_NAME_LENGTH + 1);
+}
+
+#endif //PRODUCT_CATALOG_H
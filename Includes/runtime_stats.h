@@ -0,0 +1,151 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Per-task run-time statistics for FreeRTOS builds.
+// Timer3, already free running at 1 MHz as the timing.h timebase, is the
+// kernel's run-time counter (configGENERATE_RUN_TIME_STATS). Its overflow
+// interrupt extends it to 32 bits, so it wraps after ~71 minutes instead of
+// 65 ms and stays valid across long tickless idle sleeps.
+// RunTime_Dump() writes a binary snapshot of every task to a buffered USART
+// for Tools/rtstats.py to decode (multi-byte fields little-endian):
+//   'R' 'T' VERSION COUNT COUNTS_PER_US TOTAL[4] TICKS[2]
+//   COUNT times: NAME[configMAX_TASK_NAME_LEN] RUNTIME[4] SWITCHES[4]
+//                STACK[2] PRIORITY STATE
+//   CRC8
+// The CRC (Link_Crc8) covers everything after 'R' 'T'. STACK is the least
+// free stack the task has had, in bytes; STATE is 'R', 'B', 'D' or 'S'.
+
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timing.h"
+#include "usart_isr_ATmega1284.h"
+#include "link_protocol.h" // Link_Crc8
+
+#define RUNTIME_REQUEST 'S'		// Received byte that asks for a dump
+#define RUNTIME_VERSION 1
+
+// Tasks reported, override before including this file if needed
+#ifndef RUNTIME_MAX_TASKS
+#define RUNTIME_MAX_TASKS 8
+#endif
+
+volatile unsigned short runTimeHigh;				// Upper half: Timer3 overflows
+xTaskRunTimeRecord runTimeRecords[RUNTIME_MAX_TASKS];	// Filled by RunTime_Dump
+unsigned char runTimeCrc;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Enables the Timer3 overflow count; called by the kernel
+//				  when the scheduler starts (portCONFIGURE_TIMER_FOR_RUN_TIME_STATS)
+//Parameter: None
+//Returns: None
+void RunTime_TimerInit(void)
+{
+	if (!(TCCR3B & ((1 << CS32) | (1 << CS31) | (1 << CS30)))) {
+		Timing_Init();
+	}
+	runTimeHigh = 0;
+	TIMSK3 |= (1 << TOIE3);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads the 32-bit run-time counter; called by the kernel on
+//				  every context switch (portGET_RUN_TIME_COUNTER_VALUE)
+//Parameter: None
+//Returns: Timer3 counts since RunTime_TimerInit, wrapping at 2^32
+unsigned long RunTime_Now(void)
+{
+	unsigned char sreg = SREG;
+	unsigned short high, low;
+
+	cli();
+	low = TCNT3;
+	high = runTimeHigh;
+	if ((TIFR3 & (1 << TOV3)) && low < 0x8000) {
+		high++; // Wrapped, but the overflow ISR has not run yet
+	}
+	SREG = sreg;
+	return ((unsigned long)high << 16) | low;
+}
+
+ISR(TIMER3_OVF_vect)
+{
+	runTimeHigh++;
+}
+
+// Writes one byte of a dump, waiting for room rather than dropping it
+static void RunTime_WriteByte(unsigned char usartNum, unsigned char data)
+{
+	runTimeCrc = Link_Crc8(runTimeCrc, data);
+	while (!USART_Write(usartNum, data)) {
+		vTaskDelay(1); // TX buffer full
+	}
+}
+
+static void RunTime_WriteLong(unsigned char usartNum, unsigned long value, unsigned char bytes)
+{
+	while (bytes--) {
+		RunTime_WriteByte(usartNum, value & 0xFF);
+		value >>= 8;
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a binary snapshot of all tasks' statistics
+//				  Call from the only task writing to that USART
+//Parameter: usartNum is a USART set up with USART_BufferedInit
+//Returns: None
+void RunTime_Dump(unsigned char usartNum)
+{
+	unsigned long total;
+	portTickType ticks = xTaskGetTickCount();
+	unsigned char count, i, j;
+	xTaskRunTimeRecord* r;
+
+	count = uxTaskGetRunTimeRecords(runTimeRecords, RUNTIME_MAX_TASKS, &total);
+
+	RunTime_WriteByte(usartNum, 'R');
+	RunTime_WriteByte(usartNum, 'T');
+	runTimeCrc = 0;
+	RunTime_WriteByte(usartNum, RUNTIME_VERSION);
+	RunTime_WriteByte(usartNum, count);
+	RunTime_WriteByte(usartNum, TIMING_TICKS_PER_US);
+	RunTime_WriteLong(usartNum, total, 4);
+	RunTime_WriteLong(usartNum, ticks, 2);
+	for (i = 0; i < count; i++) {
+		r = &runTimeRecords[i];
+		for (j = 0; j < configMAX_TASK_NAME_LEN; j++) {
+			RunTime_WriteByte(usartNum, r->pcTaskName[j]);
+		}
+		RunTime_WriteLong(usartNum, r->ulRunTimeCounter, 4);
+		RunTime_WriteLong(usartNum, r->ulSwitchInCount, 4);
+		RunTime_WriteLong(usartNum, r->usStackHighWaterMark * sizeof(portSTACK_TYPE), 2);
+		RunTime_WriteByte(usartNum, r->ucPriority);
+		RunTime_WriteByte(usartNum, r->cState);
+	}
+	RunTime_WriteByte(usartNum, runTimeCrc);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads the bytes received on a USART used for nothing else
+//				  and answers RUNTIME_REQUEST with a dump
+//Parameter: usartNum is a USART set up with USART_BufferedInit
+//Returns: 1 if a dump was written else 0
+unsigned char RunTime_Poll(unsigned char usartNum)
+{
+	unsigned char data, requested = 0;
+
+	while (USART_Read(usartNum, &data)) {
+		if (data == RUNTIME_REQUEST) {
+			requested = 1;
+		}
+	}
+	if (requested) {
+		RunTime_Dump(usartNum);
+	}
+	return requested;
+}
+
+#endif //RUNTIME_STATS_H
@@ -0,0 +1,116 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Daisy-chained 74HC595 outputs on the hardware SPI, for FreeRTOS builds.
+// Wiring: MOSI (PB5) to the first register's SER, SCK (PB7) to every
+// SRCLK, SS (PB4) to every RCLK; each register's QH' feeds the next one's
+// SER, SRCLR is tied high and OE low. Registers are numbered from 0, the
+// one next to the microcontroller.
+// ShiftReg_Write() only updates a RAM copy of the outputs and, if the SPI
+// is idle, loads the first byte; the SPI shifts each byte out in 16 CPU
+// cycles (SCK at F_CPU/2) and its transfer complete interrupt loads the
+// next, then latches the whole chain with a rising edge on RCLK, so the
+// outputs change together. Writes made during a transfer are sent, as one
+// frame with the latest values, when it ends. This replaces transmit_data
+// (shiftreg.h), which bit-bangs each bit with read-modify-writes of PORTD
+// while the caller waits.
+
+#ifndef SHIFTREG_SPI_H
+#define SHIFTREG_SPI_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#define SPI_MASTER_ONLY // SPI_STC_vect is ours
+#include "spi_ATmega1284.h"
+
+// Registers in the chain, override before including this file if needed
+#ifndef SHIFTREG_CHAIN
+#define SHIFTREG_CHAIN 1
+#endif
+
+#define SHIFTREG_RCLK PB4	// Latch, on the SS pin so master mode keeps it an output
+
+unsigned char shiftRegOutputs[SHIFTREG_CHAIN];			// Wanted, by register
+volatile unsigned char shiftRegFrame[SHIFTREG_CHAIN];	// Being shifted, last register first
+volatile unsigned char shiftRegNext;		// Index in shiftRegFrame the ISR sends next
+volatile unsigned char shiftRegBusy;		// A frame is being shifted
+volatile unsigned char shiftRegStale;		// Outputs changed since the frame was taken
+volatile unsigned short shiftRegLatches;	// Statistics: frames latched
+
+// Takes a frame of the outputs and sends its first byte; called with the
+// SPI idle and interrupts masked
+static void ShiftReg_Start(void)
+{
+	unsigned char i;
+
+	for (i = 0; i < SHIFTREG_CHAIN; i++) {
+		shiftRegFrame[i] = shiftRegOutputs[SHIFTREG_CHAIN - 1 - i];
+	}
+	shiftRegStale = 0;
+	shiftRegBusy = 1;
+	shiftRegNext = 1;
+	PORTB &= ~(1 << SHIFTREG_RCLK);
+	SPDR = shiftRegFrame[0];
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sets up the SPI as a fast master and clears the outputs
+//Parameter: None
+//Returns: None
+void ShiftReg_Init(void)
+{
+	unsigned char sreg = SREG, ddrb = DDRB, i;
+
+	SPI_MasterInit();
+	SREG = sreg;	// SPI_MasterInit enables interrupts; not before the scheduler
+	DDRB |= ddrb;	// SPI_MasterInit sets the SPI pins only
+	SPCR = (1 << SPIE) | (1 << SPE) | (1 << MSTR);	// Interrupt, F_CPU/4 ...
+	SPSR |= (1 << SPI2X);							// ... doubled to F_CPU/2
+	for (i = 0; i < SHIFTREG_CHAIN; i++) {
+		shiftRegOutputs[i] = 0;
+	}
+	shiftRegLatches = 0;
+	cli();
+	ShiftReg_Start();
+	SREG = sreg;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sets one register's outputs; they change once the frame
+//				  holding them has been shifted and latched
+//Parameter: reg is the register (0 next to the microcontroller), data the
+//			 outputs, QA in bit 0
+//Returns: None
+void ShiftReg_Write(unsigned char reg, unsigned char data)
+{
+	if (reg >= SHIFTREG_CHAIN || shiftRegOutputs[reg] == data) {
+		return;
+	}
+	taskENTER_CRITICAL();
+	shiftRegOutputs[reg] = data;
+	if (shiftRegBusy) {
+		shiftRegStale = 1; // The ISR starts another frame
+	} else {
+		ShiftReg_Start();
+	}
+	taskEXIT_CRITICAL();
+}
+
+ISR(SPI_STC_vect)
+{
+	if (shiftRegNext < SHIFTREG_CHAIN) {
+		SPDR = shiftRegFrame[shiftRegNext++];
+		return;
+	}
+	// Whole chain shifted: the rising edge copies it to the outputs
+	PORTB |= (1 << SHIFTREG_RCLK);
+	shiftRegLatches++;
+	shiftRegBusy = 0;
+	if (shiftRegStale) {
+		ShiftReg_Start();
+	}
+}
+
+#endif //SHIFTREG_SPI_H
@@ -0,0 +1,20 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Vend milestone probes for the host simulation's benchmark (Sim/sim.h).
+// SIM_PROBE(event) reports one SimProbe event when built with -DPOSIX_SIM
+// and compiles to nothing for the ATmega1284, so the firmware keeps them.
+
+#ifndef SIM_PROBE_H
+#define SIM_PROBE_H
+
+#ifdef POSIX_SIM
+#include "sim.h"
+#define SIM_PROBE(event) Sim_Probe(event)
+#else
+#define SIM_PROBE(event)
+#endif
+
+#endif //SIM_PROBE_H
@@ -33,7 +33,8 @@ void SPI_MasterTransmit(unsigned char cData) {
 }
 
 
-// Servant code
+// Servant code, left out where a master side driver owns SPI_STC_vect
+#ifndef SPI_MASTER_ONLY
 void SPI_ServantInit(void) {
 	// set DDRB to have MISO line as output and MOSI, SCK, and SS as input
 	DDRB = (1<<DDB6);
@@ -49,5 +50,6 @@ ISR(SPI_STC_vect) { // this is enabled in with the SPCR register’s “SPI
 	// SPDR;
     receivedData = SPDR;
 }
+#endif //SPI_MASTER_ONLY
 
 #endif
\ No newline at end of file
@@ -0,0 +1,302 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Interrupt driven stepper engine for FreeRTOS builds.
+// Two unipolar motors on PORTB through a ULN2003: motor 0 on PB4-PB7, motor
+// 1 on PB0-PB3. Each motor is a channel with its own queue of moves, so both
+// can run at once. The Timer3 compare A interrupt takes the steps, so the
+// step rate no longer depends on the tick: each channel keeps the Timer3
+// count its next step is due at, and OCR3A is set to the soonest of them,
+// on top of the free running 1 MHz timebase of timing.h. Every channel due
+// within STEPPER_MERGE_WINDOW of a match steps in it, with one write of both
+// nibbles to PORTB.
+// Moves have a trapezoidal speed profile: they start at the first interval
+// of stepperRamp (stepper_ramp.h), speed up through the table to its last
+// entry (the cruise speed) and slow down through it again to stop. Moves
+// too short to reach the cruise speed turn around part way.
+// Tasks queue moves with Stepper_Move(); each finished move is handed back,
+// with the caller's tag, through Stepper_WaitDone(), and Stepper_WaitIdle()
+// blocks until every channel has run out of moves. Stepper_Stop() cuts the
+// running move short, slowing down through the ramp to stop. A channel's coils are
+// switched off when it runs out.
+// Drive modes, as sequences of coil patterns:
+//   STEPPER_WAVE  one coil at a time (least current)
+//   STEPPER_FULL  two coils at a time (most torque)
+//   STEPPER_HALF  alternating one and two coils: twice the steps per turn,
+//                 at the same angular speed profile
+// The ULN2003 can only switch coils fully on or off, so there is no
+// micro-stepping, which needs the coil current controlled (PWM) as well.
+
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h" // And the FreeRTOS queue.h
+#include "timing.h"
+#include "stepper_ramp.h"
+
+#define STEPPER_MOTORS 2
+
+#define STEPPER_WAVE 0
+#define STEPPER_FULL 1
+#define STEPPER_HALF 2
+
+#define STEPPER_FORWARD 0
+#define STEPPER_REVERSE 1
+
+// Moves that can wait in each channel's queue behind the one running
+#ifndef STEPPER_QUEUE_LENGTH
+#define STEPPER_QUEUE_LENGTH 4
+#endif
+
+// Finished moves waiting for Stepper_WaitDone(); later ones are dropped
+#ifndef STEPPER_DONE_LENGTH
+#define STEPPER_DONE_LENGTH (STEPPER_MOTORS * (STEPPER_QUEUE_LENGTH + 1))
+#endif
+
+#define STEPPER_START_DELAY 20	// Timer3 counts from a move being queued to its first step
+#define STEPPER_MERGE_WINDOW (50 * TIMING_TICKS_PER_US)	// Steps this close share a match
+
+typedef struct _StepperMove
+{
+	unsigned char motor;		// 0 or 1
+	unsigned char mode;			// STEPPER_WAVE, STEPPER_FULL or STEPPER_HALF
+	unsigned char direction;	// STEPPER_FORWARD or STEPPER_REVERSE
+	unsigned short steps;		// In steps of the mode (half steps for STEPPER_HALF)
+	unsigned short tag;			// The caller's, handed back when the move is done
+} StepperMove;
+
+typedef struct _StepperChannel
+{
+	xQueueHandle queue;		// Moves waiting to run
+	StepperMove move;		// The move running; owned by the ISR
+	unsigned short left;	// Steps of it still to take
+	unsigned short level;	// Position on the ramp, in steps of the mode
+	unsigned short due;		// Timer3 count of the next step
+	unsigned char phase;	// Index into stepperPatterns
+} StepperChannel;
+
+// Half step sequence for one motor's nibble; full steps use the odd entries
+// (two coils) and wave steps the even ones (one coil)
+const unsigned char stepperPatterns[8] = {0x01,0x03,0x02,0x06,0x04,0x0C,0x08,0x09};
+const unsigned char stepperShift[STEPPER_MOTORS] = {4, 0};	// Nibble of each motor on PORTB
+
+StepperChannel stepperChannels[STEPPER_MOTORS];
+xQueueHandle stepperDone;				// Finished moves
+xSemaphoreHandle stepperIdle;			// Given when every channel runs out of moves
+volatile unsigned char stepperActive;	// Bit per channel running moves
+unsigned long stepperSteps;				// Steps taken since init, all motors
+unsigned long stepperMerged;			// Matches that stepped both motors
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Creates the move queues and stops both motors
+//				  Call before the scheduler starts, after Timing_Init()
+//Parameter: None
+//Returns: 1 if set up else 0 (no heap for a queue)
+unsigned char Stepper_Init(void)
+{
+	unsigned char i;
+
+	DDRB = 0xFF;
+	PORTB = 0x00;
+	for (i = 0; i < STEPPER_MOTORS; i++) {
+		stepperChannels[i].queue = xQueueCreate(STEPPER_QUEUE_LENGTH, sizeof(StepperMove));
+		if (!stepperChannels[i].queue) {
+			return 0;
+		}
+		stepperChannels[i].left = 0;
+		stepperChannels[i].phase = 1; // Odd: a full step pattern
+	}
+	stepperActive = 0;
+	stepperDone = xQueueCreate(STEPPER_DONE_LENGTH, sizeof(StepperMove));
+	vSemaphoreCreateBinary(stepperIdle);
+	if (!stepperDone || !stepperIdle) {
+		return 0;
+	}
+	xSemaphoreTake(stepperIdle, 0);
+	return 1;
+}
+
+// Starts the move just taken from the queue; called from the ISR
+static void Stepper_BeginMove(StepperChannel* c)
+{
+	c->left = c->move.steps;
+	c->level = 0;
+	// Full steps need a two coil pattern and wave steps a one coil pattern
+	if (c->move.mode == STEPPER_FULL) {
+		c->phase |= 1;
+	} else if (c->move.mode == STEPPER_WAVE) {
+		c->phase &= ~1;
+	}
+}
+
+// Takes one step of the channel's move into out, the PORTB value being
+// built, and returns the interval to the next step, from the ramp; called
+// from the ISR
+static unsigned short Stepper_Step(StepperChannel* c, unsigned char motor, unsigned char* out)
+{
+	unsigned char shift = (c->move.mode == STEPPER_HALF) ? 1 : 0;
+	unsigned char advance = shift ? 1 : 2;
+	unsigned short top = (STEPPER_RAMP_STEPS << shift) - 1;
+	unsigned short interval;
+
+	if (c->move.direction == STEPPER_REVERSE) {
+		c->phase = (c->phase - advance) & 0x07;
+	} else {
+		c->phase = (c->phase + advance) & 0x07;
+	}
+	*out = (*out & ~(0x0F << stepperShift[motor])) |
+		   (stepperPatterns[c->phase] << stepperShift[motor]);
+	c->left--;
+	stepperSteps++;
+
+	// Half steps move through the table at half the interval, so the motor
+	// turns with the same profile in either mode
+	interval = (pgm_read_word(&stepperRamp[c->level >> shift]) >> shift) * TIMING_TICKS_PER_US;
+	if (c->left <= c->level) {
+		if (c->level) {
+			c->level--;			// Slow down in time to stop
+		}
+	} else if (c->level < top && c->left > c->level + 1) {
+		c->level++;
+	}
+	return interval;
+}
+
+ISR(TIMER3_COMPA_vect)
+{
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	unsigned short now = OCR3A, soonest = 0xFFFF, wait;
+	unsigned char i, out = PORTB, stepped = 0;
+	StepperChannel* c;
+
+	for (i = 0; i < STEPPER_MOTORS; i++) {
+		c = &stepperChannels[i];
+		if (!(stepperActive & (1 << i))) {
+			continue;
+		}
+		if ((short)(c->due - now) <= (short)STEPPER_MERGE_WINDOW) {
+			if (!c->left) {
+				if (xQueueReceiveFromISR(c->queue, &c->move, &xHigherPriorityTaskWoken) != pdPASS) {
+					// Out of moves: switch this motor's coils off
+					stepperActive &= ~(1 << i);
+					out &= ~(0x0F << stepperShift[i]);
+					continue;
+				}
+				Stepper_BeginMove(c);
+			}
+			if (c->left) {
+				c->due += Stepper_Step(c, i, &out);
+				stepped++;
+				if (!c->left) {
+					xQueueSendFromISR(stepperDone, &c->move, &xHigherPriorityTaskWoken);
+				}
+			} else {
+				c->due = now + STEPPER_START_DELAY; // Empty move
+			}
+		}
+		wait = c->due - now;
+		if (wait < soonest) {
+			soonest = wait;
+		}
+	}
+	PORTB = out;
+	if (stepped > 1) {
+		stepperMerged++;
+	}
+
+	if (stepperActive) {
+		// Never behind the counter, or the next match is a wrap away
+		wait = TCNT3 - now + STEPPER_START_DELAY;
+		OCR3A = now + ((soonest > wait) ? soonest : wait);
+	} else {
+		TIMSK3 &= ~(1 << OCIE3A);
+		xSemaphoreGiveFromISR(stepperIdle, &xHigherPriorityTaskWoken);
+	}
+	if (xHigherPriorityTaskWoken != pdFALSE) {
+		taskYIELD();
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Queues a move on a motor's channel and starts the channel
+//				  if it is stopped
+//Parameter: motor (0 or 1), mode (STEPPER_WAVE/FULL/HALF), direction
+//			 (STEPPER_FORWARD/REVERSE), steps in steps of the mode, tag for
+//			 the caller (see Stepper_WaitDone), and ticksToWait for room in
+//			 the channel's queue
+//Returns: pdPASS if the move was queued, else errQUEUE_FULL
+portBASE_TYPE Stepper_Move(unsigned char motor, unsigned char mode, unsigned char direction,
+						   unsigned short steps, unsigned short tag, portTickType ticksToWait)
+{
+	StepperChannel* c = &stepperChannels[motor & 1];
+	StepperMove move;
+
+	move.motor = motor & 1;
+	move.mode = mode;
+	move.direction = direction;
+	move.steps = steps;
+	move.tag = tag;
+	if (xQueueSend(c->queue, &move, ticksToWait) != pdPASS) {
+		return errQUEUE_FULL;
+	}
+
+	portENTER_CRITICAL();
+	if (!(stepperActive & (1 << move.motor))) {
+		c->due = TCNT3 + STEPPER_START_DELAY;
+		if (!stepperActive) {
+			xSemaphoreTake(stepperIdle, 0); // Left given by the last stop
+			OCR3A = c->due;
+			TIFR3 = (1 << OCF3A);	// Clear an old match
+			TIMSK3 |= (1 << OCIE3A);
+		} else if ((short)(c->due - OCR3A) < 0) {
+			OCR3A = c->due;			// Sooner than the other channel's step
+		}
+		stepperActive |= (1 << move.motor);
+	}
+	portEXIT_CRITICAL();
+	return pdPASS;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Stops a motor's running move as soon as it can slow down
+//				  through the ramp; it is then done as usual. Moves queued
+//				  behind it still run
+//Parameter: motor (0 or 1)
+//Returns: None
+void Stepper_Stop(unsigned char motor)
+{
+	StepperChannel* c = &stepperChannels[motor & 1];
+
+	portENTER_CRITICAL();
+	if (c->left > c->level + 1) {
+		c->left = c->level + 1;
+	}
+	portEXIT_CRITICAL();
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Blocks until a move has been run
+//Parameter: move receives the finished move, tag included; ticksToWait,
+//			 portMAX_DELAY to wait as long as it takes
+//Returns: pdTRUE if a move was received else pdFALSE (timed out)
+portBASE_TYPE Stepper_WaitDone(StepperMove* move, portTickType ticksToWait)
+{
+	return xQueueReceive(stepperDone, move, ticksToWait);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Blocks until every queued move has been run
+//Parameter: ticksToWait, portMAX_DELAY to wait as long as it takes
+//Returns: 1 if the engine is idle else 0 (timed out)
+unsigned char Stepper_WaitIdle(portTickType ticksToWait)
+{
+	if (!stepperActive) {
+		return 1;
+	}
+	return xSemaphoreTake(stepperIdle, ticksToWait) == pdTRUE;
+}
+
+#endif //STEPPER_H
@@ -0,0 +1,36 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Acceleration table of the stepper engine (stepper.h), generated by
+// Tools/stepper_ramp.py --start 400 --speed 1250 --accel 4000
+// Entry n: microseconds between full steps n and n + 1 of a move; the
+// last entry is the cruise interval.
+
+#ifndef STEPPER_RAMP_H
+#define STEPPER_RAMP_H
+
+#include <avr/pgmspace.h>
+
+#define STEPPER_RAMP_STEPS 176
+
+const unsigned short stepperRamp[STEPPER_RAMP_STEPS] PROGMEM = {
+	2470, 2411, 2357, 2306, 2259, 2214, 2172, 2132, 2094, 2059, 2025, 1992,
+	1961, 1932, 1904, 1877, 1851, 1826, 1802, 1779, 1757, 1736, 1715, 1695,
+	1676, 1658, 1640, 1622, 1605, 1589, 1573, 1558, 1543, 1529, 1514, 1501,
+	1487, 1474, 1462, 1449, 1437, 1426, 1414, 1403, 1392, 1381, 1371, 1361,
+	1351, 1341, 1332, 1322, 1313, 1304, 1295, 1287, 1278, 1270, 1262, 1254,
+	1246, 1238, 1231, 1224, 1216, 1209, 1202, 1195, 1188, 1182, 1175, 1169,
+	1162, 1156, 1150, 1144, 1138, 1132, 1127, 1121, 1115, 1110, 1104, 1099,
+	1094, 1089, 1083, 1078, 1073, 1068, 1064, 1059, 1054, 1049, 1045, 1040,
+	1036, 1031, 1027, 1023, 1019, 1014, 1010, 1006, 1002,  998,  994,  990,
+	 986,  982,  979,  975,  971,  968,  964,  960,  957,  953,  950,  947,
+	 943,  940,  937,  933,  930,  927,  924,  921,  917,  914,  911,  908,
+	 905,  902,  899,  897,  894,  891,  888,  885,  883,  880,  877,  874,
+	 872,  869,  866,  864,  861,  859,  856,  854,  851,  849,  846,  844,
+	 842,  839,  837,  834,  832,  830,  828,  825,  823,  821,  819,  816,
+	 814,  812,  810,  808,  806,  804,  802,  800,
+};
+
+#endif //STEPPER_RAMP_H
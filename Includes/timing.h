@@ -0,0 +1,105 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Timing primitives shared by the drivers.
+// Timer3 runs free at 1 MHz (F_CPU / 8) as a microsecond timebase once
+// Timing_Init() has been called; delay_us() polls it, so the result does not
+// depend on compiler output or interrupts stealing cycles. Before that, or on
+// boards where Timer3 is not started, delay_us() falls back to a cycle
+// counted loop derived from F_CPU.
+// delay_ms() hands the CPU to other tasks through vTaskDelay() while the
+// scheduler is running and spins (e.g. during LCD_init() in main) otherwise.
+// Timer3 is never stopped or reloaded here, so other code may add output
+// compare interrupts on it as long as it leaves the clock select alone.
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <avr/io.h>
+#include <util/delay_basic.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#define TIMING_TICKS_PER_US (F_CPU / 8000000UL)	// Timer3 counts per microsecond
+
+#if (F_CPU % 8000000UL) != 0
+#error timing.h needs F_CPU to be a multiple of 8 MHz for a 1 MHz Timer3
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts Timer3 free-running as the microsecond timebase
+//Parameter: None
+//Returns: None
+void Timing_Init(void)
+{
+	TCCR3A = 0x00;			// Normal mode, output compare pins disconnected
+	TCNT3 = 0;
+	TCCR3B = (1 << CS31);	// Clock / 8, count up to 0xFFFF and wrap
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads the microsecond timebase
+//				  TCNT3 is read with interrupts off since 16-bit timer
+//				  accesses share the TEMP register with any ISR using Timer3
+//Parameter: None
+//Returns: Timer3 count; wraps every 65536 counts
+unsigned short Timing_Now(void)
+{
+	unsigned char sreg = SREG;
+	unsigned short now;
+
+	cli();
+	now = TCNT3;
+	SREG = sreg;
+	return now;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Busy-waits for a number of microseconds without yielding
+//				  For short hardware setup/hold times only
+//Parameter: us is the delay in microseconds, at most 65535 / TIMING_TICKS_PER_US
+//Returns: None
+void delay_us(unsigned short us)
+{
+	unsigned short start, ticks;
+
+	if (TCCR3B & ((1 << CS32) | (1 << CS31) | (1 << CS30))) {
+		ticks = us * TIMING_TICKS_PER_US;
+		start = Timing_Now();
+		while ((unsigned short)(Timing_Now() - start) < ticks);
+		return;
+	}
+	// Timer3 not running: _delay_loop_2 takes 4 cycles per count
+	while (us > 1000) {
+		_delay_loop_2(F_CPU / 4000UL);
+		us -= 1000;
+	}
+	if (us) {
+		_delay_loop_2(us * (F_CPU / 4000000UL));
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Waits at least a number of milliseconds, giving the CPU to
+//				  other tasks when the scheduler is running
+//Parameter: miliSec is the delay in milliseconds
+//Returns: None
+void delay_ms(int miliSec)
+{
+	if (miliSec <= 0) {
+		return;
+	}
+	if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		// vTaskDelay(n) may return up to one tick early
+		vTaskDelay((miliSec + portTICK_RATE_MS - 1) / portTICK_RATE_MS + 1);
+		return;
+	}
+	while (miliSec--) {
+		delay_us(1000);
+	}
+}
+
+#endif //TIMING_H
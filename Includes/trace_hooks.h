@@ -0,0 +1,61 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Kernel trace hooks for the binary trace recorder (trace_recorder.h).
+// Included at the end of FreeRTOSConfig.h when configUSE_TRACE_RECORDER is 1,
+// so only declarations and macros may live here: the recorder itself is
+// compiled into the application, and the kernel files see the macros below
+// in place of the empty defaults in FreeRTOS.h.
+// Every hook costs one call and, while tracing is stopped, one test.
+
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+
+// Event codes, shared with Tools/trace2json.py
+#define TRACE_TIME					0x01	// time = upper 16 bits of the timestamp
+#define TRACE_LOST					0x02	// time = events dropped (buffer full)
+#define TRACE_TASK_NAME				0x03	// object = task | part << 4, time = 2 chars
+#define TRACE_QUEUE_CREATE			0x04	// time = queueQUEUE_TYPE_*
+#define TRACE_START					0x05	// Recording (re)started
+#define TRACE_SWITCHED_IN			0x10	// object = task number
+#define TRACE_TASK_READY			0x11
+#define TRACE_TASK_DELAY			0x12	// Running task blocks in vTaskDelay
+#define TRACE_TASK_DELAY_UNTIL		0x13
+#define TRACE_QUEUE_SEND			0x20	// object = queue number
+#define TRACE_QUEUE_SEND_FAILED		0x21
+#define TRACE_QUEUE_RECEIVE			0x22
+#define TRACE_QUEUE_RECEIVE_FAILED	0x23
+#define TRACE_QUEUE_PEEK			0x24
+#define TRACE_QUEUE_SEND_FROM_ISR	0x25
+#define TRACE_QUEUE_RECEIVE_FROM_ISR 0x26
+#define TRACE_BLOCKING_ON_SEND		0x27
+#define TRACE_BLOCKING_ON_RECEIVE	0x28
+
+extern void Trace_Record( unsigned char ucEvent, unsigned char ucObject );
+extern void Trace_SwitchedIn( unsigned char ucTask );
+extern void Trace_TaskCreate( unsigned char ucTask, const signed char *pcName );
+extern unsigned char Trace_QueueCreate( unsigned char ucType );
+
+// Task hooks, expanded in tasks.c (pxCurrentTCB and the TCB are visible there)
+#define traceTASK_SWITCHED_IN()					Trace_SwitchedIn( ( unsigned char ) pxCurrentTCB->uxTCBNumber )
+#define traceMOVED_TASK_TO_READY_STATE( pxTCB )	Trace_Record( TRACE_TASK_READY, ( unsigned char ) ( pxTCB )->uxTCBNumber )
+#define traceTASK_CREATE( pxNewTCB )			Trace_TaskCreate( ( unsigned char ) ( pxNewTCB )->uxTCBNumber, ( pxNewTCB )->pcTaskName )
+#define traceTASK_DELAY()						Trace_Record( TRACE_TASK_DELAY, ( unsigned char ) pxCurrentTCB->uxTCBNumber )
+#define traceTASK_DELAY_UNTIL()					Trace_Record( TRACE_TASK_DELAY_UNTIL, ( unsigned char ) pxCurrentTCB->uxTCBNumber )
+
+// Queue hooks, expanded in queue.c; semaphores and mutexes are queues too
+#define traceQUEUE_CREATE( pxNewQueue )			( pxNewQueue )->ucQueueNumber = Trace_QueueCreate( ( pxNewQueue )->ucQueueType )
+#define traceCREATE_MUTEX( pxNewQueue )			( pxNewQueue )->ucQueueNumber = Trace_QueueCreate( ( pxNewQueue )->ucQueueType )
+#define traceQUEUE_SEND( pxQueue )				Trace_Record( TRACE_QUEUE_SEND, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_SEND_FAILED( pxQueue )		Trace_Record( TRACE_QUEUE_SEND_FAILED, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE( pxQueue )			Trace_Record( TRACE_QUEUE_RECEIVE, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE_FAILED( pxQueue )	Trace_Record( TRACE_QUEUE_RECEIVE_FAILED, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_PEEK( pxQueue )				Trace_Record( TRACE_QUEUE_PEEK, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )		Trace_Record( TRACE_QUEUE_SEND_FROM_ISR, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )	Trace_Record( TRACE_QUEUE_RECEIVE_FROM_ISR, ( pxQueue )->ucQueueNumber )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue )	Trace_Record( TRACE_BLOCKING_ON_SEND, ( pxQueue )->ucQueueNumber )
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue ) Trace_Record( TRACE_BLOCKING_ON_RECEIVE, ( pxQueue )->ucQueueNumber )
+
+#endif //TRACE_HOOKS_H
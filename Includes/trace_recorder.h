@@ -0,0 +1,326 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Binary trace recorder for FreeRTOS builds (configUSE_TRACE_RECORDER).
+// The kernel hooks in trace_hooks.h put fixed-size events into a RAM ring:
+//   EVENT OBJECT TIME[2]
+// TIME is the low half of the run-time counter (Timer3, 1 MHz); a TRACE_TIME
+// event carrying the upper half is inserted whenever that changes, so the
+// host can rebuild 32-bit timestamps. Recording takes a few microseconds
+// with interrupts off. When the ring is full events are dropped and counted,
+// and the count is reported in a TRACE_LOST event once there is room again.
+//
+// Trace_StreamTask, at idle priority, owns a spare buffered USART: it sends
+// the ring in the background as frames for Tools/trace2json.py
+//   'T' 'R' COUNT COUNT*EVENT[4] CRC8
+// (CRC8 as Link_Crc8, over COUNT and the events) and answers the requests
+//   TRACE_START_REQUEST  start (or restart) recording; the task names and
+//                        queue types are sent again first
+//   TRACE_STOP_REQUEST   stop recording
+//   RUNTIME_REQUEST      run-time statistics dump (runtime_stats.h)
+//   PERIODIC_REQUEST     periodic task statistics dump (periodic.h, if
+//                        included first)
+// 4 bytes per event at ~1800 events/s while a motor steps is over 70000
+// baud, and the stream task's own wakeups are traced too, so give the USART
+// used plenty of headroom (250000 baud is exact at 8 MHz, UBRR 1 in normal
+// mode) and a large TX buffer (USARTn_TX_BUFFER_SIZE 128): frames are sized
+// to fit it, so one is written without waiting.
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "usart_isr_ATmega1284.h"
+#include "runtime_stats.h" // RunTime_Now, RunTime_WriteByte, RunTime_Dump
+
+#define TRACE_START_REQUEST	'T'
+#define TRACE_STOP_REQUEST	'X'
+
+// Ring size in events (4 bytes each), a power of 2 no larger than 256
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 128
+#endif
+#define TRACE_MASK (TRACE_BUFFER_EVENTS - 1)
+
+// Tasks whose names are kept (task numbers 0..TRACE_MAX_TASKS-1, at most 16)
+#ifndef TRACE_MAX_TASKS
+#define TRACE_MAX_TASKS 8
+#endif
+// Queues whose types are kept (queue numbers 1..TRACE_MAX_QUEUES)
+#ifndef TRACE_MAX_QUEUES
+#define TRACE_MAX_QUEUES 12
+#endif
+
+// Events per frame: as many as fit in the trace USART's TX buffer
+#define TRACE_BLOCK_EVENTS	((USART_TxSize(traceUsart) - 5) / 4)
+#define TRACE_FRAME_SIZE(n)	(4 + (n) * 4)
+#define TRACE_FLUSH_TICKS	20	// Longest a part-filled frame is held back
+#define TRACE_POLL_TICKS	10	// Ring check interval while recording
+
+typedef struct _TraceEvent
+{
+	unsigned char event;
+	unsigned char object;
+	unsigned short time;
+} TraceEvent;
+
+TraceEvent traceBuffer[TRACE_BUFFER_EVENTS];
+volatile unsigned char traceHead;		// Next free slot
+volatile unsigned char traceTail;		// Next event to send
+volatile unsigned char traceEnabled;
+unsigned short traceLost;				// Dropped since the last TRACE_LOST
+unsigned short traceHigh;				// Upper timestamp half last sent
+unsigned char traceSynced;				// traceHigh has been sent since start
+unsigned char traceLastTask = 0xFF;		// Last task switched in
+unsigned char traceUsart;
+signed char traceTaskNames[TRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+unsigned char traceQueueTypes[TRACE_MAX_QUEUES + 1];
+unsigned char traceQueueCount;
+
+// Adds an event if there is room; interrupts must be off
+static unsigned char Trace_Put(unsigned char event, unsigned char object, unsigned short time)
+{
+	unsigned char next = (traceHead + 1) & TRACE_MASK;
+
+	if (next == traceTail) {
+		return 0;
+	}
+	traceBuffer[traceHead].event = event;
+	traceBuffer[traceHead].object = object;
+	traceBuffer[traceHead].time = time;
+	traceHead = next;
+	return 1;
+}
+
+// Free slots in the ring; interrupts must be off
+static unsigned char Trace_Free(void)
+{
+	return (traceTail - traceHead - 1) & TRACE_MASK;
+}
+
+// Adds an event, timestamped unless it carries a value in its time field
+static void Trace_Log(unsigned char event, unsigned char object, unsigned char hasValue, unsigned short value)
+{
+	unsigned char sreg = SREG;
+	unsigned long now;
+	unsigned char needed;
+
+	cli();
+	if (traceEnabled) {
+		now = RunTime_Now();
+		if (traceSynced && (unsigned short)(now >> 16) != traceHigh) {
+			traceSynced = 0;
+		}
+		needed = 1 + !traceSynced + (traceLost != 0);
+		if (Trace_Free() < needed) {
+			if (traceLost != 0xFFFF) {
+				traceLost++;
+			}
+		} else {
+			if (traceLost) {
+				Trace_Put(TRACE_LOST, 0, traceLost);
+				traceLost = 0;
+			}
+			if (!traceSynced) {
+				traceHigh = now >> 16;
+				Trace_Put(TRACE_TIME, 0, traceHigh);
+				traceSynced = 1;
+			}
+			Trace_Put(event, object, hasValue ? value : (unsigned short)now);
+		}
+	}
+	SREG = sreg;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records one timestamped event; called by the kernel hooks,
+//				  from tasks and interrupts alike
+//Parameter: event is a TRACE_* code, object the task or queue number
+//Returns: None
+void Trace_Record(unsigned char event, unsigned char object)
+{
+	Trace_Log(event, object, 0, 0);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records a context switch if the task changed
+//				  (traceTASK_SWITCHED_IN, interrupts are off)
+//Parameter: task is the number of the task switched in
+//Returns: None
+void Trace_SwitchedIn(unsigned char task)
+{
+	if (task != traceLastTask) {
+		traceLastTask = task;
+		Trace_Record(TRACE_SWITCHED_IN, task);
+	}
+}
+
+// Records a task's name as TRACE_TASK_NAME events, 2 characters each
+static void Trace_RecordName(unsigned char task)
+{
+	unsigned char part;
+	const signed char* name = traceTaskNames[task];
+
+	for (part = 0; part < configMAX_TASK_NAME_LEN / 2; part++) {
+		Trace_Log(TRACE_TASK_NAME, task | (part << 4), 1,
+			(unsigned char)name[part * 2] | ((unsigned short)(unsigned char)name[part * 2 + 1] << 8));
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Keeps a new task's name for the trace (traceTASK_CREATE)
+//Parameter: task is the task number, name its configMAX_TASK_NAME_LEN name
+//Returns: None
+void Trace_TaskCreate(unsigned char task, const signed char* name)
+{
+	unsigned char i;
+
+	if (task >= TRACE_MAX_TASKS) {
+		return;
+	}
+	for (i = 0; i < configMAX_TASK_NAME_LEN; i++) {
+		traceTaskNames[task][i] = name[i];
+	}
+	if (traceEnabled) {
+		Trace_RecordName(task);
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Numbers a new queue, semaphore or mutex (traceQUEUE_CREATE)
+//Parameter: type is its queueQUEUE_TYPE_*
+//Returns: The queue number used in its events, 1 onwards
+unsigned char Trace_QueueCreate(unsigned char type)
+{
+	unsigned char number = ++traceQueueCount;
+
+	if (number <= TRACE_MAX_QUEUES) {
+		traceQueueTypes[number] = type;
+	}
+	Trace_Log(TRACE_QUEUE_CREATE, number, 1, type);
+	return number;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Empties the ring and starts recording, beginning with the
+//				  names of the tasks and the types of the queues created so far
+//Parameter: None
+//Returns: None
+void Trace_Start(void)
+{
+	unsigned char i;
+
+	taskENTER_CRITICAL();
+	traceHead = traceTail = 0;
+	traceLost = 0;
+	traceSynced = 0;
+	traceLastTask = 0xFF;
+	traceEnabled = 1;
+	Trace_Record(TRACE_START, 0);
+	for (i = 0; i < TRACE_MAX_TASKS; i++) {
+		if (traceTaskNames[i][0]) {
+			Trace_RecordName(i);
+		}
+	}
+	for (i = 1; i <= traceQueueCount && i <= TRACE_MAX_QUEUES; i++) {
+		Trace_Log(TRACE_QUEUE_CREATE, i, 1, traceQueueTypes[i]);
+	}
+	taskEXIT_CRITICAL();
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Stops recording; events already in the ring are still sent
+//Parameter: None
+//Returns: None
+void Trace_Stop(void)
+{
+	traceEnabled = 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends up to TRACE_BLOCK_EVENTS events as one frame, if the
+//				  TX buffer can take all of it without waiting
+//Parameter: None
+//Returns: Number of events sent
+unsigned char Trace_Flush(void)
+{
+	unsigned char count, i;
+	TraceEvent* e;
+
+	count = (traceHead - traceTail) & TRACE_MASK;
+	if (count > TRACE_BLOCK_EVENTS) {
+		count = TRACE_BLOCK_EVENTS;
+	}
+	if (!count || USART_TxFree(traceUsart) < TRACE_FRAME_SIZE(count)) {
+		return 0;
+	}
+	RunTime_WriteByte(traceUsart, 'T');
+	RunTime_WriteByte(traceUsart, 'R');
+	runTimeCrc = 0;
+	RunTime_WriteByte(traceUsart, count);
+	for (i = 0; i < count; i++) {
+		e = &traceBuffer[traceTail];
+		RunTime_WriteByte(traceUsart, e->event);
+		RunTime_WriteByte(traceUsart, e->object);
+		RunTime_WriteLong(traceUsart, e->time, 2);
+		traceTail = (traceTail + 1) & TRACE_MASK; // Slot free for new events
+	}
+	RunTime_WriteByte(traceUsart, runTimeCrc);
+	return count;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Selects the USART Trace_StreamTask uses
+//Parameter: usartNum is a USART set up with USART_BufferedInit and used for
+//			 nothing else
+//Returns: None
+void Trace_Init(unsigned char usartNum)
+{
+	traceUsart = usartNum;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Task body: handles requests and streams the ring, a full
+//				  frame at a time or whatever is there every TRACE_FLUSH_TICKS
+//				  Create at idle priority so tracing never delays real work
+//				  It sleeps while the line drains rather than per byte, as
+//				  its own wakeups are traced too
+//Parameter: None
+//Returns: None
+void Trace_StreamTask()
+{
+	unsigned char data, pending, txFree;
+	unsigned short bytesPerTick = ((traceUsart == 1) ? USART1_BAUD : USART0_BAUD) / 10 / configTICK_RATE_HZ;
+	portTickType lastFlush = xTaskGetTickCount();
+
+	for(;;)
+	{
+		while (USART_Read(traceUsart, &data)) {
+			if (data == TRACE_START_REQUEST) {
+				Trace_Start();
+			} else if (data == TRACE_STOP_REQUEST) {
+				Trace_Stop();
+			} else if (data == RUNTIME_REQUEST) {
+				RunTime_Dump(traceUsart);
+			}
+#ifdef PERIODIC_H
+			else if (data == PERIODIC_REQUEST) {
+				Periodic_Dump(traceUsart);
+			}
+#endif
+		}
+
+		pending = (traceHead - traceTail) & TRACE_MASK;
+		if (pending >= TRACE_BLOCK_EVENTS ||
+			(pending && (portTickType)(xTaskGetTickCount() - lastFlush) >= TRACE_FLUSH_TICKS)) {
+			if (Trace_Flush()) {
+				lastFlush = xTaskGetTickCount();
+				continue;
+			}
+			// Sleep until the TX buffer has drained enough for a full frame
+			txFree = USART_TxFree(traceUsart);
+			vTaskDelay((TRACE_FRAME_SIZE(TRACE_BLOCK_EVENTS) - txFree) / (bytesPerTick ? bytesPerTick : 1) + 1);
+		} else if (traceEnabled || pending) {
+			USART_WaitForData(traceUsart, TRACE_POLL_TICKS);
+		} else {
+			USART_WaitForData(traceUsart, portMAX_DELAY); // Idle until a request
+		}
+	}
+}
+
+#endif //TRACE_RECORDER_H
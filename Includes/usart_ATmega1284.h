@@ -10,7 +10,101 @@
 // USART Setup Values
 #define F_CPU 8000000UL // Assume uC operates at 8MHz
 #define BAUD_RATE 9600
-#define BAUD_PRESCALE (((F_CPU / (BAUD_RATE * 16UL))) - 1)
+
+// Per-USART speed, override before including this file if needed
+// USART0 talks to the Bluetooth module, USART1 to the other microcontroller
+#ifndef USART0_BAUD
+#define USART0_BAUD BAUD_RATE
+#endif
+#ifndef USART1_BAUD
+#define USART1_BAUD 38400
+#endif
+
+// Largest acceptable baud rate error, in tenths of a percent
+#define USART_MAX_ERROR 20
+
+// Baud rate divisor selection. Normal mode divides the clock by 16, double
+// speed (U2X) by 8. UBRR is rounded to nearest and the mode with the lower
+// error wins; normal mode wins ties since it samples each bit more often.
+// All of these are constant expressions usable in #if.
+#define USART_UBRR(baud, div) \
+	((F_CPU + (div) * 1UL * (baud) / 2) / ((div) * 1UL * (baud)) - 1)
+#define USART_ACTUAL(baud, div) (F_CPU / ((div) * (USART_UBRR(baud, div) + 1)))
+#define USART_ERROR(baud, div) \
+	((USART_ACTUAL(baud, div) > (baud) ? USART_ACTUAL(baud, div) - (baud) \
+	: (baud) - USART_ACTUAL(baud, div)) * 1000 / (baud))
+#define USART_USE_U2X(baud) (USART_ERROR(baud, 8) < USART_ERROR(baud, 16))
+#define USART_BAUD_UBRR(baud) \
+	(USART_USE_U2X(baud) ? USART_UBRR(baud, 8) : USART_UBRR(baud, 16))
+#define USART_BAUD_ERROR(baud) \
+	(USART_USE_U2X(baud) ? USART_ERROR(baud, 8) : USART_ERROR(baud, 16))
+
+#if USART_BAUD_ERROR(USART0_BAUD) > USART_MAX_ERROR
+#error USART0_BAUD cannot be generated within 2% from F_CPU
+#endif
+#if USART_BAUD_ERROR(USART1_BAUD) > USART_MAX_ERROR
+#error USART1_BAUD cannot be generated within 2% from F_CPU
+#endif
+#if USART_BAUD_UBRR(USART0_BAUD) > 4095 || USART_BAUD_UBRR(USART1_BAUD) > 4095
+#error USART baud rate too low for the 12-bit UBRR register
+#endif
+
+// Kept for code that still expects a single prescale value
+#define BAUD_PRESCALE USART_BAUD_UBRR(USART0_BAUD)
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Loads a baud rate divisor into a USART
+//Parameter: usartNum specifies which USART is set
+//			 If usartNum != 1, default to USART0
+//			 ubrr is the 12-bit divisor, u2x selects double speed mode
+//Returns: None
+void USART_SetDivisor(unsigned char usartNum, unsigned short ubrr, unsigned char u2x)
+{
+	if (usartNum != 1) {
+		UCSR0A = u2x ? (UCSR0A | (1 << U2X0)) : (UCSR0A & ~(1 << U2X0));
+		UBRR0H = (ubrr >> 8);
+		UBRR0L = ubrr;
+	}
+	else {
+		UCSR1A = u2x ? (UCSR1A | (1 << U2X1)) : (UCSR1A & ~(1 << U2X1));
+		UBRR1H = (ubrr >> 8);
+		UBRR1L = ubrr;
+	}
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Changes a USART's speed at runtime
+//				  Let pending output drain first; a byte in flight is corrupted
+//Parameter: usartNum specifies which USART is set
+//			 baud is the new rate in bits per second
+//Returns: 1 if set else 0 (not possible within USART_MAX_ERROR, unchanged)
+unsigned char USART_SetBaud(unsigned char usartNum, unsigned long baud)
+{
+	unsigned long ubrr, actual, error, bestUbrr = 0, bestError = 0xFFFFFFFF;
+	unsigned char div, u2x = 0;
+
+	if (baud == 0) {
+		return 0;
+	}
+	// Same selection as USART_BAUD_UBRR(), evaluated at runtime
+	for (div = 16; div >= 8; div >>= 1) {
+		ubrr = (F_CPU + div * baud / 2) / (div * baud);
+		if (ubrr == 0 || ubrr > 4096) {
+			continue;
+		}
+		actual = F_CPU / (div * ubrr);
+		error = (actual > baud ? actual - baud : baud - actual) * 1000 / baud;
+		if (error < bestError) {
+			bestError = error;
+			bestUbrr = ubrr - 1;
+			u2x = (div == 8);
+		}
+	}
+	if (bestError > USART_MAX_ERROR) {
+		return 0;
+	}
+	USART_SetDivisor(usartNum, bestUbrr, u2x);
+	return 1;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 //Functionality - Initializes TX and RX on PORT D
@@ -25,10 +119,8 @@ void initUSART(unsigned char usartNum)
 		// Use 8-bit character sizes 
 		UCSR0B |= (1 << RXEN0)  | (1 << TXEN0);
 		UCSR0C |= (1 << UCSZ00) | (1 << UCSZ01);
-		// Load lower 8-bits of the baud rate value into the low byte of the UBRR0 register
-		UBRR0L = BAUD_PRESCALE;
-		// Load upper 8-bits of the baud rate value into the high byte of the UBRR0 register
-		UBRR0H = (BAUD_PRESCALE >> 8);
+		// Divisor and U2X chosen at compile time for USART0_BAUD
+		USART_SetDivisor(0, USART_BAUD_UBRR(USART0_BAUD), USART_USE_U2X(USART0_BAUD));
 	}
 	else {
 		// Turn on the reception circuitry for USART1
@@ -36,10 +128,8 @@ void initUSART(unsigned char usartNum)
 		// Use 8-bit character sizes
 		UCSR1B |= (1 << RXEN1)  | (1 << TXEN1);
 		UCSR1C |= (1 << UCSZ10) | (1 << UCSZ11);
-		// Load lower 8-bits of the baud rate value into the low byte of the UBRR1 register
-		UBRR1L = BAUD_PRESCALE;
-		// Load upper 8-bits of the baud rate value into the high byte of the UBRR1 register
-		UBRR1H = (BAUD_PRESCALE >> 8);
+		// Divisor and U2X chosen at compile time for USART1_BAUD
+		USART_SetDivisor(1, USART_BAUD_UBRR(USART1_BAUD), USART_USE_U2X(USART1_BAUD));
 	}
 }
 ////////////////////////////////////////////////////////////////////////////////
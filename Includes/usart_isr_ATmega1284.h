@@ -0,0 +1,311 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Interrupt-driven USART0/USART1 driver for FreeRTOS builds.
+// Received bytes are stored by the RXC ISR in a per-USART ring buffer and
+// outgoing bytes are drained by the UDRE ISR, so callers never spin on the
+// status registers. A task may sleep on USART_WaitForData() until a byte
+// arrives instead of polling USART_HasReceived().
+// USART_Write() refuses a byte when the TX buffer is full and leaves it to
+// the caller to retry; USART_Put() gives up on it, and only such bytes are
+// counted as dropped.
+// Buffer sizes are set per USART and must be powers of 2 no larger than 128.
+
+#ifndef USART_ISR_1284_H
+#define USART_ISR_1284_H
+
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "usart_ATmega1284.h"
+
+// Ring buffer sizes, override before including this file if needed:
+// USARTn_RX_BUFFER_SIZE/USARTn_TX_BUFFER_SIZE for one USART, or
+// USART_RX_BUFFER_SIZE/USART_TX_BUFFER_SIZE for both
+#ifndef USART_RX_BUFFER_SIZE
+#define USART_RX_BUFFER_SIZE 32
+#endif
+#ifndef USART_TX_BUFFER_SIZE
+#define USART_TX_BUFFER_SIZE 32
+#endif
+#ifndef USART0_RX_BUFFER_SIZE
+#define USART0_RX_BUFFER_SIZE USART_RX_BUFFER_SIZE
+#endif
+#ifndef USART0_TX_BUFFER_SIZE
+#define USART0_TX_BUFFER_SIZE USART_TX_BUFFER_SIZE
+#endif
+#ifndef USART1_RX_BUFFER_SIZE
+#define USART1_RX_BUFFER_SIZE USART_RX_BUFFER_SIZE
+#endif
+#ifndef USART1_TX_BUFFER_SIZE
+#define USART1_TX_BUFFER_SIZE USART_TX_BUFFER_SIZE
+#endif
+
+#if (USART0_RX_BUFFER_SIZE & (USART0_RX_BUFFER_SIZE - 1)) || (USART0_TX_BUFFER_SIZE & (USART0_TX_BUFFER_SIZE - 1)) \
+	|| (USART1_RX_BUFFER_SIZE & (USART1_RX_BUFFER_SIZE - 1)) || (USART1_TX_BUFFER_SIZE & (USART1_TX_BUFFER_SIZE - 1))
+#error USART buffer sizes must be powers of 2
+#endif
+#if USART0_RX_BUFFER_SIZE > 128 || USART0_TX_BUFFER_SIZE > 128 || USART1_RX_BUFFER_SIZE > 128 || USART1_TX_BUFFER_SIZE > 128
+#error USART buffer sizes must be no larger than 128
+#endif
+
+volatile unsigned char usart0Rx[USART0_RX_BUFFER_SIZE];
+volatile unsigned char usart0Tx[USART0_TX_BUFFER_SIZE];
+volatile unsigned char usart1Rx[USART1_RX_BUFFER_SIZE];
+volatile unsigned char usart1Tx[USART1_TX_BUFFER_SIZE];
+
+//Ring buffers for one USART
+//The ISR only writes rxHead/txTail and the tasks only write rxTail/txHead,
+//so single byte index updates need no critical section
+typedef struct _USARTBuffer
+{
+	volatile unsigned char* rx;			// Received bytes
+	volatile unsigned char* tx;			// Bytes waiting to be sent
+	unsigned char rxMask;				// Buffer size - 1
+	unsigned char txMask;
+	volatile unsigned char rxHead;		// Next free RX slot (ISR)
+	volatile unsigned char rxTail;		// Next RX byte to read (task)
+	volatile unsigned char txHead;		// Next free TX slot (task)
+	volatile unsigned char txTail;		// Next TX byte to send (ISR)
+	volatile unsigned short rxDropped;	// Bytes lost to a full buffer or overrun
+	volatile unsigned short txDropped;	// Bytes USART_Put discarded, TX buffer full
+	xSemaphoreHandle rxReady;			// Given by the RX ISR to wake a waiting task
+} USARTBuffer;
+
+USARTBuffer usartBuffers[2] = {
+	{usart0Rx, usart0Tx, USART0_RX_BUFFER_SIZE - 1, USART0_TX_BUFFER_SIZE - 1, 0, 0, 0, 0, 0, 0, NULL},
+	{usart1Rx, usart1Tx, USART1_RX_BUFFER_SIZE - 1, USART1_TX_BUFFER_SIZE - 1, 0, 0, 0, 0, 0, 0, NULL}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Initializes a USART and its ring buffers, enables RX interrupt
+//Parameter: usartNum specifies which USART is being initialized
+//			 If usartNum != 1, default to USART0
+//Returns: 1 if set up else 0 (no heap for the RX semaphore)
+unsigned char USART_BufferedInit(unsigned char usartNum)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+
+	b->rxHead = b->rxTail = 0;
+	b->txHead = b->txTail = 0;
+	b->rxDropped = b->txDropped = 0;
+	vSemaphoreCreateBinary(b->rxReady);
+	if (!b->rxReady) {
+		return 0;
+	}
+	xSemaphoreTake(b->rxReady, 0); // Created full; nothing received yet
+
+	initUSART(usartNum);
+	if (usartNum != 1) {
+		UCSR0B |= (1 << RXCIE0);
+	}
+	else {
+		UCSR1B |= (1 << RXCIE1);
+	}
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Number of received bytes waiting in the RX buffer
+//Parameter: usartNum specifies which USART is checked
+//Returns: Count of unread bytes
+unsigned char USART_Available(unsigned char usartNum)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+	return (b->rxHead - b->rxTail) & b->rxMask;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Non-blocking read of one received byte
+//Parameter: usartNum specifies which USART is read
+//			 data receives the byte when one is available
+//Returns: 1 if a byte was read else 0
+unsigned char USART_Read(unsigned char usartNum, unsigned char* data)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+	unsigned char tail = b->rxTail;
+
+	if (tail == b->rxHead) {
+		return 0;
+	}
+	*data = b->rx[tail];
+	b->rxTail = (tail + 1) & b->rxMask;
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Non-blocking write of one byte into the TX buffer
+//Parameter: usartNum specifies which USART will send the byte
+//Returns: 1 if queued else 0 (TX buffer full; the caller may retry)
+unsigned char USART_Write(unsigned char usartNum, unsigned char data)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+	unsigned char head = b->txHead;
+	unsigned char next = (head + 1) & b->txMask;
+
+	if (next == b->txTail) {
+		return 0;
+	}
+	b->tx[head] = data;
+	b->txHead = next;
+
+	// (Re)arm the data register empty interrupt to start draining
+	if (usartNum != 1) {
+		UCSR0B |= (1 << UDRIE0);
+	}
+	else {
+		UCSR1B |= (1 << UDRIE1);
+	}
+	return 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Non-blocking write of one byte that is discarded, and
+//				  counted as dropped, if the TX buffer is full
+//Parameter: usartNum specifies which USART will send the byte
+//Returns: 1 if queued else 0 (dropped)
+unsigned char USART_Put(unsigned char usartNum, unsigned char data)
+{
+	if (USART_Write(usartNum, data)) {
+		return 1;
+	}
+	usartBuffers[usartNum == 1].txDropped++;
+	return 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Number of free slots in the TX buffer
+//Parameter: usartNum specifies which USART is checked
+//Returns: Count of bytes that can be written without being refused
+unsigned char USART_TxFree(unsigned char usartNum)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+	return b->txMask - ((b->txHead - b->txTail) & b->txMask);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Size of the TX buffer
+//Parameter: usartNum specifies which USART is checked
+//Returns: USARTn_TX_BUFFER_SIZE; one less can be waiting at once
+unsigned char USART_TxSize(unsigned char usartNum)
+{
+	return usartBuffers[usartNum == 1].txMask + 1;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Blocks the calling task until a byte is received or timeout
+//Parameter: usartNum specifies which USART to wait on
+//			 ticks is the maximum time to wait
+//Returns: 1 if data is available else 0
+unsigned char USART_WaitForData(unsigned char usartNum, portTickType ticks)
+{
+	USARTBuffer* b = &usartBuffers[usartNum == 1];
+
+	if (USART_Available(usartNum)) {
+		return 1;
+	}
+	xSemaphoreTake(b->rxReady, ticks);
+	return USART_Available(usartNum) != 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Number of received bytes lost since initialization
+//Parameter: usartNum specifies which USART is checked
+//Returns: Dropped byte count
+unsigned short USART_RxDropped(unsigned char usartNum)
+{
+	return usartBuffers[usartNum == 1].rxDropped;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Number of bytes USART_Put() discarded since initialization
+//Parameter: usartNum specifies which USART is checked
+//Returns: Dropped byte count
+unsigned short USART_TxDropped(unsigned char usartNum)
+{
+	return usartBuffers[usartNum == 1].txDropped;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Wakes a task sleeping in USART_WaitForData() without data,
+//				  e.g. because it has something else to do
+//Parameter: usartNum specifies which USART's waiter is woken
+//Returns: None
+void USART_WakeWaiter(unsigned char usartNum)
+{
+	xSemaphoreGive(usartBuffers[usartNum == 1].rxReady);
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Gets the semaphore USART_WaitForData() sleeps on, for
+//				  another interrupt to give so one task can sleep on both
+//Parameter: usartNum specifies which USART
+//Returns: The semaphore
+xSemaphoreHandle USART_RxSemaphore(unsigned char usartNum)
+{
+	return usartBuffers[usartNum == 1].rxReady;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Shared ISR bodies. Each vector reads its own registers and calls these.
+
+static inline void USART_RxHandler(USARTBuffer* b, unsigned char overrun, unsigned char data)
+{
+	signed portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	unsigned char head = b->rxHead;
+	unsigned char next = (head + 1) & b->rxMask;
+
+	if (overrun) {
+		b->rxDropped++; // Hardware lost at least one byte before this one
+	}
+	if (next == b->rxTail) {
+		b->rxDropped++;
+	} else {
+		b->rx[head] = data;
+		b->rxHead = next;
+	}
+
+	xSemaphoreGiveFromISR(b->rxReady, &xHigherPriorityTaskWoken);
+	if (xHigherPriorityTaskWoken != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+//Returns: 1 and the next byte to send, or 0 when the buffer has drained
+static inline unsigned char USART_TxHandler(USARTBuffer* b, unsigned char* data)
+{
+	unsigned char tail = b->txTail;
+
+	if (tail == b->txHead) {
+		return 0;
+	}
+	*data = b->tx[tail];
+	b->txTail = (tail + 1) & b->txMask;
+	return 1;
+}
+
+ISR(USART0_RX_vect)
+{
+	unsigned char overrun = UCSR0A & (1 << DOR0); // Must be read before UDR0
+	USART_RxHandler(&usartBuffers[0], overrun, UDR0);
+}
+
+ISR(USART1_RX_vect)
+{
+	unsigned char overrun = UCSR1A & (1 << DOR1);
+	USART_RxHandler(&usartBuffers[1], overrun, UDR1);
+}
+
+ISR(USART0_UDRE_vect)
+{
+	unsigned char data;
+	if (USART_TxHandler(&usartBuffers[0], &data)) {
+		UDR0 = data;
+	} else {
+		UCSR0B &= ~(1 << UDRIE0); // Nothing left, stop interrupting
+	}
+}
+
+ISR(USART1_UDRE_vect)
+{
+	unsigned char data;
+	if (USART_TxHandler(&usartBuffers[1], &data)) {
+		UDR1 = data;
+	} else {
+		UCSR1B &= ~(1 << UDRIE1);
+	}
+}
+
+#endif //USART_ISR_1284_H
@@ -0,0 +1,31 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// EEPROM access for the Linux host simulation. The 4 KB EEPROM is a RAM
+// image in sim_io.c, loaded from and written through to the file named by
+// SIM_EEPROM if it is set. Addresses are EEPROM offsets (0..E2END).
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+void eeprom_read_block(void* dst, const void* address, size_t n);
+void eeprom_write_byte(uint8_t* address, uint8_t value);
+void eeprom_write_word(uint16_t* address, uint16_t value);
+void eeprom_write_block(const void* src, void* address, size_t n);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+void eeprom_update_word(uint16_t* address, uint16_t value);
+void eeprom_update_block(const void* src, void* address, size_t n);
+
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait()
+
+#endif //SIM_AVR_EEPROM_H
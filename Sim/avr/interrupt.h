@@ -0,0 +1,21 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Interrupt vectors for the Linux host simulation. An ISR is an ordinary
+// function named after its vector; sim_io.c calls it when the simulated
+// peripheral raises it. The tick handler holds off while the SREG I bit is
+// clear, so cli()/sei() and SREG save/restore keep their AVR meaning.
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= (unsigned char)~0x80)
+
+#endif //SIM_AVR_INTERRUPT_H
@@ -0,0 +1,177 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// ATmega1284P register file for the Linux host simulation (POSIX_SIM builds).
+// Found ahead of avr-libc through -ISim. Registers are plain variables defined
+// in sim_io.c, except those whose value the hardware changes on its own:
+//   PINx  - read back PORTx with any pressed keypad key pulling a row low
+//   TCNT3 - counts 1 MHz of simulated time, like Timing_Init() sets it up
+//   UDRn  - holds SIM_UDR_EMPTY while no byte is waiting to be sent
+//   SPDR  - holds SIM_SPDR_EMPTY while no byte is waiting to be shifted
+// Bit numbers are the datasheet values.
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <avr/portpins.h>
+
+#define __AVR_ATmega1284P__ 1
+
+// 8-bit registers with no side effects
+#define SIM_REGISTERS(X) \
+	X(PORTA) X(PORTB) X(PORTC) X(PORTD) \
+	X(DDRA) X(DDRB) X(DDRC) X(DDRD) \
+	X(UCSR0A) X(UCSR0B) X(UCSR0C) X(UBRR0L) X(UBRR0H) \
+	X(UCSR1A) X(UCSR1B) X(UCSR1C) X(UBRR1L) X(UBRR1H) \
+	X(ADCSRA) X(ADCSRB) X(ADMUX) X(DIDR0) X(ACSR) \
+	X(SPCR) X(SPSR) X(SREG) \
+	X(TCCR0A) X(TCCR0B) X(TCNT0) X(OCR0A) X(OCR0B) X(TIMSK0) X(TIFR0) \
+	X(TCCR1A) X(TCCR1B) X(TCCR1C) X(TIMSK1) X(TIFR1) \
+	X(TCCR2A) X(TCCR2B) X(TCNT2) X(OCR2A) X(OCR2B) X(TIMSK2) X(TIFR2) X(ASSR) \
+	X(TCCR3A) X(TCCR3B) X(TCCR3C) X(TIMSK3) X(TIFR3) \
+	X(PCICR) X(PCIFR) X(PCMSK0) X(PCMSK1) X(PCMSK2) X(PCMSK3) \
+	X(EIMSK) X(EICRA) X(SMCR) X(MCUCR) X(MCUSR) X(PRR0) X(PRR1) \
+	X(EECR) X(EEDR)
+
+// 16-bit registers with no side effects
+#define SIM_REGISTERS16(X) \
+	X(ADC) X(TCNT1) X(OCR1A) X(OCR1B) X(ICR1) X(OCR3A) X(OCR3B) X(ICR3) X(EEAR)
+
+#define SIM_DECLARE_REGISTER(name) extern volatile unsigned char name;
+#define SIM_DECLARE_REGISTER16(name) extern volatile unsigned short name;
+SIM_REGISTERS(SIM_DECLARE_REGISTER)
+SIM_REGISTERS16(SIM_DECLARE_REGISTER16)
+
+#define ADCL (*(volatile unsigned char*)&ADC)
+#define ADCH (*((volatile unsigned char*)&ADC + 1))
+
+// Registers the simulated hardware changes
+#define SIM_UDR_EMPTY 0x100
+extern volatile unsigned short UDR0;
+extern volatile unsigned short UDR1;
+#define SIM_SPDR_EMPTY 0x100
+extern volatile unsigned short SPDR;
+volatile unsigned char* simReadPin(unsigned char port);
+volatile unsigned short* simTimer3(void);
+#define PINA (*simReadPin(0))
+#define PINB (*simReadPin(1))
+#define PINC (*simReadPin(2))
+#define PIND (*simReadPin(3))
+#define TCNT3 (*simTimer3())
+
+// USART
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ01 2
+#define UCSZ00 1
+#define RXC1 7
+#define TXC1 6
+#define UDRE1 5
+#define FE1 4
+#define DOR1 3
+#define UPE1 2
+#define U2X1 1
+#define RXCIE1 7
+#define TXCIE1 6
+#define UDRIE1 5
+#define RXEN1 4
+#define TXEN1 3
+#define UCSZ11 2
+#define UCSZ10 1
+
+// ADC
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX0 0
+
+// SPI
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+#define SPIF 7
+#define SPI2X 0
+
+// Timers
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM21 1
+#define TOIE2 0
+#define OCIE2A 1
+#define AS2 5
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define WGM32 3
+#define WGM33 4
+#define TOIE3 0
+#define OCIE3A 1
+#define OCIE3B 2
+#define TOV3 0
+#define OCF3A 1
+#define OCF3B 2
+
+// Pin change and sleep
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIE3 3
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define PCIF3 3
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+
+// EEPROM
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define E2END 4095
+
+#define RAMEND 0x40FF
+
+#endif //SIM_AVR_IO_H
@@ -0,0 +1,29 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Program memory access for the Linux host simulation: there is only one
+// address space, so flash data is ordinary const data.
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+
+#define pgm_read_byte(address) (*(const unsigned char*)(address))
+#define pgm_read_word(address) (*(const unsigned short*)(address))
+#define pgm_read_dword(address) (*(const unsigned long*)(address))
+#define pgm_read_ptr(address) (*(void* const*)(address))
+
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+
+#endif //SIM_AVR_PGMSPACE_H
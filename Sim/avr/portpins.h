@@ -0,0 +1,19 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Pin number names for the Linux host simulation, as in avr-libc.
+
+#ifndef SIM_AVR_PORTPINS_H
+#define SIM_AVR_PORTPINS_H
+
+#define SIM_PINS(P) \
+	enum { P##0, P##1, P##2, P##3, P##4, P##5, P##6, P##7 };
+
+SIM_PINS(PA) SIM_PINS(PB) SIM_PINS(PC) SIM_PINS(PD)
+SIM_PINS(PORTA) SIM_PINS(PORTB) SIM_PINS(PORTC) SIM_PINS(PORTD)
+SIM_PINS(PINA) SIM_PINS(PINB) SIM_PINS(PINC) SIM_PINS(PIND)
+SIM_PINS(DDA) SIM_PINS(DDB) SIM_PINS(DDC) SIM_PINS(DDD)
+
+#endif //SIM_AVR_PORTPINS_H
@@ -0,0 +1,23 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sleep control for the Linux host simulation. The FreeRTOS sim port idles
+// by waiting for the next tick signal, so these have nothing to do.
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 2
+#define SLEEP_MODE_PWR_DOWN 4
+#define SLEEP_MODE_PWR_SAVE 6
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+#define sleep_mode()
+
+#endif //SIM_AVR_SLEEP_H
@@ -0,0 +1,147 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Delayed task list benchmark for the host simulation, built and run for
+// several task counts by Sim/bench_delay.sh.
+// It includes tasks.c itself to drive the delayed tasks directly: n tasks
+// delay repeatedly, each for a pseudo-random 1 to BENCH_MAX_DELAY ticks, as
+// the periodic tasks do with vTaskDelay, and the tick is advanced by hand:
+//   delay  one task enters the delayed list (prvAddCurrentTaskToDelayedList)
+//   tick   vTaskIncrementTick(), including waking the tasks that are due
+//   total  both, per tick: what the delayed tasks cost the kernel
+// The tick count starts just before the 16-bit overflow and wraps several
+// times during the run; every task must wake on exactly the tick it asked
+// for, or the benchmark fails. Tasks are not created or swapped in, only
+// moved between the delayed and ready lists.
+// Build with -DBENCH_TASKS=n -DconfigUSE_TIMING_WHEEL=0|1
+// [-DconfigTIMING_WHEEL_SLOTS=n].
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tasks.c"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline unsigned long long Bench_Now(void)
+{
+	_mm_lfence();
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static inline unsigned long long Bench_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#ifndef BENCH_TASKS
+#define BENCH_TASKS 16
+#endif
+#define BENCH_TICKS 300000UL	// About 4.5 tick count overflows
+#define BENCH_MAX_DELAY 250		// Longer than the wheel, so slots are shared
+#define BENCH_OVERHEAD_RUNS 100000
+
+static tskTCB benchTasks[BENCH_TASKS];
+static portTickType benchWake[BENCH_TASKS];
+static unsigned long long benchOverhead[BENCH_OVERHEAD_RUNS];
+static unsigned long benchRandom = 12345;
+
+static portTickType Bench_Delay(void)
+{
+	benchRandom = benchRandom * 1103515245UL + 12345UL;
+	return (portTickType)(1 + (benchRandom >> 16) % BENCH_MAX_DELAY);
+}
+
+static int Bench_Compare(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+// Puts task i in the delayed list as vTaskDelay would, returning the time taken
+static unsigned long long Bench_DelayTask(unsigned i)
+{
+	unsigned long long start;
+
+	benchWake[i] = xTickCount + Bench_Delay();
+	pxCurrentTCB = &benchTasks[i];
+	start = Bench_Now();
+	prvAddCurrentTaskToDelayedList(benchWake[i]);
+	return Bench_Now() - start;
+}
+
+int main(void)
+{
+	unsigned long tick, delays = 0, wakes = 0;
+	unsigned long long start, overhead, delayTime = 0, tickTime = 0;
+	unsigned i;
+
+	prvInitialiseTaskLists();
+	for (i = 0; i < BENCH_TASKS; i++) {
+		vListInitialiseItem(&benchTasks[i].xGenericListItem);
+		vListInitialiseItem(&benchTasks[i].xEventListItem);
+		listSET_LIST_ITEM_OWNER(&benchTasks[i].xGenericListItem, &benchTasks[i]);
+		benchTasks[i].uxPriority = 1;
+		benchTasks[i].uxTCBNumber = i;
+	}
+
+	for (i = 0; i < BENCH_OVERHEAD_RUNS; i++) {
+		start = Bench_Now();
+		benchOverhead[i] = Bench_Now() - start;
+	}
+	qsort(benchOverhead, BENCH_OVERHEAD_RUNS, sizeof(unsigned long long), Bench_Compare);
+	overhead = benchOverhead[BENCH_OVERHEAD_RUNS / 2];
+
+	// Start near the overflow so the first wrap comes with every task delayed
+	xTickCount = (portTickType)(0U - 100U);
+	#if (configUSE_TIMING_WHEEL == 1)
+	xWheelTime = xTickCount;
+	#endif
+	for (i = 0; i < BENCH_TASKS; i++) {
+		Bench_DelayTask(i);
+	}
+
+	for (tick = 0; tick < BENCH_TICKS; tick++) {
+		start = Bench_Now();
+		vTaskIncrementTick();
+		tickTime += Bench_Now() - start - overhead;
+
+		// Woken tasks are in the ready list; delay them again
+		for (i = 0; i < BENCH_TASKS; i++) {
+			if (listIS_CONTAINED_WITHIN(&pxReadyTasksLists[1], &benchTasks[i].xGenericListItem)) {
+				if (benchWake[i] != xTickCount) {
+					fprintf(stderr, "bench_delay: task %u woke at %u, not %u\n",
+						i, (unsigned)xTickCount, (unsigned)benchWake[i]);
+					return 1;
+				}
+				vListRemove(&benchTasks[i].xGenericListItem);
+				delayTime += Bench_DelayTask(i) - overhead;
+				delays++;
+				wakes++;
+			} else if (benchWake[i] == xTickCount) {
+				fprintf(stderr, "bench_delay: task %u missed its wake time %u\n",
+					i, (unsigned)benchWake[i]);
+				return 1;
+			}
+		}
+	}
+
+	printf("%2u tasks  %-6s %3u slots  delay %5.1f  tick %5.1f  total %5.1f  %s  (%lu wakes, %u overflows)\n",
+		(unsigned)BENCH_TASKS,
+		configUSE_TIMING_WHEEL ? "wheel" : "sorted",
+		configUSE_TIMING_WHEEL ? (unsigned)configTIMING_WHEEL_SLOTS : 0U,
+		(double)delayTime / delays, (double)tickTime / BENCH_TICKS,
+		(double)(delayTime + tickTime) / BENCH_TICKS,
+		BENCH_UNIT, wakes, (unsigned)xNumOfOverflows);
+	return 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Delayed task list benchmark: builds Sim/bench_delay.c for each task count
+# with the sorted delayed lists and with the timing wheel
+# (configUSE_TIMING_WHEEL), and prints the mean cost of a delay and of a tick
+# for each. See bench_delay.c for what is measured. WHEEL_SLOTS overrides
+# configTIMING_WHEEL_SLOTS.
+# Usage: [WHEEL_SLOTS=n] Sim/bench_delay.sh [TASK COUNTS]   (default 4 16 64)
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_delay.c queue.c list.c croutine.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+for tasks in ${*:-4 16 64}; do
+	for wheel in 0 1; do
+		gcc $CFLAGS -DBENCH_TASKS=$tasks -DconfigUSE_TIMING_WHEEL=$wheel \
+			${WHEEL_SLOTS:+-DconfigTIMING_WHEEL_SLOTS=$WHEEL_SLOTS} \
+			-o Sim/build/bench_delay $SOURCES -lm
+		Sim/build/bench_delay
+	done
+done
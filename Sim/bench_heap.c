@@ -0,0 +1,237 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Heap benchmark for the host simulation, built and run with heap_1.c and
+// with heap_pool.c by Sim/bench_heap.sh.
+// It replays the allocations uC1.c and uC2.c make before and at
+// vTaskStartScheduler(), with their ATmega1284 sizes (see heap_pool.c), and
+// prints:
+//   boot    over BENCH_RUNS replays: the slowest of the median cost of each
+//           allocation, the 99.9th percentile and the worst of every call
+//           (the worst includes the host's own interrupts and preemption),
+//           the total of the medians, the bytes they take on the ATmega1284 (heap_1.c needs no more)
+//           and heap_pool.c's pools, with its block sizes rounded up to
+//           the host's portBYTE_ALIGNMENT; the benchmark fails if one is
+//           refused or misaligned
+//   class   (heap_pool.c only) blocks per class after uC2's allocations,
+//           the most in use and the allocations that spilled into a
+//           larger class or failed
+//   churn   (heap_pool.c only; heap_1.c cannot free) the median, 99.9th
+//           percentile and worst cost of freeing a random block of uC2's
+//           and allocating one of the same size again, as deleting and
+//           recreating a task or queue would; the worst includes the
+//           host's own interrupts and preemption
+// Build with -DconfigUSE_HEAP_POOL=0|1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tasks.c"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline unsigned long long Bench_Now(void)
+{
+	_mm_lfence();
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static inline unsigned long long Bench_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#define BENCH_RUNS 1001
+#define BENCH_CHURN 200001UL
+#define BENCH_MOST 64			// Allocations in a list
+
+// ATmega1284 sizes: 2 byte pointers, 16 bit ticks, char portBASE_TYPE
+#define AVR_QUEUE 33			// xQUEUE with configUSE_TRACE_FACILITY
+#define AVR_TCB 43				// tskTCB with run time stats and trace numbers
+
+// xQueueCreate and xTaskCreate each make two allocations
+#define QUEUE(length, item) AVR_QUEUE, (length) * (item) + 1
+#define SEMAPHORE QUEUE(1, 0)
+#define TASK(stack) AVR_TCB, (stack)
+
+// In the order main() makes them; 0 ends a list
+static const unsigned short uC1List[] = {
+	QUEUE(2, 1),				// ADC_SamplerInit
+	SEMAPHORE, SEMAPHORE,		// USART_BufferedInit(0), (1)
+	QUEUE(8, 4),				// Keypad_Init: KeyEvent
+	QUEUE(4, 8),				// Link_Init: LinkMsg
+	QUEUE(8, 1),				// eventQueue
+	TASK(85), TASK(170), TASK(85), TASK(170),	// LED, Input, ProductLogic, Transmit
+	TASK(85),					// Idle
+	0
+};
+
+static const unsigned short uC2List[] = {
+	SEMAPHORE, SEMAPHORE,		// USART_BufferedInit(0), (1)
+	QUEUE(4, 7), QUEUE(4, 7),	// Stepper_Init: StepperMove per motor
+	QUEUE(10, 7), SEMAPHORE,	// Stepper_Init: done, idle
+	QUEUE(4, 3), QUEUE(4, 3),	// dispenseOrders: DispenseOrder
+	QUEUE(2, 1),				// ADC_SamplerInit
+	SEMAPHORE,					// Ledger_Init
+	QUEUE(4, 8),				// linkRxQueue: LinkMsg
+	QUEUE(10, 8),				// Link_Init: LINK_TX_QUEUE_LENGTH LinkMsg
+	SEMAPHORE,					// LCDBuf_Init
+	TASK(170), TASK(170), TASK(170), TASK(170),	// Dispense, LCD, ProductOutput, Link
+	TASK(85), TASK(85), TASK(85),	// LCDFlush, TraceTx, Ledger
+	TASK(85),					// Idle
+	0
+};
+
+static unsigned long long benchRun[BENCH_MOST][BENCH_RUNS];
+static unsigned long long benchAll[BENCH_MOST * BENCH_RUNS];
+static void* benchBlock[BENCH_MOST];
+
+static int Bench_Compare(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+// Empties the heap and sets it up again, outside the timed calls
+static void Bench_Reset(void)
+{
+	vPortInitialiseBlocks();
+	vPortFree(pvPortMalloc(1)); // heap_pool.c splits its pools on the first call
+}
+
+// Makes a list's allocations; 0 if one is refused
+static unsigned char Bench_Allocate(const unsigned short* list, unsigned run)
+{
+	unsigned long long start;
+	unsigned i;
+
+	for (i = 0; list[i]; i++) {
+		start = Bench_Now();
+		benchBlock[i] = pvPortMalloc(list[i]);
+		benchRun[i][run] = Bench_Now() - start;
+		if (!benchBlock[i]) {
+			fprintf(stderr, "bench_heap: allocation %u (%u bytes) refused\n", i, list[i]);
+			return 0;
+		}
+		if ((unsigned long)benchBlock[i] & portBYTE_ALIGNMENT_MASK) {
+			fprintf(stderr, "bench_heap: allocation %u (%u bytes) misaligned\n", i, list[i]);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Prints the cost of a list's allocations; 0 if one is refused
+static unsigned char Bench_Boot(const char* name, const unsigned short* list)
+{
+	unsigned long long slowest = 0, total = 0;
+	unsigned long calls = 0;
+	unsigned i, run, bytes = 0;
+
+	for (run = 0; run < BENCH_RUNS; run++) {
+		Bench_Reset();
+		if (!Bench_Allocate(list, run)) {
+			return 0;
+		}
+	}
+	for (i = 0; list[i]; i++) {
+		for (run = 0; run < BENCH_RUNS; run++) {
+			benchAll[calls++] = benchRun[i][run];
+		}
+		qsort(benchRun[i], BENCH_RUNS, sizeof(unsigned long long), Bench_Compare);
+		total += benchRun[i][BENCH_RUNS / 2];
+		if (benchRun[i][BENCH_RUNS / 2] > slowest) {
+			slowest = benchRun[i][BENCH_RUNS / 2];
+		}
+		bytes += list[i];
+	}
+	qsort(benchAll, calls, sizeof(unsigned long long), Bench_Compare);
+	printf("boot  %s  %2u allocations of %4u bytes  slowest median %5llu  99.9%% %5llu  worst %7llu  total %6llu %s",
+		name, i, bytes, slowest, benchAll[calls - calls / 1000], benchAll[calls - 1], total, BENCH_UNIT);
+#if ( configUSE_HEAP_POOL == 1 )
+	vPortInitialiseBlocks();
+	printf("  pools %u bytes", (unsigned)xPortGetFreeHeapSize());
+#endif
+	printf("\n");
+	return 1;
+}
+
+#if ( configUSE_HEAP_POOL == 1 )
+
+static unsigned long long benchChurn[BENCH_CHURN];
+
+// Prints the occupancy of each class after a list's allocations
+static void Bench_Classes(const unsigned short* list)
+{
+	xHeapClassStats stats;
+	unsigned portBASE_TYPE c;
+
+	Bench_Reset();
+	Bench_Allocate(list, 0);
+	for (c = 0; c < uxPortGetHeapClassCount(); c++) {
+		vPortGetHeapClassStats(c, &stats);
+		printf("class %3u bytes  %2u blocks  most in use %2u  spilled %u  failed %u\n",
+			stats.usBlockSize, stats.ucBlocks, stats.ucMostInUse, stats.usSpilled, stats.usFailed);
+	}
+}
+
+// Frees and reallocates random blocks of a list; 0 if one is refused
+static unsigned char Bench_Churn(const unsigned short* list)
+{
+	unsigned long long start;
+	unsigned long n;
+	unsigned count, i;
+
+	Bench_Reset();
+	if (!Bench_Allocate(list, 0)) {
+		return 0;
+	}
+	for (count = 0; list[count]; count++) {
+	}
+	srand(1);
+	for (n = 0; n < BENCH_CHURN; n++) {
+		i = rand() % count;
+		start = Bench_Now();
+		vPortFree(benchBlock[i]);
+		benchBlock[i] = pvPortMalloc(list[i]);
+		benchChurn[n] = Bench_Now() - start;
+		if (!benchBlock[i]) {
+			fprintf(stderr, "bench_heap: reallocation of %u bytes refused\n", list[i]);
+			return 0;
+		}
+	}
+	qsort(benchChurn, BENCH_CHURN, sizeof(unsigned long long), Bench_Compare);
+	printf("churn uC2  free + malloc  median %5llu %s  99.9%% %5llu %s  worst %6llu %s\n",
+		benchChurn[BENCH_CHURN / 2], BENCH_UNIT, benchChurn[BENCH_CHURN - BENCH_CHURN / 1000], BENCH_UNIT,
+		benchChurn[BENCH_CHURN - 1], BENCH_UNIT);
+	return 1;
+}
+
+#endif
+
+int main(void)
+{
+	printf("%s\n", configUSE_HEAP_POOL ? "heap_pool.c" : "heap_1.c");
+	if (!Bench_Boot("uC1", uC1List) || !Bench_Boot("uC2", uC2List)) {
+		return 1;
+	}
+#if ( configUSE_HEAP_POOL == 1 )
+	Bench_Classes(uC2List);
+	if (!Bench_Churn(uC2List)) {
+		return 1;
+	}
+#else
+	printf("churn uC2  heap_1.c cannot free\n");
+#endif
+	return 0;
+}
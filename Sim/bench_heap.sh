@@ -0,0 +1,18 @@
+#!/bin/sh
+# Heap benchmark: builds Sim/bench_heap.c with heap_1.c and with heap_pool.c
+# (configUSE_HEAP_POOL) and prints the cost of the allocations uC1 and uC2
+# make at boot, and heap_pool.c's cost of freeing and allocating again. See
+# bench_heap.c for what is measured.
+# Usage: Sim/bench_heap.sh
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_heap.c queue.c list.c croutine.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+for pool in 0 1; do
+	gcc $CFLAGS -DconfigUSE_HEAP_POOL=$pool -o Sim/build/bench_heap $SOURCES -lm
+	Sim/build/bench_heap
+done
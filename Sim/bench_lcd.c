@@ -0,0 +1,191 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// LCD frame buffer benchmark for the host, built and run by
+// Sim/bench_lcd.sh.
+// lcd.h is replaced by a mock HD44780 that counts every bus write and
+// keeps its own DDRAM, address counter included. The screens the second
+// microcontroller's LCD_Logic draws over a vend cycle (and a refused
+// selection) are drawn into the frame buffer (lcd_buffer.h) one frame at
+// a time, each followed by LCDBuf_Flush(). After each flush the mock must
+// show the frame, and the flush must have written exactly the cells that
+// changed, plus one address command for each run of them; otherwise the
+// benchmark fails. For each frame it prints:
+//   changed   cells whose character differs from the frame before
+//   buffered  bus writes made by the flush
+//   direct    bus writes the same drawing costs with lcd.h (clear display,
+//             then an address command and a data write per character)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tasks.c"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+#include "timing.h"
+
+// Mock HD44780, in place of lcd.h
+#define LCD_H
+#define LCD_DDRAM 0x80
+
+static unsigned char lcdDdram[LCD_DDRAM];	// Row 1 at 0x00, row 2 at 0x40
+static unsigned char lcdAddress;			// Address counter
+static unsigned long lcdMockWrites;			// Bus writes, commands and data
+
+void LCD_BusWrite(unsigned char rs, unsigned char value)
+{
+	lcdMockWrites++;
+	if (rs) {
+		lcdDdram[lcdAddress] = value;
+		lcdAddress = (lcdAddress + 1) % LCD_DDRAM;
+	} else if (value & 0x80) {
+		lcdAddress = value & 0x7F; // Set DDRAM address
+	} else if (value == 0x01) {
+		memset(lcdDdram, ' ', LCD_DDRAM); // Clear display
+		lcdAddress = 0;
+	}
+}
+
+void LCD_init(void)
+{
+	LCD_BusWrite(0, 0x38);
+	LCD_BusWrite(0, 0x06);
+	LCD_BusWrite(0, 0x0f);
+	LCD_BusWrite(0, 0x01);
+}
+
+#include "lcd_buffer.h"
+
+static unsigned short benchDirect;	// Bus writes the frame costs with lcd.h
+
+static void Bench_DisplayString(unsigned char column, const char* string)
+{
+	benchDirect += 1 + 2 * strlen(string);
+	LCDBuf_DisplayString(column, string);
+}
+
+static void Bench_WriteString(unsigned char column, const char* string)
+{
+	benchDirect += 2 * strlen(string);
+	LCDBuf_WriteString(column, string);
+}
+
+// As LCD_DisplayCoins() in uC2.c
+static void Bench_Coins(unsigned char coins)
+{
+	char balance[5];
+
+	balance[0] = '0' + coins / 4;
+	balance[1] = '.';
+	balance[2] = '0' + (coins % 4) * 25 / 10;
+	balance[3] = '0' + (coins % 4) * 25 % 10;
+	balance[4] = '\0';
+	Bench_WriteString(11, balance);
+}
+
+// Draws frame n as LCD_Logic would; 0 past the last one
+static const char* Bench_Frame(unsigned char n)
+{
+	switch (n) {
+		case 0:
+			Bench_DisplayString(1, "Welcome to ");
+			Bench_WriteString(17, "MiniVendi!");
+			return "welcome";
+		case 1:
+			Bench_DisplayString(1, "Balance: $");
+			Bench_Coins(0);
+			return "balance";
+		case 2: case 3: case 4: case 5:
+			Bench_Coins(n - 1);
+			return "coin";
+		case 6:
+			Bench_Coins(4); // Drawn every LCD_Logic tick: nothing changed
+			return "same";
+		case 7:
+			Bench_DisplayString(1, "Dispensing");
+			Bench_WriteString(17, "<COLA>");
+			return "dispense";
+		case 8:
+			Bench_DisplayString(1, "THANK YOU FOR");
+			Bench_WriteString(17, "YOUR PURCHASE!");
+			return "thank you";
+		case 9:
+			Bench_DisplayString(1, "Balance: $");
+			Bench_Coins(0);
+			return "balance";
+		case 10:
+			Bench_DisplayString(1, "INSUFFICIENT");
+			Bench_WriteString(17, "FUNDS");
+			return "refused";
+		case 11:
+			Bench_DisplayString(1, "Balance: $");
+			Bench_Coins(0);
+			return "balance";
+		case 12:
+			Bench_DisplayString(1, "Balance: $"); // Cleared and drawn back
+			Bench_Coins(0);
+			return "redraw";
+		default:
+			return 0;
+	}
+}
+
+// Cell as the mock shows it
+static unsigned char Bench_Shown(unsigned char cell)
+{
+	return lcdDdram[(cell < 16) ? cell : 0x40 + cell - 16];
+}
+
+int main(void)
+{
+	unsigned char before[LCD_CELLS];
+	unsigned char n, cell, changed, runs, last;
+	unsigned long writes, buffered = 0, direct = 0;
+	const char* name;
+
+	LCDBuf_Init();
+	printf("frame       changed  buffered  direct\n");
+	for (n = 0; ; n++) {
+		memcpy(before, lcdShown, LCD_CELLS);
+		benchDirect = 0;
+		if (!(name = Bench_Frame(n))) {
+			break;
+		}
+		writes = lcdMockWrites;
+		LCDBuf_Flush();
+		writes = lcdMockWrites - writes;
+
+		changed = runs = 0;
+		last = 0xFF;
+		for (cell = 0; cell < LCD_CELLS; cell++) {
+			if (Bench_Shown(cell) != lcdFrame[cell]) {
+				fprintf(stderr, "bench_lcd: %s: cell %u shows '%c', not '%c'\n",
+					name, cell + 1, Bench_Shown(cell), lcdFrame[cell]);
+				return 1;
+			}
+			if (before[cell] != lcdFrame[cell]) {
+				changed++;
+				if (cell != last + 1 || cell == 16) {
+					runs++;
+				}
+				last = cell;
+			}
+		}
+		if (writes != changed + runs) {
+			fprintf(stderr, "bench_lcd: %s: %lu bus writes for %u changed cells in %u runs\n",
+				name, writes, changed, runs);
+			return 1;
+		}
+		printf("%-10s  %7u  %8lu  %6u\n", name, changed, writes, benchDirect);
+		buffered += writes;
+		direct += benchDirect;
+	}
+	if (lcdBusWrites != buffered) {
+		fprintf(stderr, "bench_lcd: lcdBusWrites is %u, the mock saw %lu\n", lcdBusWrites, buffered);
+		return 1;
+	}
+	printf("total                %8lu  %6lu  (%lu%% of direct)\n", buffered, direct, buffered * 100 / direct);
+	return 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+# LCD frame buffer benchmark: builds Sim/bench_lcd.c and counts the bus
+# writes each frame of LCD_Logic costs on a mock LCD. See bench_lcd.c for
+# what is measured.
+# Usage: Sim/bench_lcd.sh
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_lcd.c queue.c list.c croutine.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+gcc $CFLAGS -o Sim/build/bench_lcd $SOURCES -lm
+Sim/build/bench_lcd
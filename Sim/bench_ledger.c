@@ -0,0 +1,193 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// EEPROM ledger benchmark for the host simulation, built and run by
+// Sim/bench_ledger.sh.
+// It appends BENCH_RECORDS records to the ledger (eeprom_ledger.h) in the
+// simulated EEPROM, going round the ring many times, and after each one
+// recovers the ledger as a reset would: the newest record must come back,
+// or the benchmark fails. Every BENCH_TEAR_EVERY records it also tears
+// one as power failing mid-record would (VERSION still LEDGER_TORN), taking
+// the 1 in 256 case where the stale CRC matches, and the record must be
+// passed over for the one before. It prints:
+//   wear      byte writes per EEPROM cell (Sim_EepromWrites) over the ring,
+//             and how many records the ring lasts at BENCH_ENDURANCE
+//             writes per cell, against rewriting one fixed record
+//   recover   median cost of Ledger_Recover() and the records it reads,
+//             with the ring empty, partly filled, full and wrapped,
+//             against reading every slot to find the highest SEQ
+// Build with [-DLEDGER_SLOTS=n].
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tasks.c"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+#include "eeprom_ledger.h"
+#include "sim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline unsigned long long Bench_Now(void)
+{
+	_mm_lfence();
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static inline unsigned long long Bench_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#define BENCH_RECORDS 70001UL	// SEQ wraps too
+#define BENCH_TEAR_EVERY 97
+#define BENCH_ENDURANCE 100000UL	// ATmega1284 EEPROM write cycles per cell
+#define BENCH_RUNS 1001
+
+static unsigned long long benchRun[BENCH_RUNS];
+
+static int Bench_Compare(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+// The state of record n
+static void Bench_State(unsigned long n, LedgerState* state)
+{
+	memset(state, 0, sizeof(LedgerState));
+	state->sold[0] = n;
+	state->sold[1] = n * 7;
+	state->refunds = n >> 16;
+	state->coins = n % 251;
+	state->pending[n & 1] = 1;
+}
+
+// Recovers the ledger and checks it came back as record n; 0 if it did not
+static unsigned char Bench_Check(unsigned long n)
+{
+	LedgerState found, want;
+
+	Bench_State(n, &want);
+	if (!Ledger_Recover(&found) || memcmp(&found, &want, sizeof(LedgerState))) {
+		fprintf(stderr, "bench_ledger: record %lu not recovered (slot %u, seq %u)\n",
+			n, ledgerSlot, ledgerSeq);
+		return 0;
+	}
+	return 1;
+}
+
+// Reference recovery: reads every slot for the highest SEQ
+static unsigned short Bench_LinearRecover(LedgerState* state)
+{
+	LedgerRecord r;
+	unsigned short slot, newest = 0, seq = 0;
+	unsigned char found = 0;
+
+	for (slot = 0; slot < LEDGER_SLOTS; slot++) {
+		if (Ledger_Read(slot, &r) && (!found || (short)(r.seq - seq) > 0)) {
+			seq = r.seq;
+			newest = slot;
+			*state = r.state;
+			found = 1;
+		}
+	}
+	return newest;
+}
+
+// Prints the median cost of recovering the ledger as it now is
+static void Bench_Recover(const char* name)
+{
+	LedgerState state;
+	unsigned long long start, binary, linear;
+	unsigned char reads;
+	unsigned i;
+
+	for (i = 0; i < BENCH_RUNS; i++) {
+		start = Bench_Now();
+		Ledger_Recover(&state);
+		benchRun[i] = Bench_Now() - start;
+	}
+	reads = ledgerBootReads;
+	qsort(benchRun, BENCH_RUNS, sizeof(unsigned long long), Bench_Compare);
+	binary = benchRun[BENCH_RUNS / 2];
+	for (i = 0; i < BENCH_RUNS; i++) {
+		start = Bench_Now();
+		Bench_LinearRecover(&state);
+		benchRun[i] = Bench_Now() - start;
+	}
+	qsort(benchRun, BENCH_RUNS, sizeof(unsigned long long), Bench_Compare);
+	linear = benchRun[BENCH_RUNS / 2];
+	printf("recover %-14s binary %8llu %s %3u reads   linear %8llu %s %4u reads\n",
+		name, binary, BENCH_UNIT, reads, linear, BENCH_UNIT, (unsigned)LEDGER_SLOTS);
+	Ledger_Recover(&state); // Leave the ledger where it was
+}
+
+int main(void)
+{
+	LedgerState state;
+	unsigned long n, torn = 0, total = 0, most = 0, least = ~0UL;
+	unsigned short a;
+	unsigned char* slot;
+	LedgerRecord cut;
+
+	if (!Ledger_Init(&state) || !ledgerEmpty) {
+		fprintf(stderr, "bench_ledger: EEPROM not erased\n");
+		return 1;
+	}
+	Bench_Recover("empty");
+
+	for (n = 1; n <= BENCH_RECORDS; n++) {
+		Bench_State(n, &state);
+		Ledger_Write(&state);
+		if (n % BENCH_TEAR_EVERY == 0) {
+			// Power fails before the last byte, and the CRC checks anyway:
+			// the record must not count
+			slot = (unsigned char*)(LEDGER_START + ledgerSlot * LEDGER_RECORD_SIZE);
+			eeprom_read_block(&cut, slot, LEDGER_RECORD_SIZE);
+			cut.version = LEDGER_TORN;
+			eeprom_write_byte(slot + offsetof(LedgerRecord, version), LEDGER_TORN);
+			eeprom_write_byte(slot + offsetof(LedgerRecord, crc), Ledger_Crc(&cut));
+			if (!Bench_Check(n - 1)) {
+				return 1;
+			}
+			Ledger_Write(&state); // Retried after the reset, over the torn one
+			torn++;
+		}
+		if (!Bench_Check(n)) {
+			return 1;
+		}
+		if (n == 1) {
+			Bench_Recover("1 record");
+		} else if (n == LEDGER_SLOTS / 2) {
+			Bench_Recover("half full");
+		} else if (n == LEDGER_SLOTS) {
+			Bench_Recover("full");
+		}
+	}
+	Bench_Recover("wrapped");
+
+	for (a = LEDGER_START; a < LEDGER_START + LEDGER_SIZE; a++) {
+		total += Sim_EepromWrites(a);
+		if (Sim_EepromWrites(a) > most) {
+			most = Sim_EepromWrites(a);
+		}
+		if (Sim_EepromWrites(a) < least) {
+			least = Sim_EepromWrites(a);
+		}
+	}
+	printf("wear    %lu records (%lu torn) in %u slots of %u bytes: %lu byte writes, per cell min %lu max %lu\n",
+		BENCH_RECORDS + torn, torn, (unsigned)LEDGER_SLOTS, (unsigned)LEDGER_RECORD_SIZE, total, least, most);
+	printf("wear    lasts %.0f records at %lu writes per cell, one fixed record %lu\n",
+		(double)(BENCH_RECORDS + torn) / most * BENCH_ENDURANCE, BENCH_ENDURANCE, BENCH_ENDURANCE);
+	return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# EEPROM ledger benchmark: builds Sim/bench_ledger.c for each ring size and
+# prints the wear per EEPROM cell and the cost of recovering the ledger at
+# boot. See bench_ledger.c for what is measured.
+# Usage: Sim/bench_ledger.sh [SLOT COUNTS]   (default 64 240)
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_ledger.c queue.c list.c croutine.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+for slots in ${*:-64 240}; do
+	gcc $CFLAGS -DLEDGER_SLOTS=$slots -o Sim/build/bench_ledger $SOURCES -lm
+	SIM_EEPROM= Sim/build/bench_ledger
+done
@@ -0,0 +1,294 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Link protocol loopback benchmark for the host simulation, built and run
+// for several baud rates by Sim/bench_link.sh.
+// Two links run in one image, as the two microcontrollers would: link A on
+// USART0 and link B on USART1, their lines crossed through FIFOs, both at
+// BENCH_BAUD in virtual time. A sender task queues numbered messages on A
+// as fast as Link_Send() takes them and B checks they arrive once, in order.
+// It prints:
+//   throughput  messages per second for short and full payloads, against
+//               the bound the line sets (frame plus ACK, 10 bits per byte)
+//   recovery    ms from a byte of line noise (written into B's RX FIFO
+//               while messages stream) until B delivers again, and the CRC
+//               errors, retransmits and stalled frames it caused
+//   restart     ms until the first message after A restarts is delivered,
+//               with B's last delivered SEQ equal to each of the first
+//               SEQs A sends after a restart
+//   outage      ms from B coming back after BENCH_OUTAGE ticks down (far
+//               past LINK_MAX_RETRIES) until the message A sent meanwhile
+//               is delivered, and the retransmits it took
+// The benchmark fails if a message is lost, repeated or out of order.
+// Build with -DBENCH_BAUD=n [-DLINK_RETRY_TICKS=n].
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define USART0_BAUD BENCH_BAUD
+#define USART1_BAUD BENCH_BAUD
+#include "FreeRTOS.h"
+#include "task.h"
+#include "usart_isr_ATmega1284.h"
+#include "link_protocol.h"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+
+#define BENCH_MESSAGES 300		// Per throughput run
+#define BENCH_NOISE_BURSTS 50
+#define BENCH_NOISE_GAP 100		// Ticks between noise bytes
+#define BENCH_NOISE_PHASES 16	// Ticks over which they are spread
+#define BENCH_TIMEOUT 5000		// Ticks without a delivery before giving up
+#define BENCH_OUTAGE 3000		// Ticks B is down
+#define BENCH_TYPE LINK_SELECTION
+
+static Link linkA, linkB;
+static volatile unsigned short benchDelivered;		// Messages B delivered this run
+static volatile unsigned short benchNext;			// Number B expects next
+static volatile unsigned char benchBad;				// Lost, repeated or out of order
+static volatile portTickType benchLastDelivery;
+static volatile unsigned char benchRestart;			// Link A task: restart A
+static volatile unsigned char benchDown;			// Link B task: B is down, then restarts
+static int benchNoiseFd = -1;						// B's RX FIFO
+
+static void Bench_Deliver(const LinkMsg* msg)
+{
+	unsigned short n = (msg->data[0] << 8) | msg->data[1];
+
+	if (msg->type != BENCH_TYPE || n != benchNext) {
+		fprintf(stderr, "bench_link: got message %u, expected %u\n", n, benchNext);
+		benchBad = 1;
+	}
+	benchNext = n + 1;
+	benchDelivered++;
+	benchLastDelivery = xTaskGetTickCount();
+}
+
+static void Bench_LinkA(void* pvParameters)
+{
+	unsigned char data;
+
+	for(;;)
+	{
+		if (benchRestart) {
+			// As after a reset: link state and received bytes are gone
+			Link_Init(&linkA, 0, NULL);
+			while (USART_Read(0, &data));
+			benchRestart = 0;
+		}
+		Link_Service(&linkA);
+	}
+}
+
+static void Bench_LinkB(void* pvParameters)
+{
+	unsigned char data;
+
+	for(;;)
+	{
+		if (benchDown) {
+			// Deaf until it comes back with a new session, as after a reset
+			while (benchDown) {
+				while (USART_Read(1, &data));
+				vTaskDelay(1);
+			}
+			Link_Init(&linkB, 1, Bench_Deliver);
+		}
+		Link_Service(&linkB);
+	}
+}
+
+// Queues message n on A, waiting for room
+static void Bench_Send(unsigned short n, unsigned char len)
+{
+	unsigned char data[LINK_MAX_PAYLOAD] = {n >> 8, n & 0xFF};
+
+	while (!Link_Send(&linkA, BENCH_TYPE, data, len)) {
+		vTaskDelay(1);
+	}
+}
+
+// Waits until B has delivered count messages this run; 0 on a timeout
+static unsigned char Bench_WaitDelivered(unsigned short count)
+{
+	while (benchDelivered < count) {
+		if ((portTickType)(xTaskGetTickCount() - benchLastDelivery) > BENCH_TIMEOUT) {
+			fprintf(stderr, "bench_link: %u of %u messages delivered\n", benchDelivered, count);
+			return 0;
+		}
+		vTaskDelay(1);
+	}
+	return !benchBad;
+}
+
+static void Bench_Start(unsigned short next)
+{
+	benchDelivered = 0;
+	benchNext = next;
+	benchLastDelivery = xTaskGetTickCount();
+}
+
+static unsigned char Bench_Throughput(unsigned short* n, unsigned char len)
+{
+	unsigned short retransmits = linkA.retransmits, i;
+	unsigned long bound = (unsigned long)BENCH_BAUD / 10 / (LINK_HEADER_SIZE + len + 1 + LINK_HEADER_SIZE + 1);
+	portTickType start;
+
+	Bench_Start(*n);
+	start = xTaskGetTickCount();
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		Bench_Send((*n)++, len);
+	}
+	if (!Bench_WaitDelivered(BENCH_MESSAGES)) {
+		return 0;
+	}
+	printf("  throughput  payload %u: %u messages in %5u ms, %6.1f msg/s (line bound %lu), %u retransmits\n",
+		len, BENCH_MESSAGES, (portTickType)(benchLastDelivery - start),
+		BENCH_MESSAGES * 1000.0 / (portTickType)(benchLastDelivery - start), bound,
+		linkA.retransmits - retransmits);
+	return 1;
+}
+
+static unsigned char Bench_Recovery(unsigned short* n)
+{
+	static const unsigned char noise = 0xFF;
+	unsigned short crcErrors = linkA.crcErrors + linkB.crcErrors;
+	unsigned short retransmits = linkA.retransmits, stalls = linkA.stalls;
+	unsigned long total = 0, most = 0, least = ~0UL, wait;
+	unsigned short burst, sent = 0;
+	portTickType at;
+
+	Bench_Start(*n);
+	for (burst = 0; burst < BENCH_NOISE_BURSTS; burst++) {
+		// Keep the line busy, then hit whatever is on it. Link_Send() takes
+		// a message just as A starts a frame, so wait a while longer, a
+		// different part of a frame each time
+		at = xTaskGetTickCount();
+		while ((portTickType)(xTaskGetTickCount() - at) < BENCH_NOISE_GAP) {
+			Bench_Send((*n)++, 2);
+			sent++;
+		}
+		vTaskDelay(1 + burst % BENCH_NOISE_PHASES);
+		at = xTaskGetTickCount();
+		if (write(benchNoiseFd, &noise, 1) != 1) {
+			return 0;
+		}
+		while (benchLastDelivery == at || (portTickType)(benchLastDelivery - at) > BENCH_TIMEOUT) {
+			if ((portTickType)(xTaskGetTickCount() - at) > BENCH_TIMEOUT) {
+				fprintf(stderr, "bench_link: no delivery after noise\n");
+				return 0;
+			}
+			vTaskDelay(1);
+		}
+		wait = (portTickType)(benchLastDelivery - at);
+		total += wait;
+		most = (wait > most) ? wait : most;
+		least = (wait < least) ? wait : least;
+	}
+	if (!Bench_WaitDelivered(sent)) {
+		return 0;
+	}
+	printf("  recovery    %u noise bytes: delivering again after min %lu avg %.1f max %lu ms; %u CRC errors, %u retransmits, %u stalled\n",
+		BENCH_NOISE_BURSTS, least, (double)total / BENCH_NOISE_BURSTS, most,
+		linkA.crcErrors + linkB.crcErrors - crcErrors, linkA.retransmits - retransmits,
+		linkA.stalls - stalls);
+	return linkA.stalls == stalls;
+}
+
+// Restarts A with B's last delivered SEQ at seq: A's first frames after a
+// restart carry SEQ 0 (the LINK_RESET) and 1
+static unsigned char Bench_Restart(unsigned short* n, unsigned char seq)
+{
+	unsigned short count = 0;
+	portTickType at;
+
+	// One message at a time, so B's SEQ is seq once A is idle
+	Bench_Start(*n);
+	while (!linkB.rxSeqValid || linkB.rxLastSeq != seq) {
+		Bench_Send((*n)++, 2);
+		if (!Bench_WaitDelivered(++count)) {
+			return 0;
+		}
+	}
+	while (linkA.pendingValid) {
+		vTaskDelay(1);
+	}
+	benchRestart = 1;
+	USART_WakeWaiter(0);
+	while (benchRestart) {
+		vTaskDelay(1);
+	}
+	at = xTaskGetTickCount();
+	Bench_Start(*n);
+	Bench_Send((*n)++, 2);
+	if (!Bench_WaitDelivered(1)) {
+		fprintf(stderr, "bench_link: the first message after a restart was lost\n");
+		return 0;
+	}
+	printf("  restart     at SEQ %u: first message after A restarts delivered in %u ms (%u resets seen)\n",
+		seq, (portTickType)(benchLastDelivery - at), linkB.resets);
+	return 1;
+}
+
+// Takes B down for BENCH_OUTAGE ticks with a message on its way: it must
+// be delivered once B is back, not dropped when the retries run out
+static unsigned char Bench_Outage(unsigned short* n)
+{
+	unsigned short retransmits = linkA.retransmits;
+	portTickType at;
+
+	benchDown = 1;
+	vTaskDelay(1);
+	Bench_Start(*n);
+	Bench_Send((*n)++, 2);
+	vTaskDelay(BENCH_OUTAGE);
+	benchDown = 0;
+	at = xTaskGetTickCount();
+	Bench_Start(benchNext);
+	while (benchDelivered < 1) {
+		if ((portTickType)(xTaskGetTickCount() - at) > BENCH_TIMEOUT) {
+			fprintf(stderr, "bench_link: the message sent while B was down was lost\n");
+			return 0;
+		}
+		vTaskDelay(1);
+	}
+	printf("  outage      %u ms: message sent meanwhile delivered %u ms after B is back, %u retransmits\n",
+		BENCH_OUTAGE, (portTickType)(benchLastDelivery - at), linkA.retransmits - retransmits);
+	return !benchBad;
+}
+
+static void Bench_Task(void* pvParameters)
+{
+	unsigned short n = 0;
+
+	printf("%lu baud, line %lu bytes/s, retransmit after %u ms\n", (unsigned long)BENCH_BAUD,
+		(unsigned long)BENCH_BAUD / 10, LINK_RETRY_TICKS);
+	if (!Bench_Throughput(&n, 2) || !Bench_Throughput(&n, LINK_MAX_PAYLOAD)
+		|| !Bench_Recovery(&n) || !Bench_Restart(&n, 0) || !Bench_Restart(&n, 1)
+		|| !Bench_Outage(&n)) {
+		exit(1);
+	}
+	exit(0);
+}
+
+int main(void)
+{
+	const char* noise = getenv("SIM_USART1_RX");
+
+	if (!noise || (benchNoiseFd = open(noise, O_RDWR | O_NONBLOCK)) < 0) {
+		fprintf(stderr, "bench_link: SIM_USART1_RX must name B's RX FIFO\n");
+		return 1;
+	}
+	USART_BufferedInit(0);
+	USART_BufferedInit(1);
+	Link_Init(&linkA, 0, NULL);
+	Link_Init(&linkB, 1, Bench_Deliver);
+	xTaskCreate(Bench_LinkA, (signed portCHAR *)"LinkA", configMINIMAL_STACK_SIZE * 2, NULL, 2, NULL);
+	xTaskCreate(Bench_LinkB, (signed portCHAR *)"LinkB", configMINIMAL_STACK_SIZE * 2, NULL, 2, NULL);
+	xTaskCreate(Bench_Task, (signed portCHAR *)"Bench", configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+	vTaskStartScheduler();
+	return 1;
+}
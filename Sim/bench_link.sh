@@ -0,0 +1,28 @@
+#!/bin/sh
+# Link protocol loopback benchmark: builds Sim/bench_link.c for each baud
+# rate and runs it in virtual time with two links crossed through FIFOs.
+# See bench_link.c for what is measured. RETRY_TICKS overrides
+# LINK_RETRY_TICKS.
+# Usage: [RETRY_TICKS=n] Sim/bench_link.sh [BAUD RATES]   (default 9600 38400 250000)
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_link.c tasks.c queue.c list.c croutine.c timers.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+SIM_DIR=${SIM_DIR:-/tmp/minivendi-sim}
+
+mkdir -p Sim/build "$SIM_DIR"
+for fifo in linkAB linkBA; do
+	[ -p "$SIM_DIR/$fifo" ] || mkfifo "$SIM_DIR/$fifo"
+done
+for baud in ${*:-9600 38400 250000}; do
+	gcc $CFLAGS -DBENCH_BAUD=$baud ${RETRY_TICKS:+-DLINK_RETRY_TICKS=$RETRY_TICKS} \
+		-o Sim/build/bench_link $SOURCES -lm
+	SIM_VIRTUAL=1 SIM_USART0_TX=$SIM_DIR/linkAB SIM_USART1_RX=$SIM_DIR/linkAB \
+		SIM_USART1_TX=$SIM_DIR/linkBA SIM_USART0_RX=$SIM_DIR/linkBA \
+		Sim/build/bench_link 2>"$SIM_DIR/bench_link.err" || {
+		grep -v "^sim:" "$SIM_DIR/bench_link.err" >&2
+		exit 1
+	}
+done
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Vend throughput benchmark: runs both images in virtual time, in lockstep
+# through a shared clock file, while uC1 feeds SIM_WORKLOAD as board events.
+# The vend statistics and each image's task CPU use are printed at the end.
+# Usage: Sim/bench_pair.sh [VENDS] [WORKLOAD]   (default 20 "c1")
+set -e
+cd "$(dirname "$0")"
+[ -x build/uC1 ] && [ -x build/uC2 ] || ./build.sh -O2
+
+SIM_DIR=${SIM_DIR:-/tmp/minivendi-sim}
+mkdir -p "$SIM_DIR"
+for fifo in link12 link21; do
+	[ -p "$SIM_DIR/$fifo" ] || mkfifo "$SIM_DIR/$fifo"
+done
+rm -f "$SIM_DIR/vclock"
+export SIM_VIRTUAL=1 SIM_VCLOCK=$SIM_DIR/vclock
+
+SIM_VCLOCK_ID=1 SIM_USART1_TX=$SIM_DIR/link21 SIM_USART1_RX=$SIM_DIR/link12 \
+	SIM_USART0_RX=/dev/null SIM_USART0_TX=$SIM_DIR/uC2.usart0 \
+	build/uC2 &
+uc2=$!
+trap 'kill $uc2 2>/dev/null' EXIT INT TERM
+
+SIM_VCLOCK_ID=0 SIM_USART1_TX=$SIM_DIR/link12 SIM_USART1_RX=$SIM_DIR/link21 \
+	SIM_USART0_RX=/dev/null SIM_USART0_TX=$SIM_DIR/uC1.usart0 \
+	SIM_VENDS=${1:-20} SIM_WORKLOAD=${2:-c1} \
+	build/uC1
+wait $uc2
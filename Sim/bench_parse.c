@@ -0,0 +1,112 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Bluetooth command parser benchmark for the host, built and run by
+// Sim/bench_parse.sh.
+// It feeds a command stream from a file (Sim/bt_commands.txt unless given
+// another, e.g. bytes captured from the Bluetooth module with
+// SIM_USART0_RX) through BtParser_Feed() byte by byte, as Input_Logic on
+// the first microcontroller does, BENCH_PASSES times, and prints the
+// median cost of a pass per byte and per command parsed, with the commands
+// and errors found. Every pass must find the same commands, or the
+// benchmark fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bt_command.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline unsigned long long Bench_Now(void)
+{
+	_mm_lfence();
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static inline unsigned long long Bench_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#define BENCH_PASSES 2001
+#define BENCH_MAX_STREAM 65536
+
+static unsigned char benchStream[BENCH_MAX_STREAM];
+static unsigned long long benchPass[BENCH_PASSES];
+static const char* const benchNames[] = {"none", "order", "status", "price", "stats", "error"};
+
+static int Bench_Compare(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = (argc > 1) ? argv[1] : "Sim/bt_commands.txt";
+	unsigned long counts[BT_ERROR + 1] = {0}, items = 0, first[BT_ERROR + 1];
+	unsigned long long start, median;
+	unsigned pass, i, commands;
+	size_t size;
+	BtParser parser;
+	BtCommand cmd;
+	unsigned char type;
+	FILE* f;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	size = fread(benchStream, 1, BENCH_MAX_STREAM, f);
+	fclose(f);
+	if (!size) {
+		fprintf(stderr, "bench_parse: %s is empty\n", path);
+		return 1;
+	}
+
+	BtParser_Init(&parser);
+	for (pass = 0; pass < BENCH_PASSES; pass++) {
+		start = Bench_Now();
+		for (i = 0; i < size; i++) {
+			type = BtParser_Feed(&parser, benchStream[i], &cmd);
+			counts[type]++;
+			if (type == BT_ORDER) {
+				items += cmd.count;
+			}
+		}
+		benchPass[pass] = Bench_Now() - start;
+		if (!pass) {
+			for (i = 0; i <= BT_ERROR; i++) {
+				first[i] = counts[i];
+			}
+		}
+	}
+	for (i = BT_ORDER; i <= BT_ERROR; i++) {
+		if (counts[i] != first[i] * BENCH_PASSES) {
+			fprintf(stderr, "bench_parse: %s commands differ between passes\n", benchNames[i]);
+			return 1;
+		}
+	}
+
+	qsort(benchPass, BENCH_PASSES, sizeof(unsigned long long), Bench_Compare);
+	median = benchPass[BENCH_PASSES / 2];
+	commands = size - first[BT_NONE];
+	printf("%s: %lu bytes, %u commands:", path, (unsigned long)size, commands);
+	for (i = BT_ORDER; i <= BT_ERROR; i++) {
+		printf(" %lu %s", first[i], benchNames[i]);
+	}
+	printf(" (%lu items ordered)\n", items / BENCH_PASSES);
+	printf("per byte %5.2f  per command %6.1f  per pass %llu  %s  (median of %u passes)\n",
+		(double)median / size, (double)median / commands, median, BENCH_UNIT, BENCH_PASSES);
+	return 0;
+}
@@ -0,0 +1,11 @@
+#!/bin/sh
+# Bluetooth command parser benchmark: builds Sim/bench_parse.c and runs it
+# on a recorded command stream. See bench_parse.c for what is measured.
+# Usage: Sim/bench_parse.sh [STREAM FILE]   (default Sim/bt_commands.txt)
+set -e
+[ $# -gt 0 ] && set -- "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+cd "$(dirname "$0")/.."
+
+mkdir -p Sim/build
+gcc -std=gnu99 -O2 -ISim -IIncludes -o Sim/build/bench_parse Sim/bench_parse.c
+Sim/build/bench_parse "$@"
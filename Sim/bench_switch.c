@@ -0,0 +1,124 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Context switch cost benchmark for the host simulation, built and run for
+// several priority counts by Sim/bench_switch.sh.
+// It includes tasks.c itself to drive the ready lists directly, with one
+// task at the top priority (the worst case for the linear search) and the
+// idle task at priority 0:
+//   block  the top task leaves its ready list (as in vTaskDelay) and the
+//          scheduler has to find the idle task
+//   wake   the top task is made ready again (as by the tick) and selected
+// Each is timed as ready list update + task selection, and again with the
+// whole vTaskSwitchContext() (run-time counter, trace hooks) doing the
+// selection. Nothing is swapped in: pxCurrentTCB is only chosen.
+// Build with -DconfigMAX_PRIORITIES=n -DconfigUSE_OPTIMISED_TASK_SELECTION=0|1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tasks.c"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline unsigned long long Bench_Now(void)
+{
+	_mm_lfence();
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static inline unsigned long long Bench_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#define BENCH_RUNS 200000
+
+enum BenchSample {BS_EMPTY,BS_BLOCK,BS_WAKE,BS_SWITCH_BLOCK,BS_SWITCH_WAKE,BS_COUNT};
+
+static unsigned long long benchSamples[BS_COUNT][BENCH_RUNS];
+
+static void Bench_Task(void* pvParameters)
+{
+	for(;;); // Never runs
+}
+
+static int Bench_Compare(const void* a, const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+static long long Bench_Median(enum BenchSample s)
+{
+	qsort(benchSamples[s], BENCH_RUNS, sizeof(unsigned long long), Bench_Compare);
+	return (long long)benchSamples[s][BENCH_RUNS / 2];
+}
+
+int main(void)
+{
+	xTaskHandle top, idle;
+	tskTCB* pxTop;
+	unsigned long i;
+	unsigned long long start;
+	long long overhead;
+
+	xTaskCreate(Bench_Task, (signed portCHAR *)"IDLE", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, &idle);
+	xTaskCreate(Bench_Task, (signed portCHAR *)"Top", configMINIMAL_STACK_SIZE, NULL, configMAX_PRIORITIES - 1, &top);
+	pxTop = (tskTCB*)top;
+	xSchedulerRunning = pdTRUE; // Lets vTaskSwitchContext() select
+
+	for (i = 0; i < BENCH_RUNS; i++) {
+		start = Bench_Now();
+		benchSamples[BS_EMPTY][i] = Bench_Now() - start;
+
+		start = Bench_Now();
+		vListRemove(&(pxTop->xGenericListItem));
+		taskRESET_READY_PRIORITY(pxTop->uxPriority);
+		taskSELECT_HIGHEST_PRIORITY_TASK();
+		benchSamples[BS_BLOCK][i] = Bench_Now() - start;
+		if (pxCurrentTCB != idle) {
+			fprintf(stderr, "bench_switch: block selected the wrong task\n");
+			return 1;
+		}
+
+		start = Bench_Now();
+		prvAddTaskToReadyQueue(pxTop);
+		taskSELECT_HIGHEST_PRIORITY_TASK();
+		benchSamples[BS_WAKE][i] = Bench_Now() - start;
+		if (pxCurrentTCB != top) {
+			fprintf(stderr, "bench_switch: wake selected the wrong task\n");
+			return 1;
+		}
+
+		start = Bench_Now();
+		vListRemove(&(pxTop->xGenericListItem));
+		taskRESET_READY_PRIORITY(pxTop->uxPriority);
+		vTaskSwitchContext();
+		benchSamples[BS_SWITCH_BLOCK][i] = Bench_Now() - start;
+
+		start = Bench_Now();
+		prvAddTaskToReadyQueue(pxTop);
+		vTaskSwitchContext();
+		benchSamples[BS_SWITCH_WAKE][i] = Bench_Now() - start;
+	}
+
+	overhead = Bench_Median(BS_EMPTY);
+	printf("%2u priorities  %-9s  block %4lld  wake %4lld  vTaskSwitchContext block %4lld  wake %4lld  %s\n",
+		(unsigned)configMAX_PRIORITIES,
+		configUSE_OPTIMISED_TASK_SELECTION ? "bitmap" : "linear",
+		Bench_Median(BS_BLOCK) - overhead, Bench_Median(BS_WAKE) - overhead,
+		Bench_Median(BS_SWITCH_BLOCK) - overhead, Bench_Median(BS_SWITCH_WAKE) - overhead,
+		BENCH_UNIT);
+	return 0;
+}
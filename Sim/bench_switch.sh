@@ -0,0 +1,23 @@
+#!/bin/sh
+# Context switch cost benchmark: builds Sim/bench_switch.c for each priority
+# count with the linear ready list search and, up to 8 priorities, with the
+# ready priority bitmap (configUSE_OPTIMISED_TASK_SELECTION), and prints the
+# median cost of each. See bench_switch.c for what is measured.
+# Usage: Sim/bench_switch.sh [PRIORITY COUNTS]   (default 2 4 8 16 32)
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_switch.c queue.c list.c croutine.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+for priorities in ${*:-2 4 8 16 32}; do
+	for optimised in 0 1; do
+		[ $optimised = 1 ] && [ $priorities -gt 8 ] && continue
+		gcc $CFLAGS -DconfigMAX_PRIORITIES=$priorities \
+			-DconfigUSE_OPTIMISED_TASK_SELECTION=$optimised \
+			-o Sim/build/bench_switch $SOURCES -lm
+		Sim/build/bench_switch
+	done
+done
@@ -0,0 +1,135 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// USART driver burst benchmark for the host simulation, built and run for
+// several baud rates by Sim/bench_usart.sh.
+// USART1 is looped back to itself through a FIFO, and the simulated UDR1 and
+// UCSR1A/B move its bytes at USART1_BAUD in virtual time. For each load a
+// writer task queues bursts of numbered bytes with USART_Put() and a reader
+// task drains them, woken by USART_WaitForData() or, for a slow reader, only
+// every few ticks. It prints per load:
+//   offered   bytes per second the bursts ask for, against the line's
+//             capacity at 10 bits per byte
+//   sent      bytes queued, and dropped by USART_Put() on a full TX buffer
+//   received  bytes read and bytes per second, and bytes dropped on a full
+//             RX buffer (USART_RxDropped); every byte queued must be either
+//             received, in order, or counted there, or the benchmark fails
+// Build with [-DUSART1_BAUD=n].
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "usart_isr_ATmega1284.h"
+#include "runtime_stats.h"
+#include "trace_recorder.h"
+
+#define BENCH_USART 1
+#define BENCH_TICKS 2000	// Length of each load
+#define BENCH_DRAIN 20		// Ticks for the last bytes to reach the reader
+
+typedef struct _BenchLoad
+{
+	unsigned short burst;		// Bytes per burst
+	unsigned short period;		// Ticks between bursts
+	unsigned short readEvery;	// Reader wakes every this many ticks, 0: on data
+} BenchLoad;
+
+static const BenchLoad benchLoads[] = {
+	{8, 10, 0},		// Well inside the buffers
+	{32, 10, 0},	// Each burst fills the TX buffer
+	{96, 50, 0},	// Bursts three TX buffers long
+	{255, 5, 0},	// Saturated
+	{24, 10, 25},	// Slow reader
+};
+#define BENCH_LOADS (sizeof(benchLoads) / sizeof(benchLoads[0]))
+
+static const BenchLoad* volatile benchLoad;
+static volatile unsigned long benchReceived;
+static volatile unsigned long benchDisordered;	// Bytes not following the last one read
+
+static void Bench_Reader(void* pvParameters)
+{
+	unsigned char data, last = 0xFF;
+
+	for(;;)
+	{
+		if (benchLoad && benchLoad->readEvery) {
+			vTaskDelay(benchLoad->readEvery);
+		} else {
+			USART_WaitForData(BENCH_USART, portMAX_DELAY);
+		}
+		while (USART_Read(BENCH_USART, &data)) {
+			if ((unsigned char)(data - last) == 0 || (unsigned char)(data - last) > 0x80) {
+				benchDisordered++; // Repeated or older: corrupted, not just lost
+			}
+			last = data;
+			benchReceived++;
+		}
+	}
+}
+
+static void Bench_Writer(void* pvParameters)
+{
+	const BenchLoad* load;
+	unsigned long queued, offered;
+	unsigned short txDropped, rxDropped, n;
+	portTickType start, wake, elapsed;
+	unsigned char seq = 0, i;
+
+	printf("USART1 at %lu baud, %u byte TX and %u byte RX buffers, line capacity %lu bytes/s\n",
+		(unsigned long)USART1_BAUD, USART1_TX_BUFFER_SIZE, USART1_RX_BUFFER_SIZE,
+		(unsigned long)USART1_BAUD / 10);
+	for (i = 0; i < BENCH_LOADS; i++) {
+		load = &benchLoads[i];
+		queued = 0;
+		txDropped = USART_TxDropped(BENCH_USART);
+		rxDropped = USART_RxDropped(BENCH_USART);
+		benchReceived = 0;
+		benchDisordered = 0;
+		benchLoad = load;
+		USART_WakeWaiter(BENCH_USART); // Picks up the reader's new pace
+		start = wake = xTaskGetTickCount();
+		while ((portTickType)(xTaskGetTickCount() - start) < BENCH_TICKS) {
+			for (n = 0; n < load->burst; n++) {
+				if (USART_Put(BENCH_USART, seq)) {
+					seq++;
+					queued++;
+				}
+			}
+			vTaskDelayUntil(&wake, load->period);
+		}
+		while (USART_TxFree(BENCH_USART) < USART1_TX_BUFFER_SIZE - 1) {
+			vTaskDelay(1);
+		}
+		elapsed = xTaskGetTickCount() - start;
+		vTaskDelay(BENCH_DRAIN);
+		if (load->readEvery) {
+			vTaskDelay(load->readEvery);
+		}
+		txDropped = USART_TxDropped(BENCH_USART) - txDropped;
+		rxDropped = USART_RxDropped(BENCH_USART) - rxDropped;
+		offered = (unsigned long)load->burst * 1000 / load->period;
+
+		printf("burst %3u every %2u ms, read %-9s offered %6lu B/s  sent %6lu dropped %6u  received %6lu at %6lu B/s, RX dropped %5u\n",
+			load->burst, load->period, load->readEvery ? "slowly" : "on data", offered,
+			queued, txDropped, benchReceived, benchReceived * 1000 / elapsed, rxDropped);
+		if (queued != benchReceived + rxDropped || benchDisordered) {
+			fprintf(stderr, "bench_usart: %lu bytes queued, %lu received, %u counted as dropped, %lu out of order\n",
+				queued, benchReceived, rxDropped, benchDisordered);
+			exit(1);
+		}
+	}
+	exit(0);
+}
+
+int main(void)
+{
+	USART_BufferedInit(BENCH_USART);
+	xTaskCreate(Bench_Writer, (signed portCHAR *)"Writer", configMINIMAL_STACK_SIZE, NULL, 2, NULL);
+	xTaskCreate(Bench_Reader, (signed portCHAR *)"Reader", configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+	vTaskStartScheduler();
+	return 1;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# USART driver burst benchmark: builds Sim/bench_usart.c for each baud rate
+# and runs it in virtual time with USART1 looped back through a FIFO. See
+# bench_usart.c for what is measured.
+# Usage: Sim/bench_usart.sh [BAUD RATES]   (default 9600 38400 250000)
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -O2 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+SOURCES="Sim/bench_usart.c tasks.c queue.c list.c croutine.c timers.c heap_1.c heap_pool.c $RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+SIM_DIR=${SIM_DIR:-/tmp/minivendi-sim}
+
+mkdir -p Sim/build "$SIM_DIR"
+[ -p "$SIM_DIR/loop1" ] || mkfifo "$SIM_DIR/loop1"
+for baud in ${*:-9600 38400 250000}; do
+	gcc $CFLAGS -DUSART1_BAUD=$baud -o Sim/build/bench_usart $SOURCES -lm
+	SIM_VIRTUAL=1 SIM_USART0_RX=/dev/null SIM_USART0_TX=/dev/null \
+		SIM_USART1_TX=$SIM_DIR/loop1 SIM_USART1_RX=$SIM_DIR/loop1 \
+		Sim/build/bench_usart 2>/dev/null
+done
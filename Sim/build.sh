@@ -0,0 +1,16 @@
+#!/bin/sh
+# Builds uC1 and uC2 as Linux programs for the host simulation (see sim.h).
+# Usage: Sim/build.sh [extra gcc flags, e.g. -O2 -g -pg]
+# Output: Sim/build/uC1 and Sim/build/uC2
+set -e
+cd "$(dirname "$0")/.."
+
+RTOS=FreeRTOS_Lab/FreeRTOS_Lab
+CFLAGS="-std=gnu99 -DPOSIX_SIM -ISim -I. -IIncludes -I$RTOS -I$RTOS/FreeRTOS/Source/include"
+KERNEL="tasks.c queue.c list.c croutine.c timers.c heap_1.c heap_pool.c"
+PORT="$RTOS/FreeRTOS/Source/portable/GCC/Posix_Sim/port.c Sim/sim_io.c"
+
+mkdir -p Sim/build
+for image in uC1 uC2; do
+	gcc $CFLAGS "$@" -o Sim/build/$image $image.c $KERNEL $PORT -lm
+done
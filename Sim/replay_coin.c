@@ -0,0 +1,111 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Coin pulse detector replay harness for the host, built and run by
+// Sim/replay_coin.sh.
+// It feeds ADC traces of the coin beam (Sim/traces/coin_*.txt) through the
+// detector in coin_detector.h in blocks of ADC_BLOCK_SIZE, as LEDS_Tick on
+// the first microcontroller does, and prints for each trace the coins
+// counted, when (ms into the trace) and the pulses rejected. A trace is whitespace separated samples, one channel at ADC_SAMPLE_RATE,
+// after '#' comment lines; the line "# coins N" gives the coins it holds,
+// and the harness fails if the detector counts any other number.
+// The traces in Sim/traces are synthetic, not captured from the boards;
+// Tools/coin_traces.py generates them again.
+// Build with [-DCD_ENTER_DROP=n -DCD_EXIT_DROP=n -DCD_MIN_WIDTH=n
+// -DCD_MAX_WIDTH=n] to try other tuning on the same traces.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coin_detector.h"
+
+#define REPLAY_BLOCK_SIZE 32		// ADC_BLOCK_SIZE (adc_ATmega1284.h)
+#define REPLAY_SAMPLE_RATE 4807UL	// ADC_SAMPLE_RATE, one channel
+#define REPLAY_MAX_SAMPLES 65536
+#define REPLAY_MAX_COINS 32
+
+static unsigned short replaySamples[REPLAY_MAX_SAMPLES];
+
+// Reads a trace; returns the sample count, or -1 if it cannot be read
+static long Replay_Load(const char* path, long* expected)
+{
+	FILE* f = fopen(path, "r");
+	char line[256];
+	long count = 0;
+	char* p;
+	char* end;
+	unsigned long value;
+
+	if (!f) {
+		return -1;
+	}
+	*expected = -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#') {
+			sscanf(line, "# coins %ld", expected);
+			continue;
+		}
+		for (p = line; ; p = end) {
+			value = strtoul(p, &end, 10);
+			if (end == p) {
+				break;
+			}
+			if (count < REPLAY_MAX_SAMPLES) {
+				replaySamples[count++] = value;
+			}
+		}
+	}
+	fclose(f);
+	return count;
+}
+
+int main(int argc, char** argv)
+{
+	CoinDetector cd;
+	unsigned long coinAt[REPLAY_MAX_COINS];
+	long count, expected, at;
+	unsigned short coins;
+	unsigned char block, i;
+	int failed = 0, t, n;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: replay_coin TRACE...\n");
+		return 2;
+	}
+	for (t = 1; t < argc; t++) {
+		count = Replay_Load(argv[t], &expected);
+		if (count <= 0) {
+			fprintf(stderr, "replay_coin: cannot read %s\n", argv[t]);
+			return 2;
+		}
+		// Beam is assumed unblocked at the start, as at power up
+		CoinDetector_Init(&cd, replaySamples[0]);
+		coins = 0;
+		for (at = 0; at < count; at += block) {
+			block = (count - at < REPLAY_BLOCK_SIZE) ? count - at : REPLAY_BLOCK_SIZE;
+			for (i = 0; i < block; i++) {
+				if (CoinDetector_Feed(&cd, replaySamples[at + i]) && coins < REPLAY_MAX_COINS) {
+					coinAt[coins++] = (at + i) * 1000 / REPLAY_SAMPLE_RATE;
+				}
+			}
+		}
+		printf("%-28s %6ld samples %5lu ms  coins %u", argv[t], count,
+			count * 1000 / REPLAY_SAMPLE_RATE, cd.coinCount);
+		if (expected >= 0) {
+			printf(" (expected %ld)", expected);
+		}
+		printf("  rejected %u  baseline %lu\n", cd.rejected, cd.baseline >> CD_BASELINE_SHIFT);
+		for (n = 0; n < coins; n++) {
+			printf("    coin at %5lu ms\n", coinAt[n]);
+		}
+		if (expected >= 0 && cd.coinCount != expected) {
+			failed = 1;
+		}
+	}
+	if (failed) {
+		fprintf(stderr, "replay_coin: coins counted differ from the traces\n");
+	}
+	return failed;
+}
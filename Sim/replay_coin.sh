@@ -0,0 +1,17 @@
+#!/bin/sh
+# Coin pulse detector replay: builds Sim/replay_coin.c and feeds it ADC
+# traces of the coin beam, by default the synthetic ones Tools/coin_traces.py
+# makes. See replay_coin.c for the trace format.
+# CFLAGS adds detector tuning, e.g. CFLAGS=-DCD_MIN_WIDTH=10.
+# Usage: Sim/replay_coin.sh [TRACE FILES]   (default Sim/traces/coin_*.txt)
+set -e
+[ $# -gt 0 ] && for trace in "$@"; do
+	set -- "$@" "$(cd "$(dirname "$trace")" && pwd)/$(basename "$trace")"
+	shift
+done
+cd "$(dirname "$0")/.."
+[ $# -gt 0 ] || set -- Sim/traces/coin_*.txt
+
+mkdir -p Sim/build
+gcc -std=gnu99 -O2 -Wall $CFLAGS -IIncludes -o Sim/build/replay_coin Sim/replay_coin.c
+Sim/build/replay_coin "$@"
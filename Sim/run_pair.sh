@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs both images with their USART1s connected through two FIFOs.
+# uC1's USART0 (the Bluetooth module) is this terminal: type 1 or 2 and
+# Enter to select a product, or a command line such as ORDER 1 2 2, STATUS
+# or PRICE 1 (see Includes/bt_command.h). Board events go to the control
+# FIFOs:
+#   echo c > $SIM_DIR/uC1.ctrl    insert a coin
+#   echo 2 > $SIM_DIR/uC1.ctrl    press keypad key 2
+# uC2's USART0 output is written to $SIM_DIR/uC2.usart0, and uC1's debug
+# shift register outputs, one byte per latch, to $SIM_DIR/uC1.shiftreg.
+# Usage: Sim/run_pair.sh [SIM_TICK_US]   (default 1000; 10 is 100x speed)
+set -e
+cd "$(dirname "$0")"
+[ -x build/uC1 ] && [ -x build/uC2 ] || ./build.sh -O2
+
+SIM_DIR=${SIM_DIR:-/tmp/minivendi-sim}
+mkdir -p "$SIM_DIR"
+for fifo in link12 link21 uC1.ctrl uC2.ctrl; do
+	[ -p "$SIM_DIR/$fifo" ] || mkfifo "$SIM_DIR/$fifo"
+done
+export SIM_TICK_US=${1:-1000}
+
+SIM_USART1_TX=$SIM_DIR/link21 SIM_USART1_RX=$SIM_DIR/link12 \
+	SIM_USART0_RX=/dev/null SIM_USART0_TX=$SIM_DIR/uC2.usart0 \
+	SIM_CTRL=$SIM_DIR/uC2.ctrl SIM_EEPROM=$SIM_DIR/uC2.eeprom \
+	build/uC2 &
+uc2=$!
+trap 'kill $uc2 2>/dev/null' EXIT INT TERM
+
+echo "uC2 running (pid $uc2), events: $SIM_DIR/uC1.ctrl" >&2
+SIM_USART1_TX=$SIM_DIR/link12 SIM_USART1_RX=$SIM_DIR/link21 \
+	SIM_CTRL=$SIM_DIR/uC1.ctrl SIM_EEPROM=$SIM_DIR/uC1.eeprom \
+	SIM_SHIFTREG=$SIM_DIR/uC1.shiftreg build/uC1
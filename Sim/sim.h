@@ -0,0 +1,133 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Simulated ATmega1284P board for running uC1.c/uC2.c on Linux.
+// sim_io.c emulates the peripherals the firmware uses; the FreeRTOS
+// Posix_Sim port calls Sim_PeripheralTick() from every tick, before the
+// kernel tick, so emulated interrupts are raised at most 1 ms late.
+//
+// Environment (all optional):
+//   SIM_TICK_US       Host microseconds per 1 ms tick (default 1000;
+//                     10 runs at 100x real time)
+//   SIM_USARTn_RX/_TX Files or FIFOs connected to USART n. USART0 defaults
+//                     to stdin/stdout, USART1 to nothing
+//   SIM_CTRL          File or FIFO of board events: 'c' drops a coin through
+//                     the IR beam (ADC0 dip), a keypad character (0-9 A-D *
+//                     #) presses that key for SIM_KEY_TICKS
+//   SIM_JAM           Every this many items on each spiral sticks for
+//                     SIM_JAM_STEPS more steps before it drops (default 0:
+//                     none do)
+//   SIM_SHIFTREG      File the 74HC595 chain on the SPI writes its outputs
+//                     to on every latch, register 0 first
+//   SIM_EEPROM        File holding the 4 KB EEPROM image across runs.
+//                     Writes per cell are counted and summed up on exit
+//
+// Virtual time (SIM_VIRTUAL=1): there is no timer. Whenever only the idle
+// task could run, the port jumps to the tick before the next task wakes or
+// the next peripheral event (Sim_SkipTicks()) and runs that tick at once,
+// so simulated time goes as fast as the host can execute the firmware.
+// Busy waits on Timer3 advance time by 1 us per read; nothing else the
+// firmware does takes simulated time. Two images are kept in lockstep (never
+// more than one tick apart, so link bytes cannot arrive from the future)
+// through a shared clock file:
+//   SIM_VCLOCK        File both images map; delete it before a new run
+//   SIM_VCLOCK_ID     0 or 1, different for the two images
+//   SIM_VENDS         Run this many vend cycles of SIM_WORKLOAD as board
+//                     events, then print the vend statistics and stop both
+//   SIM_WORKLOAD      SIM_CTRL events per vend cycle (default "c1"); the
+//                     next cycle starts once every selection (1 or 2) in
+//                     it has been answered, or after SIM_VEND_TIMEOUT
+// Sim/bench_pair.sh sets all of these up for the two images.
+// Each image prints the CPU time used by each of its tasks on exit, in
+// simulated time (host time unless SIM_VIRTUAL is set).
+
+#ifndef SIM_H
+#define SIM_H
+
+#define SIM_F_CPU 8000000UL
+
+#define SIM_ADC_IDLE 800		// ADC0/1 with the IR beam unblocked
+#define SIM_ADC_COIN 300		// ADC0 while a coin blocks the beam
+#define SIM_COIN_SAMPLES 48		// Coin pulse width, ~10 ms at 4.8 kHz
+#define SIM_ADC_ITEM 300		// ADC0/1 while a dropping item blocks the beam
+#define SIM_DROP_SAMPLES 48		// Drop pulse width in samples of its channel
+#define SIM_MOTORS 2			// Spirals on PORTB, drop beams on ADC0 and ADC1
+#define SIM_ITEM_PITCH 2048		// Steps between items in a spiral (one turn)
+#define SIM_ITEM_SLACK 512		// An item may fall up to this many steps early
+#define SIM_JAM_STEPS 3072		// Extra steps a SIM_JAM item needs to drop
+#define SIM_KEY_TICKS 50		// How long a keypad key is held
+#define SIM_EVENT_GAP 50		// Ticks between SIM_CTRL events
+#define SIM_VEND_TIMEOUT 60000	// Ticks before a workload vend counts as lost
+#define SIM_SHIFT_CHAIN 8		// 74HC595s on the SPI, at most
+
+// Vend milestones reported by the firmware through SIM_PROBE() (sim_probe.h)
+enum SimProbe {
+	SIM_PROBE_CREDIT,		// uC2 credited a coin
+	SIM_PROBE_DISPENSE,		// uC2 queued the stepper move for a selection
+	SIM_PROBE_READY,		// uC1 reported a completed vend
+	SIM_PROBE_REFUSED,		// uC1 reported a selection refused (funds, busy)
+	SIM_PROBE_FAILED		// uC1 reported a dispense that jammed (refunded)
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Opens the files named in the environment; called by the
+//				  port when the scheduler starts
+//Parameter: None
+//Returns: None
+void Sim_Init(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Host time per tick, from SIM_TICK_US
+//Parameter: None
+//Returns: Microseconds
+unsigned long Sim_TickPeriodUs(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Advances the peripherals by one tick and runs the ISRs
+//				  they raise. Called from the tick signal handler
+//Parameter: None
+//Returns: None
+void Sim_PeripheralTick(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Simulated time since Sim_Init()
+//Parameter: None
+//Returns: Microseconds
+unsigned long Sim_Micros(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sim_Micros() without the 1 us a read costs in virtual time,
+//				  for the port's CPU accounting
+//Parameter: None
+//Returns: Microseconds
+unsigned long Sim_Now(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Virtual time: moves time on by up to most ticks in which no
+//				  peripheral would raise an interrupt or have I/O to do, so
+//				  the port need not run them one by one
+//Parameter: most is the number of ticks the kernel can skip
+//Returns: Ticks skipped, 0 to most
+unsigned long Sim_SkipTicks(unsigned long most);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Tells the port whether ticks come from the timer or from
+//				  the scheduler running out of work (SIM_VIRTUAL)
+//Parameter: None
+//Returns: 1 in virtual time else 0
+unsigned char Sim_Virtual(void);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records a vend milestone for the stage latency statistics
+//Parameter: event is a SimProbe value
+//Returns: None
+void Sim_Probe(unsigned char event);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Counts the writes to one EEPROM cell since the program
+//				  started, to measure wear
+//Parameter: address is the EEPROM offset (0..E2END)
+//Returns: Byte writes that reached the cell
+unsigned long Sim_EepromWrites(unsigned short address);
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Prints the CPU time and switch count per task to fd;
+//				  provided by the Posix_Sim port
+//Parameter: fd is the file descriptor to write to
+//Returns: None
+void vPortSimReportTasks(int fd);
+
+#endif //SIM_H
@@ -0,0 +1,1045 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Peripheral emulation, virtual clock and vend statistics for the Linux
+// host simulation (see sim.h). The peripherals are stepped from the tick
+// signal handler, so they only use non-blocking read()/write() for I/O.
+
+#define _GNU_SOURCE // program_invocation_short_name
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+
+#define SIM_DEFINE_REGISTER(name) volatile unsigned char name;
+#define SIM_DEFINE_REGISTER16(name) volatile unsigned short name;
+SIM_REGISTERS(SIM_DEFINE_REGISTER)
+SIM_REGISTERS16(SIM_DEFINE_REGISTER16)
+volatile unsigned short UDR0 = SIM_UDR_EMPTY;
+volatile unsigned short UDR1 = SIM_UDR_EMPTY;
+volatile unsigned short SPDR = SIM_SPDR_EMPTY;
+
+// ISRs the firmware may define; unlinked ones are NULL
+#define SIM_VECTORS(X) \
+	X(USART0_RX_vect) X(USART0_UDRE_vect) X(USART1_RX_vect) X(USART1_UDRE_vect) \
+	X(ADC_vect) X(TIMER3_OVF_vect) X(TIMER3_COMPA_vect) X(TIMER3_COMPB_vect) \
+	X(PCINT2_vect) X(SPI_STC_vect)
+#define SIM_DECLARE_VECTOR(vector) void vector(void) __attribute__((weak));
+SIM_VECTORS(SIM_DECLARE_VECTOR)
+
+// A byte is 10 bits on the line; USART credit is in bits per 1000 ticks
+#define SIM_BYTE_COST 10000UL
+
+typedef struct _SimUsart
+{
+	volatile unsigned char* ucsra;
+	volatile unsigned char* ucsrb;
+	volatile unsigned char* ubrrh;
+	volatile unsigned char* ubrrl;
+	volatile unsigned short* udr;
+	void (*rxVector)(void);
+	void (*udreVector)(void);
+	int rxFd;					// -1: nothing is ever received
+	int txFd;					// -1: sent bytes are discarded
+	unsigned long credit;		// Line time available this tick
+} SimUsart;
+
+static SimUsart simUsarts[2] = {
+	{&UCSR0A, &UCSR0B, &UBRR0H, &UBRR0L, &UDR0, USART0_RX_vect, USART0_UDRE_vect, -1, -1, 0},
+	{&UCSR1A, &UCSR1B, &UBRR1H, &UBRR1L, &UDR1, USART1_RX_vect, USART1_UDRE_vect, -1, -1, 0}
+};
+
+static unsigned long simTickUs = 0;			// 0 until Sim_Clock() first runs
+static unsigned char simVirtual = 0;		// SIM_VIRTUAL: no timer, see sim.h
+static unsigned char simTicking = 0;		// The scheduler has started
+static unsigned long simTicks = 0;			// Ticks of simulated time
+static unsigned long simSubTick = 0;		// Virtual time: us into this tick
+static struct timespec simLastTick;			// Host time of the last tick
+static struct timespec simHostStart;		// Host time at Sim_Init()
+static unsigned long simAdcCredit = 0;		// Samples due, in thousandths
+static unsigned short simCoinSamples = 0;	// Left in the current coin pulse
+static unsigned char simAdcMux = 0;			// Channel of the conversion running
+static unsigned char simKey = '\0';			// Keypad key held down
+static unsigned short simKeyTicks = 0;
+static unsigned short simEventGap = 0;		// Ticks until the next SIM_CTRL event
+static int simCtrlFd = -1;
+static unsigned long simSpiCredit = 0;		// Bytes due, in thousandths
+static unsigned char simShift[SIM_SHIFT_CHAIN];	// 74HC595 chain, register 0 first
+static unsigned char simShiftCount = 0;		// Bytes shifted since the last latch
+static int simShiftFd = -1;					// SIM_SHIFTREG
+
+static const char simKeypad[] = "123A456B789C*0#D"; // Row major, see keypad.h
+
+// Vending spirals turned by the stepper nibbles of PORTB (motor 0 on PB4-PB7,
+// motor 1 on PB0-PB3, see stepper.h), each with an IR drop beam, on ADC0 and
+// ADC1. A step is a change of the motor's coil pattern
+typedef struct _SimMotor
+{
+	unsigned long steps;		// Steps turned so far
+	unsigned long dropAt;		// Step at which the front item falls
+	unsigned long items;		// Items dropped
+	unsigned short dropSamples;	// Left in the current drop pulse
+} SimMotor;
+
+static SimMotor simMotors[SIM_MOTORS];
+static unsigned long simJamEvery = 0;		// SIM_JAM
+static unsigned int simItemSeed = 1;
+
+// Places the next item to fall from a spiral: a pitch on, less up to
+// SIM_ITEM_SLACK steps as items sit unevenly; every SIM_JAM-th item sticks
+// for SIM_JAM_STEPS more
+static void Sim_NextItem(SimMotor* m)
+{
+	m->dropAt = m->steps + SIM_ITEM_PITCH - rand_r(&simItemSeed) % (SIM_ITEM_SLACK + 1);
+	if (simJamEvery && (m->items + 1) % simJamEvery == 0) {
+		m->dropAt += SIM_JAM_STEPS;
+	}
+}
+
+// Vend stages timed from a board event or probe to the next probe
+enum SimStageId {SIM_STAGE_COIN, SIM_STAGE_SELECT, SIM_STAGE_READY, SIM_STAGES};
+static const char* const simStageNames[SIM_STAGES] = {
+	"coin to credit", "select to dispense", "dispense to ready"
+};
+#define SIM_STAGE_DEPTH 16	// Vends that may be in one stage at once
+#define SIM_BUCKETS 18		// Bucket 0: 0 ms, bucket n: 2^(n-1) to 2^n - 1 ms
+
+typedef struct _SimStage
+{
+	unsigned long start[SIM_STAGE_DEPTH];	// Start ticks, oldest at tail
+	unsigned char head;
+	unsigned char tail;
+	unsigned long count;
+	unsigned long total;
+	unsigned long min;
+	unsigned long max;
+	unsigned long buckets[SIM_BUCKETS];
+} SimStage;
+
+// State shared by both images through SIM_VCLOCK (else private)
+#define SIM_PEERS 2
+typedef struct _SimShared
+{
+	volatile unsigned long ticks[SIM_PEERS];	// Ticks each image has started
+	volatile int pid[SIM_PEERS];
+	volatile unsigned char quit;				// Set to stop both images
+	volatile int lock;							// Guards the rest
+	SimStage stages[SIM_STAGES];
+	volatile unsigned long vends;
+	volatile unsigned long refused;
+	volatile unsigned long failed;
+	volatile unsigned long lost;
+} SimShared;
+
+static SimShared simLocal;
+static SimShared* simShared = &simLocal;
+static unsigned char simPaired = 0;			// SIM_VCLOCK is set
+static unsigned char simPeerId = 0;			// SIM_VCLOCK_ID
+
+// SIM_VENDS workload
+static unsigned long simVendsWanted = 0;	// 0: no workload
+static unsigned long simCyclesStarted = 0;
+static const char* simWorkload = "c1";
+static const char* simWorkloadNext = "";	// Next event of this cycle
+static unsigned long simCycleStart = 0;		// Tick the current cycle began
+static unsigned long simCycleDone = 0;		// Results that end the current cycle
+
+static int Sim_Open(const char* name, int flags, int fallback)
+{
+	const char* path = getenv(name);
+	int fd;
+
+	if (!path || !*path) {
+		return fallback;
+	}
+	// O_RDWR keeps a FIFO open without waiting for (or needing) the far end
+	fd = open(path, O_RDWR | O_NONBLOCK | flags, 0644);
+	if (fd < 0) {
+		dprintf(2, "sim: cannot open %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	return fd;
+}
+
+// Maps the lockstep clock and statistics shared with the other image
+static void Sim_MapShared(void)
+{
+	const char* id = getenv("SIM_VCLOCK_ID");
+	int fd = Sim_Open("SIM_VCLOCK", O_CREAT, -1);
+	void* map;
+
+	if (fd < 0) {
+		return;
+	}
+	simPeerId = id ? atoi(id) % SIM_PEERS : 0;
+	if (ftruncate(fd, sizeof(SimShared)) < 0
+		|| (map = mmap(NULL, sizeof(SimShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		dprintf(2, "sim: cannot map SIM_VCLOCK: %s\n", strerror(errno));
+		exit(1);
+	}
+	close(fd);
+	simShared = map;
+	simShared->pid[simPeerId] = getpid();
+	simPaired = 1;
+}
+
+static void Sim_Lock(sigset_t* saved)
+{
+	sigset_t tick;
+
+	// A task holding the lock must not be interrupted by a tick that takes it
+	sigemptyset(&tick);
+	sigaddset(&tick, SIGALRM);
+	sigprocmask(SIG_BLOCK, &tick, saved);
+	while (__sync_lock_test_and_set(&simShared->lock, 1)) {
+		sched_yield();
+	}
+}
+
+static void Sim_Unlock(const sigset_t* saved)
+{
+	__sync_lock_release(&simShared->lock);
+	sigprocmask(SIG_SETMASK, saved, NULL);
+}
+
+static void Sim_StageStart(unsigned char stage)
+{
+	SimStage* s = &simShared->stages[stage];
+	s->start[s->head++ % SIM_STAGE_DEPTH] = simTicks;
+}
+
+// Ends the oldest vend in a stage; record = 0 drops it from the statistics
+static void Sim_StageEnd(unsigned char stage, unsigned char record)
+{
+	SimStage* s = &simShared->stages[stage];
+	unsigned long ms;
+	unsigned char bucket = 0;
+
+	if (s->head == s->tail) {
+		return; // Not started by a simulated event (e.g. typed on USART0)
+	}
+	ms = simTicks - s->start[s->tail++ % SIM_STAGE_DEPTH];
+	if (!record) {
+		return;
+	}
+	if (!s->count || ms < s->min) {
+		s->min = ms;
+	}
+	if (ms > s->max) {
+		s->max = ms;
+	}
+	s->count++;
+	s->total += ms;
+	while (bucket < SIM_BUCKETS - 1 && (ms >> bucket)) {
+		bucket++;
+	}
+	s->buckets[bucket]++;
+}
+
+void Sim_Probe(unsigned char event)
+{
+	sigset_t saved;
+
+	Sim_Lock(&saved);
+	switch (event) {
+		case SIM_PROBE_CREDIT:
+			Sim_StageEnd(SIM_STAGE_COIN, 1);
+			break;
+		case SIM_PROBE_DISPENSE:
+			Sim_StageEnd(SIM_STAGE_SELECT, 1);
+			Sim_StageStart(SIM_STAGE_READY);
+			break;
+		case SIM_PROBE_READY:
+			Sim_StageEnd(SIM_STAGE_READY, 1);
+			simShared->vends++;
+			break;
+		case SIM_PROBE_REFUSED:
+			Sim_StageEnd(SIM_STAGE_SELECT, 0);
+			simShared->refused++;
+			break;
+		case SIM_PROBE_FAILED:
+			Sim_StageEnd(SIM_STAGE_READY, 0);
+			simShared->failed++;
+			break;
+		default:
+			break;
+	}
+	Sim_Unlock(&saved);
+}
+
+static void Sim_Report(void)
+{
+	struct timespec now;
+	double host, simulated;
+	unsigned char i, b;
+	SimStage* s;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	host = (now.tv_sec - simHostStart.tv_sec) + (now.tv_nsec - simHostStart.tv_nsec) / 1e9;
+	simulated = simTicks / 1000.0;
+	dprintf(2, "sim: %lu vends, %lu refused, %lu failed, %lu lost in %.1f s simulated, %.1f s host (%.0fx)\n",
+		simShared->vends, simShared->refused, simShared->failed, simShared->lost, simulated, host,
+		host > 0 ? simulated / host : 0);
+	if (simulated > 0 && host > 0) {
+		dprintf(2, "sim: %.0f vends/hour simulated, %.0f vends/hour host\n",
+			simShared->vends * 3600 / simulated, simShared->vends * 3600 / host);
+	}
+	for (i = 0; i < SIM_STAGES; i++) {
+		s = &simShared->stages[i];
+		if (!s->count) {
+			continue;
+		}
+		dprintf(2, "sim: %-18s n=%lu min=%lu avg=%lu max=%lu ms\n", simStageNames[i],
+			s->count, s->min, s->total / s->count, s->max);
+		for (b = 0; b < SIM_BUCKETS; b++) {
+			if (s->buckets[b]) {
+				dprintf(2, "sim:   %6lu - %6lu ms %8lu\n", b ? 1UL << (b - 1) : 0,
+					b ? (1UL << b) - 1 : 0, s->buckets[b]);
+			}
+		}
+	}
+}
+
+static void Sim_EepromReport(void);
+
+static void Sim_AtExit(void)
+{
+	if (simVendsWanted) {
+		Sim_Report();
+	}
+	Sim_EepromReport();
+	dprintf(2, "sim: %s task CPU (%s time)\n", program_invocation_short_name,
+		simVirtual ? "virtual" : "host");
+	vPortSimReportTasks(2);
+}
+
+// Stops this image and, through SIM_VCLOCK, the other one
+static void Sim_Quit(void)
+{
+	simShared->quit = 1;
+	exit(0);
+}
+
+static void Sim_QuitSignal(int signal)
+{
+	(void)signal;
+	Sim_Quit();
+}
+
+// Sets up the time base on first use, which may be before Sim_Init()
+static void Sim_Clock(void)
+{
+	const char* tick;
+
+	if (simTickUs) {
+		return;
+	}
+	tick = getenv("SIM_TICK_US");
+	simTickUs = (tick && atol(tick) > 0) ? atol(tick) : 1000;
+	simVirtual = getenv("SIM_VIRTUAL") && atoi(getenv("SIM_VIRTUAL"));
+	clock_gettime(CLOCK_MONOTONIC, &simLastTick);
+}
+
+void Sim_Init(void)
+{
+	const char* vends = getenv("SIM_VENDS");
+	const char* workload = getenv("SIM_WORKLOAD");
+	const char* jam = getenv("SIM_JAM");
+	unsigned char i;
+
+	simUsarts[0].rxFd = Sim_Open("SIM_USART0_RX", 0, STDIN_FILENO);
+	simUsarts[0].txFd = Sim_Open("SIM_USART0_TX", O_CREAT | O_TRUNC, STDOUT_FILENO);
+	simUsarts[1].rxFd = Sim_Open("SIM_USART1_RX", 0, -1);
+	simUsarts[1].txFd = Sim_Open("SIM_USART1_TX", O_CREAT | O_TRUNC, -1);
+	if (simUsarts[0].rxFd == STDIN_FILENO) {
+		fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+	}
+	simCtrlFd = Sim_Open("SIM_CTRL", 0, -1);
+	simShiftFd = Sim_Open("SIM_SHIFTREG", O_CREAT | O_TRUNC, -1);
+	if (vends && atol(vends) > 0) {
+		simVendsWanted = atol(vends);
+		simEventGap = 10 * SIM_EVENT_GAP; // Let both images finish starting
+	}
+	if (workload && *workload) {
+		simWorkload = workload;
+	}
+	if (jam && atol(jam) > 0) {
+		simJamEvery = atol(jam);
+	}
+	for (i = 0; i < SIM_MOTORS; i++) {
+		Sim_NextItem(&simMotors[i]);
+	}
+
+	UCSR0A |= (1 << UDRE0);
+	UCSR1A |= (1 << UDRE1);
+	SREG |= 0x80; // Tasks start with interrupts enabled
+
+	// From here on time advances with the ticks. In real time, start on
+	// the next whole millisecond after the busy waits main() made; in
+	// virtual time both images start together at 0
+	Sim_Clock();
+	if (simVirtual) {
+		simTicks = 0;
+		simSubTick = 0;
+		Sim_MapShared();
+	} else {
+		simTicks = Sim_Micros() / 1000 + 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &simLastTick);
+	simHostStart = simLastTick;
+	simTicking = 1;
+
+	signal(SIGINT, Sim_QuitSignal);
+	signal(SIGTERM, Sim_QuitSignal);
+	atexit(Sim_AtExit);
+}
+
+unsigned char Sim_Virtual(void)
+{
+	Sim_Clock();
+	return simVirtual;
+}
+
+unsigned long Sim_TickPeriodUs(void)
+{
+	Sim_Clock();
+	return simTickUs;
+}
+
+unsigned long Sim_Micros(void)
+{
+	struct timespec now;
+	unsigned long partial;
+
+	Sim_Clock();
+	if (simVirtual) {
+		// Only busy waits read the time: each read costs 1 us, and running
+		// past the end of the tick raises it (held pending while masked).
+		// Reads with the I bit clear (e.g. timestamps taken under cli())
+		// leave it for the first read after sei(), as the tick handler
+		// counts every signal as a tick and would run them all at once
+		if (++simSubTick >= 1000 && simTicking && (SREG & 0x80)) {
+			raise(SIGALRM);
+		}
+		return simTicks * 1000 + simSubTick;
+	}
+
+	// Host time since the last tick, scaled to simulated time and, once
+	// ticks run, held short of the next tick so time never runs backwards
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	partial = ((now.tv_sec - simLastTick.tv_sec) * 1000000000UL
+			+ now.tv_nsec - simLastTick.tv_nsec) / simTickUs;
+	if (simTicking && partial > 999) {
+		partial = 999;
+	}
+	return simTicks * 1000 + partial;
+}
+
+unsigned long Sim_Now(void)
+{
+	if (simVirtual) {
+		return simTicks * 1000 + ((simSubTick < 1000) ? simSubTick : 999);
+	}
+	return Sim_Micros();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Registers with side effects
+
+volatile unsigned char* simReadPin(unsigned char port)
+{
+	static volatile unsigned char pins[4];
+	static volatile unsigned char* const ports[4] = {&PORTA, &PORTB, &PORTC, &PORTD};
+	unsigned char value = *ports[port & 3]; // Outputs and pulled-up inputs
+	unsigned char key;
+
+	// Keypad on port C: a held key connects its column (Px4-7) to its row
+	// (Px0-3), so a row reads low while its column is driven low
+	if (port == 2 && simKeyTicks) {
+		key = strchr(simKeypad, simKey) - simKeypad;
+		if (!(value & (1 << (4 + (key & 3))))) {
+			value &= ~(1 << (key >> 2));
+		}
+	}
+	pins[port & 3] = value;
+	return &pins[port & 3];
+}
+
+static unsigned long simTimer3Counts;		// TCNT3 as of the last read, unwrapped
+static unsigned char simTimer3Held = 0;		// TCNT3 reads return simTimer3Match,
+											// 1 us on per read like busy waits
+static unsigned short simTimer3Match;
+
+volatile unsigned short* simTimer3(void)
+{
+	static volatile unsigned short count;
+	static unsigned long lastWraps;
+	static const unsigned short prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+	unsigned char cs = TCCR3B & 0x07;
+	unsigned long counts;
+
+	if (simTimer3Held) {
+		count = simTimer3Match++;
+		return &count;
+	}
+	if (prescale[cs]) {
+		counts = Sim_Micros() * (SIM_F_CPU / 1000000UL) / prescale[cs];
+		simTimer3Counts = counts;
+		count = counts;
+		if ((counts >> 16) != lastWraps) {
+			lastWraps = counts >> 16;
+			TIFR3 |= (1 << TOV3); // Cleared by the overflow vector
+		}
+	}
+	return &count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Peripherals, advanced once per tick
+
+// Line time a USART gains per tick, in bits per 1000 ticks
+static unsigned long Sim_UsartRate(const SimUsart* u)
+{
+	unsigned short ubrr = ((*u->ubrrh << 8) | *u->ubrrl) & 0x0FFF;
+	unsigned char div = (*u->ucsra & (1 << U2X0)) ? 8 : 16;
+
+	return SIM_F_CPU / (div * (ubrr + 1UL));
+}
+
+static void Sim_UsartTick(SimUsart* u)
+{
+	unsigned short held;
+	unsigned char busy, data;
+	ssize_t n;
+
+	u->credit += Sim_UsartRate(u);
+	while (u->credit >= SIM_BYTE_COST) {
+		busy = 0;
+		n = -1;
+		// Shift out the byte the UDRE ISR loaded, then let it load the next
+		if (*u->udr != SIM_UDR_EMPTY) {
+			data = *u->udr;
+			*u->udr = SIM_UDR_EMPTY;
+			if (u->txFd >= 0) {
+				write(u->txFd, &data, 1);
+			}
+			busy = 1;
+		}
+		if ((*u->ucsrb & (1 << UDRIE0)) && (*u->ucsrb & (1 << TXEN0)) && u->udreVector) {
+			u->udreVector();
+		}
+		if ((*u->ucsrb & (1 << RXCIE0)) && (*u->ucsrb & (1 << RXEN0)) && u->rxVector
+			&& u->rxFd >= 0 && (n = read(u->rxFd, &data, 1)) == 1) {
+			held = *u->udr; // UDR is one address for both directions
+			*u->udr = data;
+			u->rxVector();
+			*u->udr = held;
+			busy = 1;
+		}
+		if (n == 0) {
+			u->rxFd = -1; // End of file: stop polling it
+		}
+		if (!busy) {
+			u->credit = SIM_BYTE_COST; // An idle line banks at most one byte
+			break;
+		}
+		u->credit -= SIM_BYTE_COST;
+	}
+}
+
+// Turns the spirals by the steps between two PORTB values
+static void Sim_MotorSteps(unsigned char before, unsigned char after)
+{
+	static const unsigned char shift[SIM_MOTORS] = {4, 0};
+	unsigned char i, coils;
+	SimMotor* m;
+
+	for (i = 0; i < SIM_MOTORS; i++) {
+		m = &simMotors[i];
+		coils = (after >> shift[i]) & 0x0F;
+		if (!coils || coils == ((before >> shift[i]) & 0x0F)) {
+			continue; // Off or holding
+		}
+		if (++m->steps == m->dropAt) {
+			m->dropSamples = SIM_DROP_SAMPLES;
+			m->items++;
+			Sim_NextItem(m);
+		}
+	}
+}
+
+static unsigned short Sim_AdcSample(unsigned char channel)
+{
+	if (channel == 0 && simCoinSamples) {
+		simCoinSamples--;
+		return SIM_ADC_COIN;
+	}
+	if (channel < SIM_MOTORS && simMotors[channel].dropSamples) {
+		simMotors[channel].dropSamples--;
+		return SIM_ADC_ITEM;
+	}
+	return SIM_ADC_IDLE;
+}
+
+static void Sim_AdcTick(void)
+{
+	static const unsigned char prescale[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+
+	if (!(ADCSRA & (1 << ADEN))) {
+		return;
+	}
+	if (!(ADCSRA & (1 << ADATE))) {
+		// Single conversion: done within the tick it was started in
+		if (ADCSRA & (1 << ADSC)) {
+			ADC = Sim_AdcSample(ADMUX & 0x1F);
+			ADCSRA = (ADCSRA & ~(1 << ADSC)) | (1 << ADIF);
+			if ((ADCSRA & (1 << ADIE)) && ADC_vect) {
+				ADC_vect();
+			}
+		}
+		return;
+	}
+	// Free running: 13 ADC clocks per conversion
+	simAdcCredit += SIM_F_CPU / prescale[ADCSRA & 0x07] / 13;
+	while (simAdcCredit >= 1000) {
+		simAdcCredit -= 1000;
+		ADC = Sim_AdcSample(simAdcMux);
+		simAdcMux = ADMUX & 0x1F; // The next conversion starts before the ISR
+		if ((ADCSRA & (1 << ADIE)) && ADC_vect) {
+			ADC_vect();
+		} else {
+			ADCSRA |= (1 << ADIF);
+		}
+	}
+}
+
+// Next SIM_WORKLOAD event, or 0 while the cycle's vends are outstanding
+static char Sim_WorkloadEvent(void)
+{
+	unsigned long done = simShared->vends + simShared->refused + simShared->failed + simShared->lost;
+	const char* c;
+	sigset_t saved;
+	unsigned char i;
+
+	if (*simWorkloadNext) {
+		return *simWorkloadNext++;
+	}
+	if (done < simCycleDone) {
+		if (simTicks - simCycleStart > SIM_VEND_TIMEOUT) {
+			// Give up on these vends and forget their partial stage timings
+			Sim_Lock(&saved);
+			simShared->lost += simCycleDone - done;
+			for (i = 0; i < SIM_STAGES; i++) {
+				simShared->stages[i].tail = simShared->stages[i].head;
+			}
+			Sim_Unlock(&saved);
+		}
+		return 0;
+	}
+	if (simCyclesStarted == simVendsWanted) {
+		Sim_Quit();
+	}
+	simCyclesStarted++;
+	simCycleStart = simTicks;
+	simCycleDone = done;
+	for (c = simWorkload; *c; c++) {
+		if (*c == '1' || *c == '2') {
+			simCycleDone++; // Each selection is answered with one result
+		}
+	}
+	simWorkloadNext = simWorkload;
+	return *simWorkloadNext++;
+}
+
+static void Sim_ControlTick(void)
+{
+	sigset_t saved;
+	char c = 0;
+
+	if (simKeyTicks) {
+		simKeyTicks--;
+	}
+	if (simEventGap) {
+		simEventGap--;
+		return;
+	}
+	if ((simCtrlFd < 0 || read(simCtrlFd, &c, 1) != 1) && simVendsWanted) {
+		c = Sim_WorkloadEvent();
+	}
+	if (c == 'c') {
+		simCoinSamples = SIM_COIN_SAMPLES;
+		simEventGap = SIM_EVENT_GAP;
+		Sim_Lock(&saved);
+		Sim_StageStart(SIM_STAGE_COIN);
+		Sim_Unlock(&saved);
+	} else if (c && strchr(simKeypad, c)) {
+		simKey = c;
+		simKeyTicks = SIM_KEY_TICKS;
+		simEventGap = SIM_KEY_TICKS + SIM_EVENT_GAP;
+		if (c == '1' || c == '2') { // uC1's product selections
+			Sim_Lock(&saved);
+			Sim_StageStart(SIM_STAGE_SELECT);
+			Sim_Unlock(&saved);
+		}
+	}
+}
+
+// Virtual time: waits until the other image has started this tick too
+static void Sim_Barrier(void)
+{
+	unsigned char peer = simPeerId ^ 1;
+	unsigned long spins = 0;
+
+	while (simShared->ticks[peer] < simTicks && !simShared->quit) {
+		if (++spins % 64 == 0) {
+			sched_yield();
+		}
+		if (spins % 0x100000 == 0 && simShared->pid[peer] && kill(simShared->pid[peer], 0) < 0) {
+			dprintf(2, "sim: the other image has died\n");
+			Sim_Quit();
+		}
+	}
+	if (simShared->quit) {
+		exit(0);
+	}
+	__sync_synchronize();
+	simShared->ticks[simPeerId] = simTicks + 1;
+}
+
+// Runs the Timer3 compare vectors for every match of OCR3A and OCR3B since
+// the last tick, in time order, each seeing the OCRs the ones before left
+// (the stepper engine and the keypad scan move theirs on each time) and
+// reading TCNT3 as the match count. Matches are batched per tick, but their
+// count and total time are exact
+static void Sim_Timer3CompareTick(void)
+{
+	static unsigned long checked[2];	// Counts up to which matches have run
+	volatile unsigned short* const ocr[2] = {&OCR3A, &OCR3B};
+	static const unsigned char enable[2] = {OCIE3A, OCIE3B};
+	void (*const vector[2])(void) = {TIMER3_COMPA_vect, TIMER3_COMPB_vect};
+	unsigned long distance, at[2];
+	unsigned char i, next, before;
+
+	for (;;) {
+		next = 2;
+		for (i = 0; i < 2; i++) {
+			if (!(TIMSK3 & (1 << enable[i])) || !vector[i]) {
+				continue;
+			}
+			distance = (unsigned short)(*ocr[i] - (unsigned short)checked[i]);
+			if (!distance) {
+				distance = 0x10000UL;
+			}
+			at[i] = checked[i] + distance;
+			if (at[i] <= simTimer3Counts && (next == 2 || at[i] < at[next])) {
+				next = i;
+			}
+		}
+		if (next == 2) {
+			break;
+		}
+		checked[next] = at[next];
+		simTimer3Match = at[next];
+		simTimer3Held = 1;
+		before = PORTB;
+		vector[next]();
+		Sim_MotorSteps(before, PORTB);
+		simTimer3Held = 0;
+	}
+	checked[0] = checked[1] = simTimer3Counts;
+}
+
+// Raises the pin change vector of port C when a masked pin has changed
+// since the last tick (the keypad rows, see keypad_isr.h)
+static void Sim_PinChangeTick(void)
+{
+	static unsigned char last;
+	unsigned char pins = *simReadPin(2) & PCMSK2;
+
+	if (pins != last && (PCICR & (1 << PCIE2)) && PCINT2_vect) {
+		last = pins;
+		PCINT2_vect();
+		return;
+	}
+	last = pins;
+}
+
+// Shifts out the bytes the SPI has time for into the 74HC595 chain on
+// MOSI/SCK, running the transfer complete ISR after each (shiftreg_spi.h).
+// A rising edge on RCLK (PB4) latches the chain
+static void Sim_SpiTick(void)
+{
+	static const unsigned char dividers[4] = {4, 16, 64, 128};
+	unsigned char div = dividers[SPCR & 3] >> ((SPSR & (1 << SPI2X)) ? 1 : 0);
+	unsigned char before;
+
+	if (!(SPCR & (1 << SPE)) || SPDR == SIM_SPDR_EMPTY) {
+		simSpiCredit = 0; // Idle: nothing banked
+		return;
+	}
+	simSpiCredit += SIM_F_CPU / (div * 8UL);
+	while (SPDR != SIM_SPDR_EMPTY && simSpiCredit >= 1000) {
+		simSpiCredit -= 1000;
+		memmove(simShift + 1, simShift, SIM_SHIFT_CHAIN - 1);
+		simShift[0] = SPDR;
+		SPDR = SIM_SPDR_EMPTY;
+		if (simShiftCount < SIM_SHIFT_CHAIN) {
+			simShiftCount++;
+		}
+		before = PORTB;
+		if ((SPCR & (1 << SPIE)) && SPI_STC_vect) {
+			SPI_STC_vect();
+		} else {
+			SPSR |= (1 << SPIF);
+		}
+		if (!(before & (1 << PB4)) && (PORTB & (1 << PB4))) {
+			if (simShiftFd >= 0) {
+				write(simShiftFd, simShift, simShiftCount);
+			}
+			simShiftCount = 0;
+		}
+	}
+}
+
+// Ticks, up to most, before a USART has a byte to shift or may receive one
+static unsigned long Sim_UsartQuiet(const SimUsart* u, unsigned long most)
+{
+	struct pollfd rx;
+
+	if (*u->udr != SIM_UDR_EMPTY
+		|| ((*u->ucsrb & (1 << UDRIE0)) && (*u->ucsrb & (1 << TXEN0)) && u->udreVector)) {
+		return 0;
+	}
+	if ((*u->ucsrb & (1 << RXCIE0)) && (*u->ucsrb & (1 << RXEN0)) && u->rxVector && u->rxFd >= 0) {
+		// Bytes that arrive during the jump are read late, as they would
+		// be if they arrived during a long tick
+		rx.fd = u->rxFd;
+		rx.events = POLLIN;
+		if (poll(&rx, 1, 0) != 0) {
+			return 0;
+		}
+	}
+	return most;
+}
+
+// Ticks, up to most, before Timer3 reaches count at (counts from the last
+// tick); the tick it is reached in must run
+static unsigned long Sim_Timer3Quiet(unsigned long at, unsigned long most)
+{
+	static const unsigned short prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+	unsigned long us = (at - simTimer3Counts) * prescale[TCCR3B & 0x07] / (SIM_F_CPU / 1000000UL);
+
+	return (us / 1000 > most + 1) ? most : (us < 2000) ? 0 : us / 1000 - 1;
+}
+
+unsigned long Sim_SkipTicks(unsigned long most)
+{
+	unsigned short distance;
+	unsigned char i;
+
+	// Peripherals that need every tick: the lockstep barrier, free running
+	// or started ADC conversions, SPI transfers, a held key, pin changes
+	if (!simVirtual || simPaired || simKeyTicks
+		|| ((ADCSRA & (1 << ADEN)) && (ADCSRA & ((1 << ADATE) | (1 << ADSC))))
+		|| ((SPCR & (1 << SPE)) && SPDR != SIM_SPDR_EMPTY)
+		|| ((PCICR & (1 << PCIE2)) && PCINT2_vect)) {
+		return 0;
+	}
+	if (simCtrlFd >= 0 || simVendsWanted) {
+		most = (simEventGap < most) ? simEventGap : most;
+	}
+	most = Sim_UsartQuiet(&simUsarts[0], most);
+	most = Sim_UsartQuiet(&simUsarts[1], most);
+	if (TCCR3B & 0x07) {
+		if ((TIMSK3 & (1 << OCIE3A)) && TIMER3_COMPA_vect) {
+			distance = OCR3A - (unsigned short)simTimer3Counts;
+			most = Sim_Timer3Quiet(simTimer3Counts + (distance ? distance : 0x10000UL), most);
+		}
+		if ((TIMSK3 & (1 << OCIE3B)) && TIMER3_COMPB_vect) {
+			distance = OCR3B - (unsigned short)simTimer3Counts;
+			most = Sim_Timer3Quiet(simTimer3Counts + (distance ? distance : 0x10000UL), most);
+		}
+		if ((TIMSK3 & (1 << TOIE3)) && TIMER3_OVF_vect) {
+			most = Sim_Timer3Quiet((simTimer3Counts | 0xFFFFUL) + 1, most);
+		}
+	}
+	if (!most) {
+		return 0;
+	}
+
+	// What the skipped ticks would have done
+	simTicks += most;
+	simSubTick = 0;
+	if (simEventGap) {
+		simEventGap = (simEventGap > most) ? simEventGap - most : 0;
+	}
+	for (i = 0; i < 2; i++) {
+		simUsarts[i].credit += most * Sim_UsartRate(&simUsarts[i]);
+		if (simUsarts[i].credit > SIM_BYTE_COST) {
+			simUsarts[i].credit = SIM_BYTE_COST; // An idle line banks one byte
+		}
+	}
+	return most;
+}
+
+void Sim_PeripheralTick(void)
+{
+	if (simVirtual) {
+		if (simPaired) {
+			Sim_Barrier();
+		}
+		simSubTick = (simSubTick >= 1000) ? simSubTick - 1000 : 0;
+	} else {
+		clock_gettime(CLOCK_MONOTONIC, &simLastTick);
+	}
+	simTicks++;
+	Sim_ControlTick();
+	Sim_UsartTick(&simUsarts[0]);
+	Sim_UsartTick(&simUsarts[1]);
+	Sim_AdcTick();
+	Sim_SpiTick();
+
+	(void)simTimer3(); // Notices an overflow since the last read
+	if ((TIFR3 & (1 << TOV3)) && (TIMSK3 & (1 << TOIE3)) && TIMER3_OVF_vect) {
+		TIFR3 &= ~(1 << TOV3);
+		TIMER3_OVF_vect();
+	}
+	Sim_Timer3CompareTick();
+	Sim_PinChangeTick();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EEPROM
+
+static unsigned char simEeprom[E2END + 1];
+static unsigned long simEepromWrites[E2END + 1]; // Per cell, since start
+static int simEepromFd = -2; // -2: not loaded yet
+
+static void Sim_EepromLoad(void)
+{
+	if (simEepromFd != -2) {
+		return;
+	}
+	memset(simEeprom, 0xFF, sizeof(simEeprom)); // Erased
+	simEepromFd = Sim_Open("SIM_EEPROM", O_CREAT, -1);
+	if (simEepromFd >= 0) {
+		pread(simEepromFd, simEeprom, sizeof(simEeprom), 0);
+	}
+}
+
+static void Sim_EepromStore(uintptr_t address, const void* src, size_t n)
+{
+	Sim_EepromLoad();
+	while (n--) {
+		address &= E2END;
+		simEeprom[address] = *(const unsigned char*)src;
+		simEepromWrites[address]++;
+		if (simEepromFd >= 0) {
+			pwrite(simEepromFd, &simEeprom[address], 1, address);
+		}
+		address++;
+		src = (const unsigned char*)src + 1;
+	}
+}
+
+unsigned long Sim_EepromWrites(unsigned short address)
+{
+	return simEepromWrites[address & E2END];
+}
+
+// Prints the EEPROM writes made by this run, if any
+static void Sim_EepromReport(void)
+{
+	unsigned long total = 0, most = 0;
+	unsigned short a, cells = 0;
+
+	for (a = 0; a <= E2END; a++) {
+		if (simEepromWrites[a]) {
+			total += simEepromWrites[a];
+			cells++;
+		}
+		if (simEepromWrites[a] > most) {
+			most = simEepromWrites[a];
+		}
+	}
+	if (total) {
+		dprintf(2, "sim: EEPROM %lu byte writes to %u cells, at most %lu to one cell\n",
+			total, cells, most);
+	}
+}
+
+void eeprom_read_block(void* dst, const void* address, size_t n)
+{
+	uintptr_t a = (uintptr_t)address;
+
+	Sim_EepromLoad();
+	while (n--) {
+		*(unsigned char*)dst = simEeprom[a++ & E2END];
+		dst = (unsigned char*)dst + 1;
+	}
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+	uint8_t value;
+	eeprom_read_block(&value, address, 1);
+	return value;
+}
+
+uint16_t eeprom_read_word(const uint16_t* address)
+{
+	uint16_t value;
+	eeprom_read_block(&value, address, 2);
+	return value;
+}
+
+void eeprom_write_block(const void* src, void* address, size_t n)
+{
+	Sim_EepromStore((uintptr_t)address, src, n);
+}
+
+void eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+	Sim_EepromStore((uintptr_t)address, &value, 1);
+}
+
+void eeprom_write_word(uint16_t* address, uint16_t value)
+{
+	Sim_EepromStore((uintptr_t)address, &value, 2);
+}
+
+void eeprom_update_block(const void* src, void* address, size_t n)
+{
+	uintptr_t a = (uintptr_t)address;
+	const unsigned char* s = src;
+
+	Sim_EepromLoad();
+	for (; n--; a++, s++) {
+		if (simEeprom[a & E2END] != *s) {
+			Sim_EepromStore(a, s, 1);
+		}
+	}
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+	eeprom_update_block(&value, address, 1);
+}
+
+void eeprom_update_word(uint16_t* address, uint16_t value)
+{
+	eeprom_update_block(&value, address, 2);
+}
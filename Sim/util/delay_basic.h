@@ -0,0 +1,15 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Busy-wait loops for the Linux host simulation. Only used before Timer3
+// runs; host time spent here is not simulated time, so they return at once.
+
+#ifndef SIM_UTIL_DELAY_BASIC_H
+#define SIM_UTIL_DELAY_BASIC_H
+
+#define _delay_loop_1(count) ((void)(count))
+#define _delay_loop_2(count) ((void)(count))
+
+#endif //SIM_UTIL_DELAY_BASIC_H
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# Permission to copy is granted provided that this header remains intact.
+# This software is provided with no warranties.
+
+# Generates Sim/traces/coin_*.txt, the synthetic coin beam traces that
+# Sim/replay_coin.sh feeds through the coin detector (Includes/coin_detector.h).
+# They are not captures from the boards: each is an idle level with gaussian
+# noise, and coins are dips to about 300 counts. The random stream is seeded,
+# so the same Python 3 gives the same files; the three traces draw from one
+# stream, in this order.
+#   coin_bounce.txt      3 coins whose entry and exit edges bounce
+#   coin_long_block.txt  a coin, the beam blocked for 400 ms, another coin
+#   coin_noise.txt       4 coins, noise sigma 15 counts, single sample spikes
+#                        200 counts deep and the idle level drifting from 800
+#                        to 710
+# Samples are one channel at ADC_SAMPLE_RATE (4807/s), clipped to 0..1023.
+#
+# Usage: Tools/coin_traces.py [--seed 3] [DIRECTORY]   (default Sim/traces)
+
+import argparse
+import os
+import random
+
+IDLE = 800      # Idle level of the beam
+
+
+def write(directory, name, comment, coins, samples):
+    with open(os.path.join(directory, name), "w", newline="\r\n") as f:
+        for line in comment:
+            f.write("# " + line + "\n")
+        f.write("# coins %d\n" % coins)
+        for i in range(0, len(samples), 16):
+            f.write(" ".join("%d" % max(0, min(1023, round(v))) for v in samples[i:i + 16]) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the synthetic coin beam traces")
+    parser.add_argument("--seed", type=int, default=3, help="seed of the random stream")
+    parser.add_argument("directory", nargs="?", default="Sim/traces")
+    args = parser.parse_args()
+    r = random.Random(args.seed)
+
+    def idle(n, sd=4):
+        return [IDLE + r.gauss(0, sd) for _ in range(n)]
+
+    def coin(n, level=300, sd=6):
+        return [level + r.gauss(0, sd) for _ in range(n)]
+
+    # Edges that cross the thresholds several times: the entry bounce is too
+    # short to count, the exit bounce stays in the hysteresis band
+    s = idle(600)
+    for _ in range(3):
+        s += [690, 770, 695, 765, 688, 772, 660, 740]
+        s += coin(44)
+        s += [520, 690, 745, 720, 780, 735, 790, 760, 745, 795]
+        s += idle(700)
+    write(args.directory, "coin_bounce.txt",
+          ["Synthetic (Tools/coin_traces.py): three coins whose beam edges bounce",
+           "across the pulse thresholds: the entry bounce is rejected as too",
+           "short, the exit bounce stays in the hysteresis band. 4807 samples/s,",
+           "idle level ~800, noise sigma 4 counts."], 3, s)
+
+    # The beam blocked for 400 ms between two coins
+    s = idle(500)
+    s += coin(48) + idle(500)
+    s += coin(1920, 420, 10) + idle(500)     # 400 ms
+    s += coin(52) + idle(500)
+    write(args.directory, "coin_long_block.txt",
+          ["Synthetic (Tools/coin_traces.py): a coin, the beam blocked for 400 ms",
+           "(a jammed coin or a finger: rejected as too long), then another coin.",
+           "4807 samples/s, idle ~800, noise sigma 4 counts."], 2, s)
+
+    # Noise, spikes and the LED ageing: the idle level drifts down by 90
+    s = []
+    n = 5200
+    coins_at = [800, 2000, 3200, 4300]
+    i = 0
+    while i < n:
+        level = IDLE - 90.0 * i / n
+        if i in coins_at:
+            w = r.randint(35, 70)
+            s += [level - 330 + r.gauss(0, 20) for _ in range(w)]
+            i += w
+            continue
+        v = level + r.gauss(0, 15)
+        if r.random() < 0.004:
+            v = level - 200
+        s.append(v)
+        i += 1
+    write(args.directory, "coin_noise.txt",
+          ["Synthetic (Tools/coin_traces.py): four coins on a noisy beam (sigma 15",
+           "counts) with single sample spikes 200 counts deep and the idle level",
+           "drifting from 800 to 710 as the LED ages. 4807 samples/s."], 4, s)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# Permission to copy is granted provided that this header remains intact.
+# This software is provided with no warranties.
+
+# Decodes the run-time statistics dumps written by RunTime_Dump()
+# (Includes/runtime_stats.h) and prints per-task CPU use, context switches
+# per second and stack high-water marks.
+#
+# Reads a serial device (the Bluetooth module's rfcomm port for uC1, or a
+# USB-serial adapter on uC2's USART0), sending the request every
+# --interval seconds, or decodes the dumps already captured in a file.
+# The request byte goes out as a line: uC1's command parser
+# (Includes/bt_command.h) acts on whole lines, and uC2 skips the line end.
+# Other traffic on the line (uC1's "BAL n" reports) is skipped.
+# Rates are taken between consecutive dumps; the first dump of a run is
+# compared with the counters at zero, i.e. averaged since the scheduler
+# started.
+#
+# uC2's USART0 also carries the trace stream and runs at 250000 baud.
+#
+# With --periodic it asks for and decodes the periodic task dumps written by
+# Periodic_Dump() (Includes/periodic.h) instead: releases, deadline misses,
+# skipped releases, period jitter and worst response time per task, all
+# since the scheduler started.
+#
+# Usage: Tools/rtstats.py /dev/rfcomm0 [--baud 9600] [--interval 2] [--count N]
+#        Tools/rtstats.py /dev/ttyUSB0 --baud 250000 [--periodic]
+#        Tools/rtstats.py capture.bin --file [--periodic]
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+from serialport import crc8, open_serial
+
+SYNC = b"RT"
+REQUEST = b"S"
+VERSION = 1
+NAME_LEN = 8  # configMAX_TASK_NAME_LEN
+HEADER = struct.Struct("<BBBLH")  # version, count, counts/us, total, ticks
+RECORD = struct.Struct("<%dsLLHBB" % NAME_LEN)
+
+PERIODIC_SYNC = b"PT"
+PERIODIC_REQUEST = b"P"
+PERIODIC_VERSION = 1
+PERIODIC_HEADER = struct.Struct("<BBBH")  # version, count, counts/us, counts/tick
+PERIODIC_RECORD = struct.Struct("<%dsHHBLHHllLL" % NAME_LEN)
+
+
+def parse(buf):
+    """Returns (dump, rest of buf) for the first valid dump in buf, or
+    (None, unparsed tail) if buf holds no complete dump yet."""
+    while True:
+        start = buf.find(SYNC)
+        if start < 0:
+            return None, buf[-1:]
+        body = buf[start + 2:]
+        if len(body) < HEADER.size:
+            return None, buf[start:]
+        version, count, per_us, total, ticks = HEADER.unpack_from(body)
+        size = HEADER.size + count * RECORD.size
+        if version != VERSION:
+            buf = buf[start + 1:]
+            continue
+        if len(body) < size + 1:
+            return None, buf[start:]
+        if crc8(body[:size]) != body[size]:
+            buf = buf[start + 1:]  # "RT" inside other traffic, or a bad dump
+            continue
+        tasks = {}
+        for i in range(count):
+            name, runtime, switches, stack, prio, state = RECORD.unpack_from(
+                body, HEADER.size + i * RECORD.size)
+            name = name.split(b"\0", 1)[0].decode("ascii", "replace")
+            tasks[name] = dict(runtime=runtime, switches=switches, stack=stack,
+                               prio=prio, state=chr(state))
+        dump = dict(per_us=per_us, total=total, ticks=ticks, tasks=tasks)
+        return dump, body[size + 1:]
+
+
+def parse_periodic(buf):
+    """As parse(), for the periodic task dumps."""
+    while True:
+        start = buf.find(PERIODIC_SYNC)
+        if start < 0:
+            return None, buf[-1:]
+        body = buf[start + 2:]
+        if len(body) < PERIODIC_HEADER.size:
+            return None, buf[start:]
+        version, count, per_us, per_tick = PERIODIC_HEADER.unpack_from(body)
+        size = PERIODIC_HEADER.size + count * PERIODIC_RECORD.size
+        if version != PERIODIC_VERSION:
+            buf = buf[start + 1:]
+            continue
+        if len(body) < size + 1:
+            return None, buf[start:]
+        if crc8(body[:size]) != body[size]:
+            buf = buf[start + 1:]
+            continue
+        tasks = []
+        for i in range(count):
+            (name, period, deadline, prio, releases, misses, skipped, jmin,
+             jmax, jsum, worst) = PERIODIC_RECORD.unpack_from(
+                body, PERIODIC_HEADER.size + i * PERIODIC_RECORD.size)
+            name = name.split(b"\0", 1)[0].decode("ascii", "replace")
+            tasks.append(dict(name=name, period=period, deadline=deadline,
+                              prio=prio, releases=releases, misses=misses,
+                              skipped=skipped, jmin=jmin, jmax=jmax,
+                              jsum=jsum, worst=worst))
+        dump = dict(per_us=per_us, per_tick=per_tick, tasks=tasks)
+        return dump, body[size + 1:]
+
+
+def report_periodic(dump, previous):
+    per_us = dump["per_us"] or 1
+    print("%-8s %6s %8s %4s %9s %6s %7s %17s %9s %9s" % (
+        "Task", "Period", "Deadline", "Prio", "Releases", "Misses", "Skipped",
+        "Jitter us min/max", "Mean |us|", "Worst us"))
+    for t in sorted(dump["tasks"], key=lambda t: t["period"]):
+        if t["releases"] > 1:
+            jitter = "%8.0f/%-8.0f" % (t["jmin"] / per_us, t["jmax"] / per_us)
+            mean = t["jsum"] / (t["releases"] - 1) / per_us
+        else:
+            jitter, mean = "%17s" % "-", 0.0
+        print("%-8s %6u %8u %4u %9u %6u %7u %17s %9.1f %9.0f" % (
+            t["name"], t["period"], t["deadline"], t["prio"], t["releases"],
+            t["misses"], t["skipped"], jitter, mean, t["worst"] / per_us))
+    print()
+
+
+def report(dump, previous):
+    per_us = dump["per_us"] or 1
+    if previous:
+        elapsed = (dump["total"] - previous["total"]) & 0xFFFFFFFF
+    else:
+        elapsed = dump["total"]
+    seconds = elapsed / per_us / 1e6
+    print("%.3f s of run time (tick %u)" % (seconds, dump["ticks"]))
+    print("%-8s %5s %4s %7s %10s %6s" % ("Task", "State", "Prio", "CPU %",
+                                         "Switch/s", "Stack"))
+    for name, t in sorted(dump["tasks"].items(),
+                          key=lambda item: -item[1]["runtime"]):
+        old = previous["tasks"].get(name) if previous else None
+        runtime = (t["runtime"] - (old["runtime"] if old else 0)) & 0xFFFFFFFF
+        switches = (t["switches"] - (old["switches"] if old else 0)) & 0xFFFFFFFF
+        print("%-8s %5s %4u %7.2f %10.1f %6u" % (
+            name, t["state"], t["prio"],
+            100.0 * runtime / elapsed if elapsed else 0.0,
+            switches / seconds if seconds else 0.0, t["stack"]))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode MiniVendi run-time statistics dumps")
+    parser.add_argument("path", help="serial device, or capture with --file")
+    parser.add_argument("--file", action="store_true",
+                        help="decode the dumps in a captured file")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--interval", type=float, default=2.0,
+                        help="seconds between requests")
+    parser.add_argument("--count", type=int, default=0,
+                        help="stop after this many dumps (0: run forever)")
+    parser.add_argument("--periodic", action="store_true",
+                        help="periodic task statistics (uC2) instead")
+    args = parser.parse_args()
+    if args.periodic:
+        parse_dump, show, request = parse_periodic, report_periodic, PERIODIC_REQUEST
+    else:
+        parse_dump, show, request = parse, report, REQUEST
+
+    previous = None
+    shown = 0
+    if args.file:
+        with open(args.path, "rb") as f:
+            buf = f.read()
+        while True:
+            dump, buf = parse_dump(buf)
+            if not dump:
+                break
+            show(dump, previous)
+            previous = dump
+        return
+
+    fd = open_serial(args.path, args.baud)
+    buf = b""
+    next_request = 0.0
+    while not args.count or shown < args.count:
+        if time.monotonic() >= next_request:
+            os.write(fd, request + b"\r\n")
+            next_request = time.monotonic() + args.interval
+        buf += os.read(fd, 256)
+        dump, buf = parse_dump(buf)
+        if dump:
+            show(dump, previous)
+            previous = dump
+            shown += 1
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,58 @@
+# Permission to copy is granted provided that this header remains intact.
+# This software is provided with no warranties.
+
+# Raw serial port setup shared by the host tools.
+# Standard rates use termios; others (uC2's 250000 baud trace USART) are set
+# with the Linux termios2 ioctls, which USB-serial adapters support.
+
+import array
+import fcntl
+import os
+import struct
+import termios
+
+BAUDS = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+         57600: termios.B57600, 115200: termios.B115200}
+
+# struct termios2: 4 flag words, c_line, c_cc[19], c_ispeed, c_ospeed
+TERMIOS2 = struct.Struct("=4IB19sII")
+TCGETS2 = 0x802C542A
+TCSETS2 = 0x402C542B
+CBAUD = 0o010017
+BOTHER = 0o010000
+
+
+def set_custom_baud(fd, baud):
+    buf = array.array("B", bytes(TERMIOS2.size))
+    fcntl.ioctl(fd, TCGETS2, buf, True)
+    iflag, oflag, cflag, lflag, line, cc, _, _ = TERMIOS2.unpack(buf.tobytes())
+    cflag = (cflag & ~CBAUD) | BOTHER
+    fcntl.ioctl(fd, TCSETS2,
+                TERMIOS2.pack(iflag, oflag, cflag, lflag, line, cc, baud, baud))
+
+
+def open_serial(path, baud):
+    """Opens path raw, 8N1, with reads returning after at most 100 ms."""
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                    # iflag: raw
+    attrs[1] = 0                                    # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                    # lflag: no echo, no canon
+    attrs[4] = attrs[5] = BAUDS.get(baud, termios.B38400)
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1                     # read() waits <= 100 ms
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    if baud not in BAUDS:
+        set_custom_baud(fd, baud)
+    return fd
+
+
+def crc8(data):
+    """CRC-8, polynomial x^8 + x^2 + x + 1, as Link_Crc8()."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
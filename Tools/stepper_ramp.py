@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Permission to copy is granted provided that this header remains intact.
+# This software is provided with no warranties.
+
+# Generates Includes/stepper_ramp.h, the acceleration table of the stepper
+# engine (Includes/stepper.h).
+#
+# Entry n is the time in microseconds between full steps n and n + 1 of a
+# move starting at --start steps/s and accelerating at --accel steps/s^2,
+# up to the first entry at or above --speed steps/s, which is the cruise
+# interval. Constant acceleration from v0 reaches step n at
+#   t(n) = (sqrt(v0^2 + 2 a n) - v0) / a
+#
+# Usage: Tools/stepper_ramp.py [--start 400] [--speed 1250] [--accel 4000]
+#                              > Includes/stepper_ramp.h
+
+import argparse
+import math
+
+
+def intervals(start, speed, accel):
+    def t(n):
+        return (math.sqrt(start * start + 2.0 * accel * n) - start) / accel
+
+    table = []
+    n = 0
+    while True:
+        us = int(round((t(n + 1) - t(n)) * 1e6))
+        table.append(us)
+        if us <= 1e6 / speed:
+            return table
+        n += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the stepper ramp table")
+    parser.add_argument("--start", type=float, default=400.0,
+                        help="speed the motor starts at without missing steps, steps/s")
+    parser.add_argument("--speed", type=float, default=1250.0,
+                        help="cruise speed, steps/s")
+    parser.add_argument("--accel", type=float, default=4000.0,
+                        help="acceleration, steps/s^2")
+    args = parser.parse_args()
+
+    table = intervals(args.start, args.speed, args.accel)
+    print("// Permission to copy is granted provided that this header remains intact.")
+    print("// This software is provided with no warranties.")
+    print()
+    print("/" * 80)
+    print()
+    print("// Acceleration table of the stepper engine (stepper.h), generated by")
+    print("// Tools/stepper_ramp.py --start %g --speed %g --accel %g"
+          % (args.start, args.speed, args.accel))
+    print("// Entry n: microseconds between full steps n and n + 1 of a move; the")
+    print("// last entry is the cruise interval.")
+    print()
+    print("#ifndef STEPPER_RAMP_H")
+    print("#define STEPPER_RAMP_H")
+    print()
+    print("#include <avr/pgmspace.h>")
+    print()
+    print("#define STEPPER_RAMP_STEPS %d" % len(table))
+    print()
+    print("const unsigned short stepperRamp[STEPPER_RAMP_STEPS] PROGMEM = {")
+    for i in range(0, len(table), 12):
+        print("\t" + ", ".join("%4d" % us for us in table[i:i + 12]) + ",")
+    print("};")
+    print()
+    print("#endif //STEPPER_RAMP_H")
+
+
+if __name__ == "__main__":
+    main()
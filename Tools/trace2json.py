@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+# Permission to copy is granted provided that this header remains intact.
+# This software is provided with no warranties.
+
+# Converts the binary kernel trace streamed by Trace_StreamTask
+# (Includes/trace_recorder.h) to Chrome trace event JSON, which
+# chrome://tracing and https://ui.perfetto.dev open directly.
+#
+# The output has one track per task showing when it ran, instant events for
+# queue and semaphore operations (those made from interrupts on their own
+# "ISR" track), and a second process whose tracks show each task's
+# ready-to-running latency. A summary of CPU use and latency per task is
+# printed to stderr. Dropped events (ring buffer full) appear as global
+# "LOST" markers; the slices around them may be stretched.
+#
+# Reads a serial device (uC2's USART0, 250000 baud), sending the start request
+# and recording for --seconds, or decodes a captured stream with --file.
+#
+# Usage: Tools/trace2json.py /dev/ttyUSB0 [--seconds 10] [--raw capture.bin] > trace.json
+#        Tools/trace2json.py capture.bin --file > trace.json
+
+import argparse
+import json
+import os
+import struct
+import sys
+import time
+
+from serialport import crc8, open_serial
+
+SYNC = b"TR"
+START_REQUEST = b"T"
+STOP_REQUEST = b"X"
+MAX_BLOCK = 64
+EVENT = struct.Struct("<BBH")
+
+# Event codes, as trace_hooks.h
+TIME, LOST, TASK_NAME, QUEUE_CREATE, START = 0x01, 0x02, 0x03, 0x04, 0x05
+SWITCHED_IN, TASK_READY, TASK_DELAY, TASK_DELAY_UNTIL = 0x10, 0x11, 0x12, 0x13
+QUEUE_EVENTS = {
+    0x20: "send", 0x21: "send failed", 0x22: "receive",
+    0x23: "receive failed", 0x24: "peek", 0x25: "send from ISR",
+    0x26: "receive from ISR", 0x27: "block on send", 0x28: "block on receive",
+}
+FROM_ISR = (0x25, 0x26)
+QUEUE_TYPES = ["queue", "mutex", "counting semaphore", "binary semaphore",
+               "recursive mutex"]
+
+TASKS_PID = 1
+LATENCY_PID = 2
+ISR_TID = 100
+
+
+def frames(buf):
+    """Yields (events, rest of buf) for each valid frame in buf; the last
+    rest is the unparsed tail."""
+    while True:
+        start = buf.find(SYNC)
+        if start < 0:
+            yield None, buf[-1:]
+            return
+        body = buf[start + 2:]
+        if not body:
+            yield None, buf[start:]
+            return
+        count = body[0]
+        if not 0 < count <= MAX_BLOCK:
+            buf = buf[start + 1:]
+            continue
+        size = 1 + count * EVENT.size
+        if len(body) < size + 1:
+            yield None, buf[start:]
+            return
+        if crc8(body[:size]) != body[size]:
+            buf = buf[start + 1:]  # "TR" inside other traffic, or a bad frame
+            continue
+        events = [EVENT.unpack_from(body, 1 + i * EVENT.size)
+                  for i in range(count)]
+        buf = body[size + 1:]
+        yield events, buf
+
+
+class Converter:
+    def __init__(self, per_us):
+        self.per_us = per_us
+        self.out = []
+        self.names = {}          # task -> {part: 2 chars}
+        self.queues = {}         # queue -> type
+        self.high = None         # upper timestamp half, None until TIME
+        self.last = 0            # last full timestamp, for 2^32 wraps
+        self.epoch = 0
+        self.running = None      # (task, start)
+        self.ready = {}          # task -> time made ready
+        self.cpu = {}
+        self.latency = {}        # task -> [count, total, worst]
+        self.lost = 0
+        self.first = None
+
+    def task_name(self, task):
+        parts = self.names.get(task)
+        if not parts:
+            return "task %d" % task
+        text = b"".join(parts.get(i, b"??") for i in range(len(parts)))
+        return text.split(b"\0", 1)[0].decode("ascii", "replace")
+
+    def queue_name(self, queue):
+        kind = self.queues.get(queue)
+        kind = QUEUE_TYPES[kind] if kind is not None and kind < len(QUEUE_TYPES) else "queue"
+        return "%s %d" % (kind, queue)
+
+    def us(self, t):
+        return (t - self.first) / self.per_us
+
+    def stamp(self, low):
+        t = self.epoch + (self.high << 16 | low)
+        if t < self.last - (1 << 31):
+            self.epoch += 1 << 32
+            t += 1 << 32
+        self.last = t
+        if self.first is None:
+            self.first = t
+        return t
+
+    def close_running(self, t):
+        if self.running:
+            task, start = self.running
+            self.out.append(dict(ph="X", pid=TASKS_PID, tid=task,
+                                 name=self.task_name(task), ts=self.us(start),
+                                 dur=self.us(t) - self.us(start)))
+            self.cpu[task] = self.cpu.get(task, 0) + t - start
+            self.running = None
+
+    def feed(self, event, obj, value):
+        if event == TIME:
+            self.high = value
+            return
+        if event == TASK_NAME:
+            self.names.setdefault(obj & 0x0F, {})[obj >> 4] = struct.pack("<H", value)
+            return
+        if event == QUEUE_CREATE:
+            self.queues[obj] = value
+            return
+        if event == LOST:
+            self.lost += value
+            if self.last and self.first is not None:
+                self.out.append(dict(ph="i", s="g", pid=TASKS_PID, tid=0,
+                                     name="LOST", ts=self.us(self.last),
+                                     args=dict(events=value)))
+            # The switches that were dropped are unknown
+            self.close_running(self.last)
+            self.ready.clear()
+            return
+        if self.high is None:
+            return  # No time reference yet
+        t = self.stamp(value)
+        if event == START:
+            self.close_running(t)
+            self.ready.clear()
+            self.out.append(dict(ph="i", s="g", pid=TASKS_PID, tid=0,
+                                 name="START", ts=self.us(t)))
+        elif event == SWITCHED_IN:
+            self.close_running(t)
+            self.running = (obj, t)
+            made_ready = self.ready.pop(obj, None)
+            if made_ready is not None:
+                self.out.append(dict(ph="X", pid=LATENCY_PID, tid=obj,
+                                     name="ready", ts=self.us(made_ready),
+                                     dur=self.us(t) - self.us(made_ready)))
+                stats = self.latency.setdefault(obj, [0, 0, 0])
+                stats[0] += 1
+                stats[1] += t - made_ready
+                stats[2] = max(stats[2], t - made_ready)
+        elif event == TASK_READY:
+            if not (self.running and self.running[0] == obj):
+                self.ready.setdefault(obj, t)
+        elif event in (TASK_DELAY, TASK_DELAY_UNTIL):
+            self.out.append(dict(ph="i", s="t", pid=TASKS_PID, tid=obj,
+                                 name="delay" if event == TASK_DELAY else "delay until",
+                                 ts=self.us(t)))
+        elif event in QUEUE_EVENTS:
+            if event in FROM_ISR:
+                tid = ISR_TID
+            else:
+                tid = self.running[0] if self.running else ISR_TID
+            self.out.append(dict(ph="i", s="t", pid=TASKS_PID, tid=tid,
+                                 name="%s %s" % (QUEUE_EVENTS[event], self.queue_name(obj)),
+                                 ts=self.us(t)))
+
+    def finish(self):
+        if self.running:
+            self.close_running(self.last)
+        meta = [dict(ph="M", pid=TASKS_PID, name="process_name",
+                     args=dict(name="Tasks")),
+                dict(ph="M", pid=LATENCY_PID, name="process_name",
+                     args=dict(name="Ready to running latency")),
+                dict(ph="M", pid=TASKS_PID, tid=ISR_TID, name="thread_name",
+                     args=dict(name="ISR"))]
+        for task in self.names:
+            for pid in (TASKS_PID, LATENCY_PID):
+                meta.append(dict(ph="M", pid=pid, tid=task, name="thread_name",
+                                 args=dict(name=self.task_name(task))))
+                meta.append(dict(ph="M", pid=pid, tid=task,
+                                 name="thread_sort_index", args=dict(sort_index=task)))
+        return dict(traceEvents=meta + self.out, displayTimeUnit="ms")
+
+    def summary(self, f):
+        total = self.last - self.first if self.first is not None else 0
+        if not total:
+            print("No timed events", file=f)
+            return
+        print("%.3f s traced, %u events lost" % (total / self.per_us / 1e6, self.lost),
+              file=f)
+        print("%-8s %7s %8s %12s %12s" % ("Task", "CPU %", "Readies",
+                                          "Avg lat us", "Max lat us"), file=f)
+        for task in sorted(set(self.cpu) | set(self.latency)):
+            count, lat, worst = self.latency.get(task, (0, 0, 0))
+            print("%-8s %7.2f %8u %12.1f %12.1f" % (
+                self.task_name(task), 100.0 * self.cpu.get(task, 0) / total,
+                count, lat / count / self.per_us if count else 0.0,
+                worst / self.per_us), file=f)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert a MiniVendi kernel trace to Chrome trace JSON")
+    parser.add_argument("path", help="serial device, or capture with --file")
+    parser.add_argument("--file", action="store_true",
+                        help="decode a captured stream")
+    parser.add_argument("--baud", type=int, default=250000)
+    parser.add_argument("--seconds", type=float, default=10.0,
+                        help="how long to record from a serial device")
+    parser.add_argument("--raw", help="also save the received stream here")
+    parser.add_argument("--counts-per-us", type=int, default=1,
+                        help="run-time counter rate (TIMING_TICKS_PER_US)")
+    parser.add_argument("-o", "--output", help="JSON file (default stdout)")
+    args = parser.parse_args()
+
+    conv = Converter(args.counts_per_us)
+    if args.file:
+        with open(args.path, "rb") as f:
+            data = f.read()
+    else:
+        fd = open_serial(args.path, args.baud)
+        os.write(fd, START_REQUEST)
+        data = b""
+        stop = time.monotonic() + args.seconds
+        while time.monotonic() < stop:
+            data += os.read(fd, 4096)
+        os.write(fd, STOP_REQUEST)
+        time.sleep(0.2)  # Let the ring drain
+        while True:
+            more = os.read(fd, 4096)
+            if not more:
+                break
+            data += more
+        os.close(fd)
+        if args.raw:
+            with open(args.raw, "wb") as f:
+                f.write(data)
+
+    for events, rest in frames(data):
+        if events is None:
+            break
+        for event in events:
+            conv.feed(*event)
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    json.dump(conv.finish(), out)
+    out.write("\n")
+    conv.summary(sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,394 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+	
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+
+/*
+ * Size-class pool implementation of pvPortMalloc() and vPortFree().
+ *
+ * The heap is split into a fixed number of pools, each holding blocks of one
+ * size.  A request is served from the smallest class that fits, or from the
+ * next larger class if that one is exhausted.  Free blocks of each class are
+ * kept on a singly linked list threaded through the blocks themselves, so
+ * both allocating and freeing take a bounded number of steps (at most one
+ * per class) and there is no external fragmentation: a freed block can
+ * always be reused by a request of its class.  The price is internal
+ * fragmentation - a request uses a whole block of its class.
+ *
+ * The classes are configured with configHEAP_POOL_CLASSES( X ), a list of
+ * X( block size, block count ) entries in ascending block size order.  Each
+ * size is rounded up to a multiple of portBYTE_ALIGNMENT, so every block is
+ * aligned (a no-op on the AVR, where it is 1).  The total of size * count
+ * replaces configTOTAL_HEAP_SIZE.  Block sizes must be at least
+ * sizeof( void * ).
+ *
+ * Build with this file instead of heap_1.c by setting configUSE_HEAP_POOL
+ * to 1 in FreeRTOSConfig.h; each file compiles to nothing when not selected.
+ */
+#include <stdlib.h>
+
+/* Defining MPU_WRAPPERS_INCLUDED_FROM_API_FILE prevents task.h from redefining
+all the API functions to use the MPU wrappers.  That should only be done when
+task.h is included from an application file. */
+#define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#if ( configUSE_HEAP_POOL == 1 )
+
+/* Default classes, sized from the allocations uC2.c makes on the ATmega1284
+(uC1.c needs fewer of each).  With 2 byte pointers and this configuration a
+queue structure is 33 bytes and a TCB 43 bytes; a queue's storage is
+length * item size + 1 bytes, and a stack configMINIMAL_STACK_SIZE (85) or
+twice that:
+	8		semaphore storage (1) x 5, ADC queue storage (3)
+	16		dispense order queue storage (13) x 2
+	33		queue structures x 13, stepper queue storage (29) x 2,
+			link receive queue storage (33)
+	43		TCBs x 8, the idle task's included
+	85		minimal stacks x 4, stepper done queue storage (71),
+			link transmit queue storage (81)
+	170		double stacks x 4 (the two periodic tasks, DispenseSecTask
+			and LinkSecTask)
+2142 bytes in all, against 2070 for heap_1.  Every class is full after
+vTaskStartScheduler(), so adding a task or queue means adding a block.  The
+8 byte class also keeps the blocks big enough for host pointers when the
+simulation uses these classes (Sim/bench_heap.sh). */
+#ifndef configHEAP_POOL_CLASSES
+	#define configHEAP_POOL_CLASSES( X )	\
+		X( 8, 6 )							\
+		X( 16, 2 )							\
+		X( 33, 16 )							\
+		X( 43, 8 )							\
+		X( 85, 6 )							\
+		X( 170, 4 )
+#endif
+
+/* A class's block size, rounded up so that blocks carved back to back all
+keep the heap's alignment. */
+#define heapALIGNED( usSize )				( ( ( usSize ) + portBYTE_ALIGNMENT_MASK ) & ~portBYTE_ALIGNMENT_MASK )
+
+#define heapCLASS_BYTES( usSize, ucCount )	+ ( heapALIGNED( usSize ) * ( ucCount ) )
+#define heapCLASS_SIZE( usSize, ucCount )	heapALIGNED( usSize ),
+#define heapCLASS_COUNT( usSize, ucCount )	( ucCount ),
+
+#define heapPOOL_BYTES		( 0 configHEAP_POOL_CLASSES( heapCLASS_BYTES ) )
+
+static const unsigned short usClassSize[] = { configHEAP_POOL_CLASSES( heapCLASS_SIZE ) };
+static const unsigned char ucClassBlocks[] = { configHEAP_POOL_CLASSES( heapCLASS_COUNT ) };
+
+#define heapNUM_CLASSES		( sizeof( usClassSize ) / sizeof( usClassSize[ 0 ] ) )
+
+/* Allocate the memory for the pools.  The union is used to force byte
+alignment without using any non-portable code. */
+static union xRTOS_HEAP
+{
+	#if portBYTE_ALIGNMENT == 8
+		volatile portDOUBLE dDummy;
+	#else
+		volatile unsigned long ulDummy;
+	#endif
+	unsigned char ucHeap[ heapPOOL_BYTES ];
+} xHeap;
+
+/* A free block holds the address of the next free block of its class. */
+typedef struct A_FREE_BLOCK
+{
+	struct A_FREE_BLOCK *pxNextFreeBlock;
+} xFreeBlock;
+
+static unsigned char *pucClassStart[ heapNUM_CLASSES ];
+static xFreeBlock *pxFreeList[ heapNUM_CLASSES ];
+static unsigned char ucInUse[ heapNUM_CLASSES ];
+static unsigned char ucMostInUse[ heapNUM_CLASSES ];
+static unsigned short usSpilled[ heapNUM_CLASSES ];
+static unsigned short usFailed[ heapNUM_CLASSES + 1 ];	/* Last entry: larger than every class. */
+
+static size_t xFreeBytes = ( size_t ) 0;
+static size_t xMinimumEverFreeBytes = ( size_t ) 0;
+static portBASE_TYPE xHeapHasBeenInitialised = pdFALSE;
+
+/*
+ * Split the pools into blocks and build the free lists.
+ */
+static void prvHeapInit( void );
+
+/*-----------------------------------------------------------*/
+
+static void prvHeapInit( void )
+{
+unsigned char *pucBlock = xHeap.ucHeap;
+unsigned portBASE_TYPE uxClass, uxBlock;
+xFreeBlock *pxPrevious;
+
+	for( uxClass = 0; uxClass < heapNUM_CLASSES; uxClass++ )
+	{
+		configASSERT( usClassSize[ uxClass ] >= sizeof( xFreeBlock ) );
+		configASSERT( ( uxClass == 0 ) || ( usClassSize[ uxClass ] > usClassSize[ uxClass - 1 ] ) );
+
+		pucClassStart[ uxClass ] = pucBlock;
+		pxFreeList[ uxClass ] = NULL;
+		pxPrevious = NULL;
+
+		/* Link the blocks in address order. */
+		for( uxBlock = 0; uxBlock < ucClassBlocks[ uxClass ]; uxBlock++ )
+		{
+			( ( xFreeBlock * ) pucBlock )->pxNextFreeBlock = NULL;
+			if( pxPrevious == NULL )
+			{
+				pxFreeList[ uxClass ] = ( xFreeBlock * ) pucBlock;
+			}
+			else
+			{
+				pxPrevious->pxNextFreeBlock = ( xFreeBlock * ) pucBlock;
+			}
+			pxPrevious = ( xFreeBlock * ) pucBlock;
+			pucBlock += usClassSize[ uxClass ];
+		}
+
+		ucInUse[ uxClass ] = 0;
+		ucMostInUse[ uxClass ] = 0;
+		usSpilled[ uxClass ] = 0;
+		usFailed[ uxClass ] = 0;
+	}
+	usFailed[ heapNUM_CLASSES ] = 0;
+
+	xFreeBytes = heapPOOL_BYTES;
+	xMinimumEverFreeBytes = heapPOOL_BYTES;
+	xHeapHasBeenInitialised = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void *pvPortMalloc( size_t xWantedSize )
+{
+void *pvReturn = NULL;
+unsigned portBASE_TYPE uxClass, uxFit;
+
+	vTaskSuspendAll();
+	{
+		if( xHeapHasBeenInitialised == pdFALSE )
+		{
+			prvHeapInit();
+		}
+
+		/* Find the smallest class the request fits in. */
+		for( uxFit = 0; uxFit < heapNUM_CLASSES; uxFit++ )
+		{
+			if( xWantedSize <= usClassSize[ uxFit ] )
+			{
+				break;
+			}
+		}
+
+		/* Take a block from it, or from the next larger class that has one. */
+		for( uxClass = uxFit; uxClass < heapNUM_CLASSES; uxClass++ )
+		{
+			if( pxFreeList[ uxClass ] != NULL )
+			{
+				pvReturn = ( void * ) pxFreeList[ uxClass ];
+				pxFreeList[ uxClass ] = pxFreeList[ uxClass ]->pxNextFreeBlock;
+
+				if( ++ucInUse[ uxClass ] > ucMostInUse[ uxClass ] )
+				{
+					ucMostInUse[ uxClass ] = ucInUse[ uxClass ];
+				}
+				if( uxClass != uxFit )
+				{
+					usSpilled[ uxClass ]++;
+				}
+
+				xFreeBytes -= usClassSize[ uxClass ];
+				if( xFreeBytes < xMinimumEverFreeBytes )
+				{
+					xMinimumEverFreeBytes = xFreeBytes;
+				}
+				break;
+			}
+		}
+
+		if( pvReturn == NULL )
+		{
+			usFailed[ uxFit ]++;
+		}
+	}
+	xTaskResumeAll();
+
+	#if( configUSE_MALLOC_FAILED_HOOK == 1 )
+	{
+		if( pvReturn == NULL )
+		{
+			extern void vApplicationMallocFailedHook( void );
+			vApplicationMallocFailedHook();
+		}
+	}
+	#endif
+
+	return pvReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vPortFree( void *pv )
+{
+unsigned char *pucBlock = ( unsigned char * ) pv;
+unsigned portBASE_TYPE uxClass;
+
+	if( pv == NULL )
+	{
+		return;
+	}
+
+	/* The pools are laid out in class order, so the class is the last one
+	starting at or below the block. */
+	configASSERT( ( pucBlock >= xHeap.ucHeap ) && ( pucBlock < ( xHeap.ucHeap + heapPOOL_BYTES ) ) );
+	for( uxClass = heapNUM_CLASSES - 1; uxClass > 0; uxClass-- )
+	{
+		if( pucBlock >= pucClassStart[ uxClass ] )
+		{
+			break;
+		}
+	}
+
+	vTaskSuspendAll();
+	{
+		( ( xFreeBlock * ) pucBlock )->pxNextFreeBlock = pxFreeList[ uxClass ];
+		pxFreeList[ uxClass ] = ( xFreeBlock * ) pucBlock;
+		ucInUse[ uxClass ]--;
+		xFreeBytes += usClassSize[ uxClass ];
+	}
+	xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+void vPortInitialiseBlocks( void )
+{
+	/* Only required when static memory is not cleared. */
+	xHeapHasBeenInitialised = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortGetFreeHeapSize( void )
+{
+	if( xHeapHasBeenInitialised == pdFALSE )
+	{
+		return heapPOOL_BYTES;
+	}
+	return xFreeBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortGetMinimumEverFreeHeapSize( void )
+{
+	if( xHeapHasBeenInitialised == pdFALSE )
+	{
+		return heapPOOL_BYTES;
+	}
+	return xMinimumEverFreeBytes;
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxPortGetHeapClassCount( void )
+{
+	return ( unsigned portBASE_TYPE ) heapNUM_CLASSES;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetHeapClassStats( unsigned portBASE_TYPE uxClass, xHeapClassStats *pxStats )
+{
+	configASSERT( uxClass < heapNUM_CLASSES );
+
+	vTaskSuspendAll();
+	{
+		pxStats->usBlockSize = usClassSize[ uxClass ];
+		pxStats->ucBlocks = ucClassBlocks[ uxClass ];
+		pxStats->ucInUse = ucInUse[ uxClass ];
+		pxStats->ucMostInUse = ucMostInUse[ uxClass ];
+		pxStats->usSpilled = usSpilled[ uxClass ];
+		pxStats->usFailed = usFailed[ uxClass ];
+	}
+	xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+unsigned short usPortGetFailedAllocations( void )
+{
+unsigned short usTotal = 0;
+unsigned portBASE_TYPE uxClass;
+
+	vTaskSuspendAll();
+	{
+		for( uxClass = 0; uxClass <= heapNUM_CLASSES; uxClass++ )
+		{
+			usTotal += usFailed[ uxClass ];
+		}
+	}
+	xTaskResumeAll();
+
+	return usTotal;
+}
+
+#endif /* configUSE_HEAP_POOL */
@@ -75,6 +75,7 @@ Changes from V2.6.0
 
 #include <stdlib.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -92,6 +93,31 @@ Changes from V2.6.0
 #define portCLOCK_PRESCALER						( ( unsigned long ) 64 )
 #define portCOMPARE_MATCH_A_INTERRUPT_ENABLE	( ( unsigned char ) 0x02 )
 
+/* Timer 1 counts per tick period (125 at 8MHz and 1kHz). */
+#define portTIMER_COUNTS_PER_TICK				( ( unsigned short ) ( configCPU_CLOCK_HZ / configTICK_RATE_HZ / portCLOCK_PRESCALER ) )
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	/* The longest sleep the 16 bit compare register can time, less one tick
+	of margin for the early wake up realignment in
+	vPortSuppressTicksAndSleep(). */
+	#define portMAX_SUPPRESSED_TICKS			( ( portTickType ) ( 0xffffUL / portTIMER_COUNTS_PER_TICK - 1 ) )
+
+	/* Set by the tick interrupt so vPortSuppressTicksAndSleep() can tell a
+	wake up at the end of the sleep from one caused by another interrupt. */
+	static volatile unsigned char ucTickInterruptFired = pdFALSE;
+
+	/* Every tick interrupt puts the compare match back to a single tick
+	period, as it may have been moved out for a tickless sleep. */
+	#define portTICKLESS_TICK()		ucTickInterruptFired = pdTRUE;				\
+									OCR1A = portTIMER_COUNTS_PER_TICK - 1
+
+#else
+
+	#define portTICKLESS_TICK()
+
+#endif
+
 /*-----------------------------------------------------------*/
 
 /* We require the address of the pxCurrentTCB variable, but don't want to know
@@ -385,6 +411,7 @@ void vPortYieldFromTick( void ) __attribute__ ( ( naked ) );
 void vPortYieldFromTick( void )
 {
 	portSAVE_CONTEXT();
+	portTICKLESS_TICK();
 	vTaskIncrementTick();
 	vTaskSwitchContext();
 	portRESTORE_CONTEXT();
@@ -463,9 +490,99 @@ unsigned char ucHighByte, ucLowByte;
 	void TIMER1_COMPA_vect( void ) __attribute__ ( ( signal ) );
 	void TIMER1_COMPA_vect( void )
 	{
+		portTICKLESS_TICK();
 		vTaskIncrementTick();
 	}
 #endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	/*
+	 * Called by the idle task, with the scheduler suspended, when no task is
+	 * due to run for at least xExpectedIdleTime ticks.  Timer 1 keeps running
+	 * from the last tick but its compare match is moved out so the next tick
+	 * interrupt comes xExpectedIdleTime ticks later, and the CPU sleeps in
+	 * IDLE mode until then.  IDLE is the deepest mode Timer 1 runs in (power
+	 * save only keeps an asynchronously clocked timer 2), and it lets any
+	 * enabled interrupt - USART RX, ADC, pin change - wake the CPU early.  On
+	 * wake up the tick count is stepped by the whole tick periods that passed
+	 * and the compare match is realigned to the original tick boundaries, so
+	 * early wake ups do not make the tick drift.
+	 */
+	void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime )
+	{
+	unsigned short usCount, usBoundary;
+	portTickType xCompleteTicks;
+
+		if( xExpectedIdleTime > portMAX_SUPPRESSED_TICKS )
+		{
+			xExpectedIdleTime = portMAX_SUPPRESSED_TICKS;
+		}
+
+		portDISABLE_INTERRUPTS();
+
+		/* An interrupt may have readied a task since the idle task decided to
+		sleep. */
+		if( eTaskConfirmSleepModeStatus() == eAbortSleep )
+		{
+			portENABLE_INTERRUPTS();
+			return;
+		}
+
+		/* Timer 1 is somewhere within the current tick period, so a compare
+		value of n periods puts the next match n ticks after the last one. */
+		OCR1A = ( unsigned short ) ( xExpectedIdleTime * portTIMER_COUNTS_PER_TICK - 1 );
+		if( ( TIFR1 & ( 1 << OCF1A ) ) != 0 )
+		{
+			/* The old compare value matched before the new one was written, so
+			the counter has already restarted and a tick is pending.  Restore
+			the single tick period and let the tick run instead. */
+			OCR1A = portTIMER_COUNTS_PER_TICK - 1;
+			portENABLE_INTERRUPTS();
+			return;
+		}
+
+		ucTickInterruptFired = pdFALSE;
+		set_sleep_mode( SLEEP_MODE_IDLE );
+		sleep_enable();
+
+		/* The instruction after sei always executes before a pending
+		interrupt is serviced, so no wake up source can be missed between
+		enabling interrupts and sleeping. */
+		portENABLE_INTERRUPTS();
+		sleep_cpu();
+		sleep_disable();
+		portDISABLE_INTERRUPTS();
+
+		usCount = TCNT1;
+		if( ( ucTickInterruptFired != pdFALSE ) || ( ( TIFR1 & ( 1 << OCF1A ) ) != 0 ) )
+		{
+			/* The whole sleep elapsed.  The tick interrupt, run or pending,
+			accounts for the last tick period and restores the compare value. */
+			xCompleteTicks = xExpectedIdleTime - 1;
+		}
+		else
+		{
+			/* Another interrupt woke the CPU.  Count the whole periods that
+			passed and put the next match on the next tick boundary without
+			touching the counter.  If that boundary is too close to be sure the
+			counter has not passed it, count it as well and use the one after. */
+			xCompleteTicks = usCount / portTIMER_COUNTS_PER_TICK;
+			usBoundary = ( xCompleteTicks + 1 ) * portTIMER_COUNTS_PER_TICK - 1;
+			if( ( unsigned short ) ( usBoundary - usCount ) < 2 )
+			{
+				xCompleteTicks++;
+				usBoundary += portTIMER_COUNTS_PER_TICK;
+			}
+			OCR1A = usBoundary;
+		}
+
+		vTaskStepTick( xCompleteTicks );
+		portENABLE_INTERRUPTS();
+	}
+
+#endif
 
 
 	
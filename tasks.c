@@ -127,6 +127,7 @@ typedef struct tskTaskControlBlock
 
 	#if ( configGENERATE_RUN_TIME_STATS == 1 )
 		unsigned long ulRunTimeCounter;		/*< Used for calculating how much CPU time each task is utilising. */
+		unsigned long ulSwitchInCount;		/*< Number of times the task has been switched in from another task. */
 	#endif
 
 } tskTCB;
@@ -146,10 +147,28 @@ PRIVILEGED_DATA tskTCB * volatile pxCurrentTCB = NULL;
 /* Lists for ready and blocked tasks. --------------------*/
 
 PRIVILEGED_DATA static xList pxReadyTasksLists[ configMAX_PRIORITIES ];	/*< Prioritised ready tasks. */
-PRIVILEGED_DATA static xList xDelayedTaskList1;							/*< Delayed tasks. */
-PRIVILEGED_DATA static xList xDelayedTaskList2;							/*< Delayed tasks (two lists are used - one for delays that have overflowed the current tick count. */
-PRIVILEGED_DATA static xList * volatile pxDelayedTaskList ;				/*< Points to the delayed task list currently being used. */
-PRIVILEGED_DATA static xList * volatile pxOverflowDelayedTaskList;		/*< Points to the delayed task list currently being used to hold tasks that have overflowed the current tick count. */
+
+#if ( configUSE_TIMING_WHEEL == 1 )
+
+	#if ( ( configTIMING_WHEEL_SLOTS & ( configTIMING_WHEEL_SLOTS - 1 ) ) != 0 )
+		#error configTIMING_WHEEL_SLOTS must be a power of 2
+	#endif
+
+	#define tskWHEEL_MASK	( ( portTickType ) ( configTIMING_WHEEL_SLOTS - 1 ) )
+
+	PRIVILEGED_DATA static xList xDelayedWheel[ configTIMING_WHEEL_SLOTS ];	/*< Delayed tasks, hashed by wake time & tskWHEEL_MASK and unsorted within a slot. */
+	PRIVILEGED_DATA static portTickType xWheelTime = ( portTickType ) 0U;	/*< The last tick whose slot has been checked.  Lags xTickCount only after vTaskStepTick() lands on a wake time. */
+	PRIVILEGED_DATA static portBASE_TYPE xNextTaskUnblockTimeValid = pdTRUE;	/*< pdFALSE once the tick has reached xNextTaskUnblockTime, until prvGetExpectedIdleTime() searches the wheel again. */
+
+#else
+
+	PRIVILEGED_DATA static xList xDelayedTaskList1;							/*< Delayed tasks. */
+	PRIVILEGED_DATA static xList xDelayedTaskList2;							/*< Delayed tasks (two lists are used - one for delays that have overflowed the current tick count. */
+	PRIVILEGED_DATA static xList * volatile pxDelayedTaskList ;				/*< Points to the delayed task list currently being used. */
+	PRIVILEGED_DATA static xList * volatile pxOverflowDelayedTaskList;		/*< Points to the delayed task list currently being used to hold tasks that have overflowed the current tick count. */
+
+#endif
+
 PRIVILEGED_DATA static xList xPendingReadyList;							/*< Tasks that have been readied while the scheduler was suspended.  They will be moved to the ready queue when the scheduler is resumed. */
 
 #if ( INCLUDE_vTaskDelete == 1 )
@@ -189,6 +208,7 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
 	PRIVILEGED_DATA static char pcStatsString[ 50 ] ;
 	PRIVILEGED_DATA static unsigned long ulTaskSwitchedInTime = 0UL;	/*< Holds the value of a timer/counter the last time a task was switched in. */
 	static void prvGenerateRunTimeStatsForTasksInList( const signed char *pcWriteBuffer, xList *pxList, unsigned long ulTotalRunTime ) PRIVILEGED_FUNCTION;
+	static unsigned portBASE_TYPE prvRecordRunTimeForTasksInList( xTaskRunTimeRecord *pxRecords, unsigned portBASE_TYPE uxMaxRecords, xList *pxList, signed char cState ) PRIVILEGED_FUNCTION;
 
 #endif
 
@@ -218,14 +238,144 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
  * executing task has been rescheduled.
  */
 #define prvAddTaskToReadyQueue( pxTCB )																					\
-	traceMOVED_TASK_TO_READY_STATE( pxTCB )																				\
-	if( ( pxTCB )->uxPriority > uxTopReadyPriority )																	\
-	{																													\
-		uxTopReadyPriority = ( pxTCB )->uxPriority;																		\
-	}																													\
+	traceMOVED_TASK_TO_READY_STATE( pxTCB );																			\
+	taskRECORD_READY_PRIORITY( ( pxTCB )->uxPriority );																	\
 	vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ ( pxTCB )->uxPriority ] ), &( ( pxTCB )->xGenericListItem ) )
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_OPTIMISED_TASK_SELECTION == 0 )
+
+	/*
+	 * uxTopReadyPriority holds the highest priority that may have a ready
+	 * task.  It is raised as tasks are made ready and lowered lazily by
+	 * vTaskSwitchContext, which walks down past the empty ready lists.
+	 */
+	#define taskRECORD_READY_PRIORITY( uxPriority )																		\
+	{																													\
+		if( ( uxPriority ) > uxTopReadyPriority )																		\
+		{																												\
+			uxTopReadyPriority = ( uxPriority );																		\
+		}																												\
+	}
+
+	#define taskRESET_READY_PRIORITY( uxPriority )
+
+	#define taskSELECT_HIGHEST_PRIORITY_TASK()																			\
+	{																													\
+		/* Find the highest priority queue that contains ready tasks. */												\
+		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )										\
+		{																												\
+			configASSERT( uxTopReadyPriority );																			\
+			--uxTopReadyPriority;																						\
+		}																												\
+																														\
+		/* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the										\
+		same priority get an equal share of the processor time. */														\
+		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ) );						\
+	}
+
+#else /* configUSE_OPTIMISED_TASK_SELECTION */
+
+	#if ( configMAX_PRIORITIES > 8 )
+		#error configUSE_OPTIMISED_TASK_SELECTION supports at most 8 priorities
+	#endif
+
+	/*
+	 * uxTopReadyPriority is a bitmap with bit n set while
+	 * pxReadyTasksLists[ n ] is not empty.  The bit is cleared as soon as the
+	 * last task leaves a ready list, so the highest priority with a ready task
+	 * is the highest set bit, found with one lookup in a nibble table.  Shifts
+	 * by a variable amount are loops on the AVR, so the bit masks come from a
+	 * table too, and selection takes the same time whatever priorities are in
+	 * use.
+	 */
+	static const unsigned char ucPriorityBit[ 8 ] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+	static const unsigned char ucHighestBitInNibble[ 16 ] = { 0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 };
+
+	#define taskRECORD_READY_PRIORITY( uxPriority )																		\
+		uxTopReadyPriority |= ucPriorityBit[ ( uxPriority ) ]
+
+	#define taskRESET_READY_PRIORITY( uxPriority )																		\
+	{																													\
+		if( listLIST_IS_EMPTY( &( pxReadyTasksLists[ ( uxPriority ) ] ) ) )												\
+		{																												\
+			uxTopReadyPriority &= ( unsigned portBASE_TYPE ) ~ucPriorityBit[ ( uxPriority ) ];							\
+		}																												\
+	}
+
+	#define taskSELECT_HIGHEST_PRIORITY_TASK()																			\
+	{																													\
+	unsigned portBASE_TYPE uxTopPriority;																				\
+																														\
+		/* The idle task is always ready, so at least bit 0 is set. */													\
+		configASSERT( uxTopReadyPriority );																				\
+		if( ( uxTopReadyPriority & 0xf0U ) != 0 )																		\
+		{																												\
+			uxTopPriority = 4U + ucHighestBitInNibble[ ( uxTopReadyPriority >> 4 ) & 0x0fU ];							\
+		}																												\
+		else																											\
+		{																												\
+			uxTopPriority = ucHighestBitInNibble[ uxTopReadyPriority & 0x0fU ];										\
+		}																												\
+		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopPriority ] ) );							\
+	}
+
+#endif /* configUSE_OPTIMISED_TASK_SELECTION */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TIMING_WHEEL == 1 )
+
+/*
+ * Macro that looks at the wheel slot of each tick since the last call to see
+ * if any delayed task is due to wake.
+ *
+ * A task delayed until tick t is in slot t & tskWHEEL_MASK, along with tasks
+ * due a multiple of configTIMING_WHEEL_SLOTS ticks earlier or later, so only
+ * the items whose wake time is exactly the tick are removed.  Comparing for
+ * equality rather than order is what makes the wheel immune to the tick count
+ * overflow.  One slot is checked per tick, or two when vTaskStepTick() has
+ * left the slot of the tick it stepped to.
+ */
+#define prvCheckDelayedTasks()															\
+{																						\
+xList *pxSlot;																			\
+xListItem *pxItem, *pxNextItem;															\
+																						\
+	while( xWheelTime != xTickCount )													\
+	{																					\
+		++xWheelTime;																	\
+		pxSlot = &( xDelayedWheel[ xWheelTime & tskWHEEL_MASK ] );						\
+		pxItem = ( xListItem * ) pxSlot->xListEnd.pxNext;								\
+		while( pxItem != ( xListItem * ) &( pxSlot->xListEnd ) )						\
+		{																				\
+			pxNextItem = ( xListItem * ) pxItem->pxNext;								\
+			if( listGET_LIST_ITEM_VALUE( pxItem ) == xWheelTime )						\
+			{																			\
+				/* It is time to remove the item from the Blocked state. */				\
+				pxTCB = ( tskTCB * ) pxItem->pvOwner;									\
+				vListRemove( pxItem );													\
+																						\
+				/* Is the task waiting on an event also? */								\
+				if( pxTCB->xEventListItem.pvContainer != NULL )							\
+				{																		\
+					vListRemove( &( pxTCB->xEventListItem ) );							\
+				}																		\
+				prvAddTaskToReadyQueue( pxTCB );										\
+			}																			\
+			pxItem = pxNextItem;														\
+		}																				\
+																						\
+		if( xWheelTime == xNextTaskUnblockTime )										\
+		{																				\
+			/* Finding the next wake time means searching every slot, so it			\
+			is left to the idle task, which only needs it to sleep. */				\
+			xNextTaskUnblockTimeValid = pdFALSE;										\
+		}																				\
+	}																					\
+}
+
+#else
+
 /*
  * Macro that looks at the list of tasks that are currently delayed to see if
  * any require waking.
@@ -285,6 +435,8 @@ portTickType xItemValue;																\
 		}																				\
 	}																					\
 }
+
+#endif /* configUSE_TIMING_WHEEL */
 /*-----------------------------------------------------------*/
 
 /*
@@ -384,6 +536,28 @@ static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TY
 
 #endif
 
+/*
+ * Return the number of tick periods that will pass before a task is due to
+ * leave the Blocked state, or 0 if the tick must not be suppressed because a
+ * task other than the idle task can run.  Only meaningful when called from
+ * the idle task.
+ */
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	static portTickType prvGetExpectedIdleTime( void ) PRIVILEGED_FUNCTION;
+
+#endif
+
+/*
+ * Searches the timing wheel for the nearest wake time and stores it in
+ * xNextTaskUnblockTime.
+ */
+#if ( ( configUSE_TIMING_WHEEL == 1 ) && ( configUSE_TICKLESS_IDLE != 0 ) )
+
+	static void prvResetNextTaskUnblockTime( void ) PRIVILEGED_FUNCTION;
+
+#endif
+
 
 /*lint +e956 */
 
@@ -579,6 +753,7 @@ tskTCB * pxNewTCB;
 			the termination list and free up any memory allocated by the
 			scheduler for the TCB and stack. */
 			vListRemove( &( pxTCB->xGenericListItem ) );
+			taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 			/* Is the task waiting on an event also? */
 			if( pxTCB->xEventListItem.pvContainer != NULL )
@@ -671,6 +846,7 @@ tskTCB * pxNewTCB;
 				ourselves to the blocked list as the same list item is used for
 				both lists. */
 				vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 				prvAddCurrentTaskToDelayedList( xTimeToWake );
 			}
 		}
@@ -717,6 +893,7 @@ tskTCB * pxNewTCB;
 				ourselves to the blocked list as the same list item is used for
 				both lists. */
 				vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 				prvAddCurrentTaskToDelayedList( xTimeToWake );
 			}
 			xAlreadyYielded = xTaskResumeAll();
@@ -848,6 +1025,7 @@ tskTCB * pxNewTCB;
 					it to it's new ready list.  As we are in a critical section we
 					can do this even if the scheduler is suspended. */
 					vListRemove( &( pxTCB->xGenericListItem ) );
+					taskRESET_READY_PRIORITY( uxCurrentPriority );
 					prvAddTaskToReadyQueue( pxTCB );
 				}
 
@@ -885,6 +1063,7 @@ tskTCB * pxNewTCB;
 
 			/* Remove task from the ready/delayed list and place in the	suspended list. */
 			vListRemove( &( pxTCB->xGenericListItem ) );
+			taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 			/* Is the task waiting on an event also? */
 			if( pxTCB->xEventListItem.pvContainer != NULL )
@@ -1305,15 +1484,31 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 				}
 			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
 
-			if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+			#if ( configUSE_TIMING_WHEEL == 1 )
 			{
-				prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, tskBLOCKED_CHAR );
-			}
+			unsigned portBASE_TYPE uxSlot;
 
-			if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				for( uxSlot = 0U; uxSlot < configTIMING_WHEEL_SLOTS; uxSlot++ )
+				{
+					if( listLIST_IS_EMPTY( &( xDelayedWheel[ uxSlot ] ) ) == pdFALSE )
+					{
+						prvListTaskWithinSingleList( pcWriteBuffer, &( xDelayedWheel[ uxSlot ] ), tskBLOCKED_CHAR );
+					}
+				}
+			}
+			#else
 			{
-				prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, tskBLOCKED_CHAR );
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, tskBLOCKED_CHAR );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, tskBLOCKED_CHAR );
+				}
 			}
+			#endif
 
 			#if( INCLUDE_vTaskDelete == 1 )
 			{
@@ -1380,15 +1575,31 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 				}
 			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
 
-			if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+			#if ( configUSE_TIMING_WHEEL == 1 )
 			{
-				prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, ulTotalRunTime );
-			}
+			unsigned portBASE_TYPE uxSlot;
 
-			if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				for( uxSlot = 0U; uxSlot < configTIMING_WHEEL_SLOTS; uxSlot++ )
+				{
+					if( listLIST_IS_EMPTY( &( xDelayedWheel[ uxSlot ] ) ) == pdFALSE )
+					{
+						prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, &( xDelayedWheel[ uxSlot ] ), ulTotalRunTime );
+					}
+				}
+			}
+			#else
 			{
-				prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, ulTotalRunTime );
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, ulTotalRunTime );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, ulTotalRunTime );
+				}
 			}
+			#endif
 
 			#if ( INCLUDE_vTaskDelete == 1 )
 			{
@@ -1414,6 +1625,86 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 #endif
 /*----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+	unsigned portBASE_TYPE uxTaskGetRunTimeRecords( xTaskRunTimeRecord *pxRecords, unsigned portBASE_TYPE uxMaxRecords, unsigned long *pulTotalRunTime )
+	{
+	unsigned portBASE_TYPE uxQueue, uxCount = 0;
+
+		vTaskSuspendAll();
+		{
+			#ifdef portALT_GET_RUN_TIME_COUNTER_VALUE
+				portALT_GET_RUN_TIME_COUNTER_VALUE( *pulTotalRunTime );
+			#else
+				*pulTotalRunTime = portGET_RUN_TIME_COUNTER_VALUE();
+			#endif
+
+			/* Run through all the lists that could potentially contain a TCB,
+			in the same order as vTaskGetRunTimeStats(). */
+			uxQueue = uxTopUsedPriority + ( unsigned portBASE_TYPE ) 1U;
+
+			do
+			{
+				uxQueue--;
+
+				if( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxQueue ] ) ) == pdFALSE )
+				{
+					uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, ( xList * ) &( pxReadyTasksLists[ uxQueue ] ), tskREADY_CHAR );
+				}
+			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
+
+			#if ( configUSE_TIMING_WHEEL == 1 )
+			{
+			unsigned portBASE_TYPE uxSlot;
+
+				for( uxSlot = 0U; uxSlot < configTIMING_WHEEL_SLOTS; uxSlot++ )
+				{
+					if( listLIST_IS_EMPTY( &( xDelayedWheel[ uxSlot ] ) ) == pdFALSE )
+					{
+						uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, &( xDelayedWheel[ uxSlot ] ), tskBLOCKED_CHAR );
+					}
+				}
+			}
+			#else
+			{
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, ( xList * ) pxDelayedTaskList, tskBLOCKED_CHAR );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, ( xList * ) pxOverflowDelayedTaskList, tskBLOCKED_CHAR );
+				}
+			}
+			#endif
+
+			#if ( INCLUDE_vTaskDelete == 1 )
+			{
+				if( listLIST_IS_EMPTY( &xTasksWaitingTermination ) == pdFALSE )
+				{
+					uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, &xTasksWaitingTermination, tskDELETED_CHAR );
+				}
+			}
+			#endif
+
+			#if ( INCLUDE_vTaskSuspend == 1 )
+			{
+				if( listLIST_IS_EMPTY( &xSuspendedTaskList ) == pdFALSE )
+				{
+					uxCount += prvRecordRunTimeForTasksInList( &( pxRecords[ uxCount ] ), uxMaxRecords - uxCount, &xSuspendedTaskList, tskSUSPENDED_CHAR );
+				}
+			}
+			#endif
+		}
+		xTaskResumeAll();
+
+		return uxCount;
+	}
+
+#endif
+/*----------------------------------------------------------*/
+
 #if ( INCLUDE_xTaskGetIdleTaskHandle == 1 )
 
 	xTaskHandle xTaskGetIdleTaskHandle( void )
@@ -1441,6 +1732,14 @@ tskTCB * pxTCB;
 	if( uxSchedulerSuspended == ( unsigned portBASE_TYPE ) pdFALSE )
 	{
 		++xTickCount;
+		#if ( configUSE_TIMING_WHEEL == 1 )
+		if( xTickCount == ( portTickType ) 0U )
+		{
+			/* The wheel does not depend on the order of tick values, so the
+			overflow is only counted, for xTaskCheckForTimeOut(). */
+			xNumOfOverflows++;
+		}
+		#else
 		if( xTickCount == ( portTickType ) 0U )
 		{
 			xList *pxTemp;
@@ -1474,6 +1773,7 @@ tskTCB * pxTCB;
 				xNextTaskUnblockTime = listGET_LIST_ITEM_VALUE( &( pxTCB->xGenericListItem ) );
 			}
 		}
+		#endif
 
 		/* See if this tick has made a timeout expire. */
 		prvCheckDelayedTasks();
@@ -1506,6 +1806,81 @@ tskTCB * pxTCB;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	void vTaskStepTick( portTickType xTicksToJump )
+	{
+		/* Correct the tick count value after a period during which the tick
+		was suppressed.  The port never sleeps past xNextTaskUnblockTime, which
+		is at most portMAX_DELAY, so this cannot step over a tick count
+		overflow (and with it the delayed list swap).  The tick hook is not
+		called for the stepped ticks. */
+		#if ( configUSE_TIMING_WHEEL == 1 )
+		{
+			/* No task wakes before xNextTaskUnblockTime, so the slots stepped
+			over need no checking, except the last one if the step lands on
+			xNextTaskUnblockTime: that is left to the next tick. */
+			configASSERT( xNextTaskUnblockTimeValid != pdFALSE );
+			configASSERT( xTicksToJump <= ( portTickType ) ( xNextTaskUnblockTime - xTickCount ) );
+			xTickCount += xTicksToJump;
+			xWheelTime = xTickCount;
+			if( xWheelTime == xNextTaskUnblockTime )
+			{
+				xWheelTime--;
+			}
+		}
+		#else
+		{
+			configASSERT( ( xTickCount + xTicksToJump ) <= xNextTaskUnblockTime );
+			xTickCount += xTicksToJump;
+		}
+		#endif
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	portTickType xTaskGetExpectedIdleTime( void )
+	{
+		/* For ports that step time themselves rather than from the idle
+		task, e.g. a simulator with no timer. */
+		return prvGetExpectedIdleTime();
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	eSleepModeStatus eTaskConfirmSleepModeStatus( void )
+	{
+	eSleepModeStatus eReturn = eStandardSleep;
+
+		if( listCURRENT_LIST_LENGTH( &xPendingReadyList ) != 0 )
+		{
+			/* A task was made ready while the scheduler was suspended. */
+			eReturn = eAbortSleep;
+		}
+		else if( xMissedYield != pdFALSE )
+		{
+			/* A yield was pended while the scheduler was suspended. */
+			eReturn = eAbortSleep;
+		}
+		else if( uxMissedTicks != ( unsigned portBASE_TYPE ) 0U )
+		{
+			/* A tick arrived while the scheduler was suspended, so xTickCount
+			is behind the time the expected idle time was measured from. */
+			eReturn = eAbortSleep;
+		}
+
+		return eReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 #if ( configUSE_APPLICATION_TASK_TAG == 1 )
 
 	void vTaskSetApplicationTaskTag( xTaskHandle xTask, pdTASK_HOOK_CODE pxHookFunction )
@@ -1603,6 +1978,10 @@ void vTaskSwitchContext( void )
 	}
 	else
 	{
+		#if ( configGENERATE_RUN_TIME_STATS == 1 )
+			tskTCB *pxPreviousTCB = pxCurrentTCB;
+		#endif
+
 		traceTASK_SWITCHED_OUT();
 	
 		#if ( configGENERATE_RUN_TIME_STATS == 1 )
@@ -1628,16 +2007,17 @@ void vTaskSwitchContext( void )
 		taskFIRST_CHECK_FOR_STACK_OVERFLOW();
 		taskSECOND_CHECK_FOR_STACK_OVERFLOW();
 	
-		/* Find the highest priority queue that contains ready tasks. */
-		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )
+		taskSELECT_HIGHEST_PRIORITY_TASK();
+
+		#if ( configGENERATE_RUN_TIME_STATS == 1 )
 		{
-			configASSERT( uxTopReadyPriority );
-			--uxTopReadyPriority;
+			/* The tick calls this every period; only count real switches. */
+			if( pxCurrentTCB != pxPreviousTCB )
+			{
+				pxCurrentTCB->ulSwitchInCount++;
+			}
 		}
-	
-		/* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the
-		same priority get an equal share of the processor time. */
-		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ) );
+		#endif
 	
 		traceTASK_SWITCHED_IN();
 	}
@@ -1662,6 +2042,7 @@ portTickType xTimeToWake;
 	to the blocked list as the same list item is used for both lists.  We have
 	exclusive access to the ready lists as the scheduler is locked. */
 	vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+	taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 
 
 	#if ( INCLUDE_vTaskSuspend == 1 )
@@ -1716,6 +2097,7 @@ portTickType xTimeToWake;
 		blocked list as the same list item is used for both lists.  This
 		function is called form a critical section. */
 		vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+		taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 
 		/* Calculate the time at which the task should be woken if the event does
 		not occur.  This may overflow but this doesn't matter. */
@@ -1933,8 +2315,116 @@ static portTASK_FUNCTION( prvIdleTask, pvParameters )
 			//vApplicationIdleHookvApplicationIdleHook();
 		}
 		#endif
+
+		#if ( configUSE_TICKLESS_IDLE != 0 )
+		{
+		portTickType xExpectedIdleTime;
+
+			/* It is not desirable to suspend then resume the scheduler on
+			each iteration of the idle task.  Therefore, a preliminary test of
+			the expected idle time is performed without the scheduler
+			suspended.  The result here is not necessarily valid. */
+			xExpectedIdleTime = prvGetExpectedIdleTime();
+
+			if( xExpectedIdleTime >= configEXPECTED_IDLE_TIME_BEFORE_SLEEP )
+			{
+				vTaskSuspendAll();
+				{
+					/* Now the scheduler is suspended, the expected idle
+					time can be sampled again, and this time its value can
+					be used. */
+					xExpectedIdleTime = prvGetExpectedIdleTime();
+
+					if( xExpectedIdleTime >= configEXPECTED_IDLE_TIME_BEFORE_SLEEP )
+					{
+						portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime );
+					}
+				}
+				xTaskResumeAll();
+			}
+		}
+		#endif
 	}
 } /*lint !e715 pvParameters is not accessed but all task functions require the same prototype. */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	static portTickType prvGetExpectedIdleTime( void )
+	{
+	portTickType xReturn;
+
+		if( pxCurrentTCB->uxPriority > tskIDLE_PRIORITY )
+		{
+			xReturn = 0;
+		}
+		else if( listCURRENT_LIST_LENGTH( &( pxReadyTasksLists[ tskIDLE_PRIORITY ] ) ) > 1 )
+		{
+			/* There are other idle priority tasks in the ready state.  The
+			next tick interrupt must be processed to time slice them. */
+			xReturn = 0;
+		}
+		else
+		{
+			#if ( configUSE_TIMING_WHEEL == 1 )
+			{
+				if( xNextTaskUnblockTimeValid == pdFALSE )
+				{
+					prvResetNextTaskUnblockTime();
+				}
+				xReturn = ( portTickType ) ( xNextTaskUnblockTime - xTickCount );
+			}
+			#else
+			{
+				xReturn = xNextTaskUnblockTime - xTickCount;
+			}
+			#endif
+		}
+
+		return xReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( ( configUSE_TIMING_WHEEL == 1 ) && ( configUSE_TICKLESS_IDLE != 0 ) )
+
+	static void prvResetNextTaskUnblockTime( void )
+	{
+	unsigned portBASE_TYPE uxSlot;
+	xList *pxSlot;
+	xListItem *pxItem;
+	portTickType xDistance, xNearest;
+
+		/* Wake times are compared by their distance from now, which the tick
+		count overflow does not upset.  With no task delayed the result is as
+		far away as a block time can be. */
+		xNearest = portMAX_DELAY;
+
+		taskENTER_CRITICAL();
+		{
+			for( uxSlot = 0U; uxSlot < configTIMING_WHEEL_SLOTS; uxSlot++ )
+			{
+				pxSlot = &( xDelayedWheel[ uxSlot ] );
+				pxItem = ( xListItem * ) pxSlot->xListEnd.pxNext;
+				while( pxItem != ( xListItem * ) &( pxSlot->xListEnd ) )
+				{
+					xDistance = ( portTickType ) ( listGET_LIST_ITEM_VALUE( pxItem ) - xTickCount );
+					if( xDistance < xNearest )
+					{
+						xNearest = xDistance;
+					}
+					pxItem = ( xListItem * ) pxItem->pxNext;
+				}
+			}
+
+			xNextTaskUnblockTime = ( portTickType ) ( xTickCount + xNearest );
+			xNextTaskUnblockTimeValid = pdTRUE;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+#endif
 
 
 
@@ -1999,6 +2489,7 @@ static void prvInitialiseTCBVariables( tskTCB *pxTCB, const signed char * const
 	#if ( configGENERATE_RUN_TIME_STATS == 1 )
 	{
 		pxTCB->ulRunTimeCounter = 0UL;
+		pxTCB->ulSwitchInCount = 0UL;
 	}
 	#endif
 
@@ -2043,8 +2534,19 @@ unsigned portBASE_TYPE uxPriority;
 		vListInitialise( ( xList * ) &( pxReadyTasksLists[ uxPriority ] ) );
 	}
 
-	vListInitialise( ( xList * ) &xDelayedTaskList1 );
-	vListInitialise( ( xList * ) &xDelayedTaskList2 );
+	#if ( configUSE_TIMING_WHEEL == 1 )
+	{
+		for( uxPriority = ( unsigned portBASE_TYPE ) 0U; uxPriority < configTIMING_WHEEL_SLOTS; uxPriority++ )
+		{
+			vListInitialise( &( xDelayedWheel[ uxPriority ] ) );
+		}
+	}
+	#else
+	{
+		vListInitialise( ( xList * ) &xDelayedTaskList1 );
+		vListInitialise( ( xList * ) &xDelayedTaskList2 );
+	}
+	#endif
 	vListInitialise( ( xList * ) &xPendingReadyList );
 
 	#if ( INCLUDE_vTaskDelete == 1 )
@@ -2059,10 +2561,14 @@ unsigned portBASE_TYPE uxPriority;
 	}
 	#endif
 
-	/* Start with pxDelayedTaskList using list1 and the pxOverflowDelayedTaskList
-	using list2. */
-	pxDelayedTaskList = &xDelayedTaskList1;
-	pxOverflowDelayedTaskList = &xDelayedTaskList2;
+	#if ( configUSE_TIMING_WHEEL == 0 )
+	{
+		/* Start with pxDelayedTaskList using list1 and the pxOverflowDelayedTaskList
+		using list2. */
+		pxDelayedTaskList = &xDelayedTaskList1;
+		pxOverflowDelayedTaskList = &xDelayedTaskList2;
+	}
+	#endif
 }
 /*-----------------------------------------------------------*/
 
@@ -2101,6 +2607,26 @@ static void prvCheckTasksWaitingTermination( void )
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TIMING_WHEEL == 1 )
+
+static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake )
+{
+	/* The list item value is the wake time, which prvCheckDelayedTasks()
+	looks for in the slot. */
+	listSET_LIST_ITEM_VALUE( &( pxCurrentTCB->xGenericListItem ), xTimeToWake );
+	vListInsertEnd( &( xDelayedWheel[ xTimeToWake & tskWHEEL_MASK ] ), &( pxCurrentTCB->xGenericListItem ) );
+
+	/* Keep xNextTaskUnblockTime no later than the nearest wake time while it
+	is valid.  Both are compared by their distance from now. */
+	if( ( xNextTaskUnblockTimeValid != pdFALSE ) &&
+		( ( portTickType ) ( xTimeToWake - xTickCount ) < ( portTickType ) ( xNextTaskUnblockTime - xTickCount ) ) )
+	{
+		xNextTaskUnblockTime = xTimeToWake;
+	}
+}
+
+#else
+
 static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake )
 {
 	/* The list item will be inserted in wake time order. */
@@ -2125,6 +2651,8 @@ static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake )
 		}
 	}
 }
+
+#endif /* configUSE_TIMING_WHEEL */
 /*-----------------------------------------------------------*/
 
 static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer )
@@ -2262,6 +2790,53 @@ tskTCB *pxNewTCB;
 #endif
 /*-----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+	static unsigned portBASE_TYPE prvRecordRunTimeForTasksInList( xTaskRunTimeRecord *pxRecords, unsigned portBASE_TYPE uxMaxRecords, xList *pxList, signed char cState )
+	{
+	volatile tskTCB *pxNextTCB, *pxFirstTCB;
+	unsigned portBASE_TYPE uxCount = 0;
+
+		/* Copy the run time figures of the TCB's in pxList into pxRecords. */
+		listGET_OWNER_OF_NEXT_ENTRY( pxFirstTCB, pxList );
+		do
+		{
+			/* Get next TCB in from the list. */
+			listGET_OWNER_OF_NEXT_ENTRY( pxNextTCB, pxList );
+
+			if( uxCount < uxMaxRecords )
+			{
+				memcpy( ( void * ) pxRecords[ uxCount ].pcTaskName, ( const void * ) pxNextTCB->pcTaskName, configMAX_TASK_NAME_LEN );
+				pxRecords[ uxCount ].ulRunTimeCounter = pxNextTCB->ulRunTimeCounter;
+				pxRecords[ uxCount ].ulSwitchInCount = pxNextTCB->ulSwitchInCount;
+				pxRecords[ uxCount ].ucPriority = ( unsigned char ) pxNextTCB->uxPriority;
+				pxRecords[ uxCount ].cState = cState;
+
+				#if ( INCLUDE_uxTaskGetStackHighWaterMark == 1 )
+				{
+					#if portSTACK_GROWTH < 0
+						pxRecords[ uxCount ].usStackHighWaterMark = usTaskCheckFreeStackSpace( ( unsigned char * ) pxNextTCB->pxStack );
+					#else
+						pxRecords[ uxCount ].usStackHighWaterMark = usTaskCheckFreeStackSpace( ( unsigned char * ) pxNextTCB->pxEndOfStack );
+					#endif
+				}
+				#else
+				{
+					pxRecords[ uxCount ].usStackHighWaterMark = 0U;
+				}
+				#endif
+
+				uxCount++;
+			}
+
+		} while( pxNextTCB != pxFirstTCB );
+
+		return uxCount;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 #if ( ( configUSE_TRACE_FACILITY == 1 ) || ( INCLUDE_uxTaskGetStackHighWaterMark == 1 ) )
 
 	static unsigned short usTaskCheckFreeStackSpace( const unsigned char * pucStackByte )
@@ -2394,6 +2969,7 @@ tskTCB *pxNewTCB;
 			if( listIS_CONTAINED_WITHIN( &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) ) != pdFALSE )
 			{
 				vListRemove( &( pxTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 				/* Inherit the priority before being moved into the new list. */
 				pxTCB->uxPriority = pxCurrentTCB->uxPriority;
@@ -2425,6 +3001,7 @@ tskTCB *pxNewTCB;
 				/* We must be the running task to be able to give the mutex back.
 				Remove ourselves from the ready list we currently appear in. */
 				vListRemove( &( pxTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 				/* Disinherit the priority before adding the task into the new
 				ready list. */
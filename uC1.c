@@ -22,12 +22,25 @@
 #include "FreeRTOS.h" 
 #include "task.h" 
 #include "croutine.h" 
+#include "semphr.h" // Also pulls in the FreeRTOS queue.h (Includes/queue.h shares its guard)
 
 //Other include files
-#include "usart_ATmega1284.h"
-#include "keypad.h"
+// Room for the replies to a burst of commands at the Bluetooth module's 9600 baud
+#define USART0_TX_BUFFER_SIZE 128
+#include "usart_isr_ATmega1284.h"
+#include "link_protocol.h"
+#include "product_catalog.h"
+#define BT_MAX_ARGS LINK_MAX_PAYLOAD // An order goes to uC2 as one message
+#define BT_PRODUCTS CATALOG_SLOTS
+#include "bt_command.h"
+#include "adc_ATmega1284.h"
+#include "coin_detector.h"
+#include "keypad_isr.h"
 #include "lcd.h"
-#include "shiftreg.h" // For debugging purposes
+#include "shiftreg_spi.h" // For debugging purposes
+#include "runtime_stats.h"
+#include "trace_recorder.h" // Kernel trace hooks; no spare USART to stream on
+#include "sim_probe.h"
 
 // Global Functions
 void ADC_init() {
@@ -41,33 +54,52 @@ void ADC_init() {
 
 /*************************** List of State Machines ***************************
  * LED: State machine to handle IR LED input to detect coin passing through
- *   detection mechanism. Updates global variable coinReceived.
+ *   detection mechanism. Runs once per block of ADC samples collected by the
+ *   ADC ISR. Feeds the samples through a pulse detector and posts one EV_COIN
+ *   to eventQueue per coin.
  * 
  * Input_Logic: State machine to handle input from Bluetooth Module and keypad.
- *   Updates global variables productSelect and adminKey. Blocks further input
- *   after receiving until the system has successfully sent the signal to the
- *   second microcontroller.
+ *   Posts the product slot selected on the keypad to eventQueue. Takes
+ *   debounced key presses from the interrupt driven keypad scanner (see
+ *   keypad_isr.h), so a held key is one press and does not repeat. A slot
+ *   number is selected as soon as it cannot start a longer one in the
+ *   product catalog (see product_catalog.h), else on '#'.
+ *   Parses every byte the Bluetooth module has sent into command lines (see
+ *   bt_command.h) as soon as it wakes. Orders, status and price requests
+ *   go straight to the link as one message each; their answers come back
+ *   to Transmit. Passes a run-time statistics request (STATS) and parse
+ *   errors on to Transmit.
  *
- * Product_Logic: State machine to process information from both LED and Input_
- *   Logic state machines. Determines what encoded unsigned char value to send
- *   to second microcontroller. Updates global variable control.
+ * Product_Logic: State machine to process events from both LED and Input_
+ *   Logic state machines. Turns each event into a link message (coin inserted
+ *   or selection) for the second microcontroller.
  *
- * Transmit: State machine to send encoded unsigned char value to second 
- *   microcontroller via USART. Solely responsible for sending value when
- *   Product_Logic SM updates value.
+ * Transmit: State machine running the framed link to the second
+ *   microcontroller over USART1 (see link_protocol.h). Sends queued messages
+ *   reliably, in order, and reports balance and dispense results coming back
+ *   to the Bluetooth module. Also writes the run-time statistics dump, so
+ *   only this task writes to the Bluetooth module. Shows the type of the
+ *   last message sent on the debug shift register (see shiftreg_spi.h).
+ *
+ * Every task blocks on its input (ADC block, USART byte or queue) instead of
+ *   waking on a fixed period.
  */
 
- // Global Variables
- unsigned char coinReceived = 0;
- unsigned char productSelect = 0;
- unsigned char control = 0;
- // unsigned char AdminKey;
- unsigned char reset = 0;
+// Events posted to Product_Logic: EV_COIN, or the catalog slot selected
+enum VendEvent {EV_COIN};
+
+// Global Variables
+CoinDetector coinDetector;
+xQueueHandle eventQueue;	// LED, Input_Logic -> Product_Logic (VendEvent)
+Link link;					// Product_Logic -> Transmit -> second microcontroller
+volatile unsigned char statsRequested;	// Input_Logic -> Transmit: send RunTime_Dump
+BtParser btParser;						// Bluetooth command lines
+volatile unsigned char commandErrors[BT_ERR_RANGE + 1];	// Input_Logic -> Transmit: bad lines per BT_ERR_ code
 
-enum LEDState {IR_INIT,IR_READ/*,IR_WAIT*/} led_state;
-enum INState {IN_INIT,IN_RECEIVE,IN_SELECT1,IN_SELECT2,IN_BLOCK} in_state;
+enum LEDState {IR_INIT,IR_READ} led_state;
+enum INState {IN_INIT,IN_RECEIVE,IN_SELECT} in_state;
 enum PLState {PL_INIT,PL_UPDATE} pl_state;
-enum TRState {TR_INIT,TR_CHECKUPDATE,TR_TRANSMIT,TR_RESET} tr_state;
+enum TRState {TR_INIT,TR_TRANSMIT} tr_state;
 
 void LEDS_Init(){
 	led_state = IR_INIT;
@@ -85,31 +117,21 @@ void TR_Init(){
 	tr_state = TR_INIT;
 }
 
-void LEDS_Tick(){
+void LEDS_Tick(const volatile unsigned short* samples){
 	//Local vars
-	static unsigned short irVal = 0;
-	static unsigned char str[10];
+	unsigned char coins, event = EV_COIN;
 	//Actions
 	switch(led_state){
 		case IR_INIT:
-			coinReceived = 0;
+			// Beam is assumed unblocked at power up
+			CoinDetector_Init(&coinDetector, samples[0]);
 			break;
 		case IR_READ:
-			irVal = ADC;
-			sprintf(str, "%d", ADC);
-			LCD_AppendString(1, str);
-			if (irVal > 900) {
-				coinReceived = 0;
-				/*LCD_AppendString(17, "No coin");*/
-			} else {
-				coinReceived = 1;
-				/*LCD_AppendString(17, "Coin in");*/
+			coins = CoinDetector_FeedBlock(&coinDetector, samples, ADC_BLOCK_SIZE);
+			while (coins--) {
+				xQueueSend(eventQueue, &event, 0);
 			}
-			/*LCD_AppendString(5, "1R");*/
 			break;
-// 		case IR_WAIT:
-// 			LCD_AppendString(5, "1W");
-// 			break;
 		default:
 			break;
 	}
@@ -119,49 +141,87 @@ void LEDS_Tick(){
 			led_state = IR_READ;
 			break;
 		case IR_READ:
-// 			if(coinReceived)
-// 				led_state = IR_WAIT;
-// 			else
-				led_state = IR_READ;
-			break;
-// 		case IR_WAIT:
-// 			if(reset) {
-// 				coinReceived = 0;
-// 				led_state = IR_READ;
-// 				/*LCD_AppendString(5, "1R");*/
-// 			} else {
-// 				led_state = IR_WAIT;
-// 				/*LCD_AppendString(5, "1W");*/
-// 			}
-// 			break;
+			led_state = IR_READ;
+			break;
 		default:
 			led_state = IR_INIT;
 			break;
 	}
 }
 
+// Queues a message for the second microcontroller, waiting for room
+void UC2_Send(unsigned char type, const unsigned char* data, unsigned char len){
+	// The link resends until uC2 answers, so its queue only fills while
+	// uC2 is down; wait it out
+	while (!Link_Send(&link, type, data, len)) {
+		vTaskDelay(1);
+	}
+}
+
+// Acts on a command line from the Bluetooth module
+void IN_Command(const BtCommand* cmd){
+	switch(cmd->type){
+		case BT_ORDER:
+			UC2_Send(LINK_SELECTION, cmd->args, cmd->count);
+			break;
+		case BT_STATUS:
+			UC2_Send(LINK_STATUS_REQUEST, 0, 0);
+			break;
+		case BT_PRICE:
+			UC2_Send(LINK_PRICE_REQUEST, cmd->args, 1);
+			break;
+		case BT_STATS:
+			statsRequested = 1;
+			USART_WakeWaiter(1); // Wake Transmit out of Link_Service
+			break;
+		case BT_ERROR:
+			if (cmd->args[0] <= BT_ERR_RANGE) {
+				commandErrors[cmd->args[0]]++; // Only this task writes them
+			}
+			USART_WakeWaiter(1);
+			break;
+		default:
+			break;
+	}
+}
+
 void IN_Tick(){
 	//Local vars
-	static unsigned char inputKey,BTinput;
+	static unsigned char inputSlot;
+	static unsigned short entry;	// Slot number keyed in so far
+	unsigned char data;
+	KeyEvent key;
+	BtCommand cmd;
 	//Actions
 	switch(in_state){
 		case IN_INIT:
-			productSelect = 0;
-			inputKey = 0;
-			BTinput = 0;
+			inputSlot = 0;
+			entry = 0;
+			BtParser_Init(&btParser);
 			break;
 		case IN_RECEIVE:
-			if(USART_HasReceived(0))
-				BTinput = USART_Receive(0);
-			inputKey = GetKeypadKey();
-			break;
-		case IN_SELECT1:
-			productSelect = 1;
-			break;
-		case IN_SELECT2:
-			productSelect = 2;
+			inputSlot = 0;
+			while (USART_Read(0, &data)) {
+				if (BtParser_Feed(&btParser, data, &cmd) != BT_NONE)
+					IN_Command(&cmd);
+			}
+			if (Keypad_Read(&key) && key.pressed) {
+				if (key.key >= '0' && key.key <= '9') {
+					entry = entry * 10 + (key.key - '0');
+					if (entry * 10 > CATALOG_SLOTS) { // Cannot start a longer slot number
+						inputSlot = (entry <= CATALOG_SLOTS) ? entry : 0;
+						entry = 0;
+					}
+				} else if (key.key == '#') {
+					inputSlot = entry;
+					entry = 0;
+				} else {
+					entry = 0; // Any other key starts again
+				}
+			}
 			break;
-		case IN_BLOCK:
+		case IN_SELECT:
+			xQueueSend(eventQueue, &inputSlot, 0);
 			break;
 		default:
 			break;
@@ -172,27 +232,13 @@ void IN_Tick(){
 			in_state = IN_RECEIVE;
 			break;
 		case IN_RECEIVE:
-			if (inputKey == '1' || BTinput == '1')
-				in_state = IN_SELECT1;
-			else if (inputKey == '2' || BTinput == '2')
-				in_state = IN_SELECT2;
+			if (Catalog_Price(inputSlot))
+				in_state = IN_SELECT;
 			else
 				in_state = IN_RECEIVE;
 			break;
-		case IN_SELECT1:
-			in_state = IN_BLOCK;
-			break;
-		case IN_SELECT2:
-			in_state = IN_BLOCK;
-			break;
-		case IN_BLOCK:
-			if (reset) {
-				in_state = IN_RECEIVE;
-				productSelect = 0;
-				BTinput = 0;
-			} else {
-				in_state = IN_BLOCK;
-			}
+		case IN_SELECT:
+			in_state = IN_RECEIVE;
 			break;
 		default:
 			in_state = IN_INIT;
@@ -200,27 +246,16 @@ void IN_Tick(){
 	}
 }
 
-void PL_Tick(){
+void PL_Tick(unsigned char event){
 	//Actions
 	switch(pl_state){
 		case PL_INIT:
-			control = 0;
 			break;
 		case PL_UPDATE:
-			if (coinReceived) {
-				control |= 0x01; // Set bit 0 high to indicate a coin has been received
+			if (event == EV_COIN) {
+				UC2_Send(LINK_COIN_INSERTED, 0, 0);
 			} else {
-				control &= 0xFE; // Set bit 0 low to indicate no coin received
-			}
-			switch(productSelect){
-				case 0: control &= 0xF9; break;
-				case 1: 
-					control |= 0x02; // Set bit 1 high to indicate product1 selected
-					break;
-				case 2:
-					control |= 0x04; // Set bit 2 high to indicate product2 selected
-					break;
-				default: control &= 0xF9; break;
+				UC2_Send(LINK_SELECTION, &event, 1); // The slot selected
 			}
 			break;
 		default:
@@ -240,21 +275,99 @@ void PL_Tick(){
 	}
 }
 
+// Replies to command lines that could not be parsed, by BT_ERR_ code
+const char* const btErrorNames[] = {"", "UNKNOWN", "SYNTAX", "ARGS", "RANGE"};
+
+// Queues a string for the Bluetooth module, dropping rather than stalling
+void BT_WriteString(const char* str){
+	while (*str) {
+		USART_Put(0, *str++);
+	}
+}
+
+// Queues a number for the Bluetooth module in decimal
+void BT_WriteNumber(unsigned char n){
+	if (n >= 100)
+		USART_Put(0, '0' + n / 100);
+	if (n >= 10)
+		USART_Put(0, '0' + n / 10 % 10);
+	USART_Put(0, '0' + n % 10);
+}
+
+// Reports messages from uC2 to the Bluetooth module; runs in TransmitSecTask
+void TR_Deliver(const LinkMsg* msg){
+	switch(msg->type){
+		case LINK_BALANCE:
+			BT_WriteString("BAL ");
+			BT_WriteNumber(msg->data[0]);
+			BT_WriteString("\r\n");
+			break;
+		case LINK_STATUS:
+			BT_WriteString("STATUS BAL ");
+			BT_WriteNumber(msg->data[0]);
+			BT_WriteString(" QUEUED ");
+			BT_WriteNumber(msg->data[1]);
+			BT_WriteString("\r\n");
+			break;
+		case LINK_PRICE:
+			BT_WriteString("PRICE ");
+			BT_WriteNumber(msg->data[0]);
+			USART_Put(0, ' ');
+			if (msg->data[1])
+				BT_WriteNumber(msg->data[1]);
+			else
+				BT_WriteString("NONE");
+			BT_WriteString("\r\n");
+			break;
+		case LINK_DISPENSE_RESULT:
+			USART_Put(0, 'P');
+			BT_WriteNumber(msg->data[0]);
+			if (msg->data[1] == LINK_DISPENSE_OK)
+				BT_WriteString(" OK\r\n");
+			else if (msg->data[1] == LINK_DISPENSE_BUSY)
+				BT_WriteString(" BUSY\r\n");
+			else if (msg->data[1] == LINK_DISPENSE_JAMMED)
+				BT_WriteString(" JAMMED\r\n");
+			else
+				BT_WriteString(" NOFUNDS\r\n");
+			SIM_PROBE((msg->data[1] == LINK_DISPENSE_OK) ? SIM_PROBE_READY :
+					  (msg->data[1] == LINK_DISPENSE_JAMMED) ? SIM_PROBE_FAILED : SIM_PROBE_REFUSED);
+			break;
+		default:
+			break;
+	}
+}
+
 void TR_Tick(){
 	//Local vars
-	static unsigned char lastSent, delayCount;
+	static unsigned short lastSent;
+	static unsigned char errorsReported[BT_ERR_RANGE + 1];
+	unsigned char code;
 	//Actions
 	switch(tr_state){
 		case TR_INIT:
 			lastSent = 0;
-			delayCount = 0;
-			break;
-		case TR_CHECKUPDATE:
+			memcpy(errorsReported, (const void*)commandErrors, sizeof(errorsReported));
 			break;
 		case TR_TRANSMIT:
-			break;
-		case TR_RESET:
-			reset = 1;
+			Link_Service(&link); // Sleeps until there is link work to do
+			if (link.framesSent != lastSent) {
+				lastSent = link.framesSent;
+				ShiftReg_Write(0, link.pending.type); // Last message type sent
+			}
+			// One reply per bad line, however many came in since the last Tick
+			for (code = 1; code <= BT_ERR_RANGE; code++) {
+				while (errorsReported[code] != commandErrors[code]) {
+					BT_WriteString("ERR ");
+					BT_WriteString(btErrorNames[code]);
+					BT_WriteString("\r\n");
+					errorsReported[code]++;
+				}
+			}
+			if (statsRequested) {
+				statsRequested = 0;
+				RunTime_Dump(0);
+			}
 			break;
 		default:
 			break;
@@ -262,35 +375,10 @@ void TR_Tick(){
 	//Transitions
 	switch(tr_state){
 		case TR_INIT:
-			tr_state = TR_CHECKUPDATE;
-			break;
-		case TR_CHECKUPDATE:
-			if (lastSent != control) {
-				tr_state = TR_TRANSMIT;
-				lastSent = control;
-			} else {
-				tr_state = TR_CHECKUPDATE;
-			}
+			tr_state = TR_TRANSMIT;
 			break;
 		case TR_TRANSMIT:
-			if(USART_IsSendReady(1)) {
-				USART_Send(control,1);
-				tr_state = TR_RESET;
-				transmit_data(control);
-			} else {
-				tr_state = TR_TRANSMIT;
-			}
-			break;
-		case TR_RESET:
-			if (delayCount < 10) {
-				tr_state = TR_RESET;
-				delayCount++;
-			} else {
-				tr_state = TR_CHECKUPDATE;
-				reset = 0;
-				delayCount = 0;
-				/*LCD_AppendString(6, "0");*/
-			}
+			tr_state = TR_TRANSMIT;
 			break;
 		default:
 			tr_state = TR_INIT;
@@ -300,11 +388,16 @@ void TR_Tick(){
 
 void LedSecTask()
 {
+	const volatile unsigned short* samples;
 	LEDS_Init();
 	for(;;) 
 	{ 	
-		LEDS_Tick();
-		vTaskDelay(5); 
+		// Sleep until the ADC ISR has filled a block
+		samples = ADC_WaitForBlock(portMAX_DELAY);
+		if (samples) {
+			LEDS_Tick(samples);
+			ADC_ReleaseBlock();
+		}
 	} 
 }
 
@@ -314,17 +407,23 @@ void InputSecTask()
 	for(;;)
 	{
 		IN_Tick();
-		vTaskDelay(25);
+		// Sleeps until a Bluetooth byte or a key event; the keypad ISR gives
+		// the semaphore USART_WaitForData() sleeps on
+		if (in_state == IN_RECEIVE && !uxQueueMessagesWaiting(keypadQueue))
+			USART_WaitForData(0, portMAX_DELAY);
 	}
 }
 
 void ProductLogicSecTask()
 {
+	unsigned char event;
 	PL_Init();
+	PL_Tick(0);
 	for(;;)
 	{
-		PL_Tick();
-		vTaskDelay(50);
+		if (xQueueReceive(eventQueue, &event, portMAX_DELAY) == pdPASS) {
+			PL_Tick(event);
+		}
 	}
 }
 
@@ -334,32 +433,48 @@ void TransmitSecTask()
 	for(;;)
 	{
 		TR_Tick();
-		vTaskDelay(50);
 	}
 }
 
-void StartSecPulse(unsigned portBASE_TYPE Priority)
+// Returns 1 if every task was created, 0 if the heap ran out
+unsigned char StartSecPulse(unsigned portBASE_TYPE Priority)
 {
-	xTaskCreate(LedSecTask, (signed portCHAR *)"LedSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
-	xTaskCreate(InputSecTask, (signed portCHAR *)"InputSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
-	xTaskCreate(ProductLogicSecTask, (signed portCHAR *)"ProductLogicSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
-	xTaskCreate(TransmitSecTask, (signed portCHAR *)"TransmitSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
+	unsigned char created = 1;
+
+	created &= xTaskCreate(LedSecTask, (signed portCHAR *)"LedSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL ) == pdPASS;
+	created &= xTaskCreate(InputSecTask, (signed portCHAR *)"InputSecTask", configMINIMAL_STACK_SIZE * 2, NULL, Priority, NULL ) == pdPASS;
+	created &= xTaskCreate(ProductLogicSecTask, (signed portCHAR *)"ProductLogicSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL ) == pdPASS;
+	created &= xTaskCreate(TransmitSecTask, (signed portCHAR *)"TransmitSecTask", configMINIMAL_STACK_SIZE * 2, NULL, Priority, NULL ) == pdPASS;
+	return created;
 }	
  
 int main(void) 
 { 
+	unsigned char ready = 1;
+
 	DDRA = 0xC0; PORTA = 0x3F; // ADC input
-	DDRB = 0xFF; PORTB = 0x00; // For debugging
+	DDRB = 0xFF; PORTB = 0x00; // For debugging, SPI shift registers on PB4, PB5, PB7
 	DDRC = 0xF0; PORTC = 0x0F; // Keyboard hybrid
 	DDRD = 0xFF; PORTD = 0x00; // USART output
    
+	Timing_Init();
 	ADC_init();
-	initUSART(0);
-	initUSART(1);
+	ready &= ADC_SamplerInit();
+	ready &= USART_BufferedInit(0);
+	ready &= USART_BufferedInit(1);
+	ready &= Keypad_Init(USART_RxSemaphore(0));
+	ShiftReg_Init();
+	ready &= Link_Init(&link, 1, TR_Deliver);
 	LCD_init();
+	eventQueue = xQueueCreate(8, sizeof(unsigned char));
+	ready &= eventQueue != NULL;
 	
 	//Start Tasks  
-	StartSecPulse(1);
+	// Short of heap (configTOTAL_HEAP_SIZE): do not run at all rather than
+	// run without a queue or a task
+	if (!ready || !StartSecPulse(1)) {
+		return 1;
+	}
 	//RunSchedular 
 	vTaskStartScheduler(); 
  
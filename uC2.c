@@ -22,31 +22,98 @@
 #include "FreeRTOS.h" 
 #include "task.h" 
 #include "croutine.h" 
+#include "semphr.h" // Also pulls in the FreeRTOS queue.h (Includes/queue.h shares its guard)
 
 //Other include files
-#include "usart_ATmega1284.h"
-#include "lcd.h"
+// USART0 streams the trace (trace_recorder.h): 250000 baud (exact, UBRR 1)
+// and a TX buffer that holds a 30 event trace frame
+#define USART0_BAUD 250000
+#define USART0_TX_BUFFER_SIZE 128
+#include "usart_isr_ATmega1284.h"
+// Room for the results of a whole order (LINK_SELECTION) and the balance
+#define LINK_TX_QUEUE_LENGTH (LINK_MAX_PAYLOAD + 4)
+#include "link_protocol.h"
+#include "product_catalog.h"
+#define LEDGER_PRODUCTS CATALOG_SLOTS
+#include "eeprom_ledger.h"
+#include "lcd_buffer.h"
 #include "shiftreg.h" // For debugging purposes
+#include "runtime_stats.h"
+#include "periodic.h"
+#include "trace_recorder.h"
+#include "stepper.h"
+#define ADC_CHANNELS 2 // Drop beams
+#include "adc_ATmega1284.h"
+#include "coin_detector.h"
+#include "sim_probe.h"
 
 
 /************************* List of State Machines ****************************
- * Stepper_Driver: State machine to drive stepper motors in full-step drive to
- *   rotate coil to dispense an item if the machine has determined there is 
- *   enough money in the machine. Updates global variable motorRunning
+ * Dispense_Controller: State machine, one per motor, to dispense the orders
+ *   Product_Output queues in dispenseOrders for every purchase there is
+ *   enough money for, on the motor the product catalog gives for the slot
+ *   (see product_catalog.h). Turns the motor one coil rotation in full-step
+ *   drive on its channel of the stepper engine (see stepper.h), which steps
+ *   both motors at once from the Timer3 compare interrupt with acceleration
+ *   ramps. Watches the IR drop beam under the coil (ADC0 for motor 0, ADC1
+ *   for motor 1) with the coin pulse detector, as LEDS_Tick on the
+ *   first microcontroller does for coins, and stops the motor as soon as
+ *   the item falls. If nothing fell it turns RETRY_PHASES more, up to
+ *   MAX_RETRIES times, then gives up and refunds the price. Runs once per
+ *   block of ADC samples. Updates global variables motorRunning and
+ *   currentCoins and reports the dispense result over the link.
  * 
  * LCD_Logic: State machine to drive LCD screen to display information about
  *   the current status of the machine. Will display current amount of money
  *   the machine contains and will give feedback for when customer attempts
- *   to purchase an item.
+ *   to purchase an item. Draws into the LCD frame buffer; LCDBuf_FlushTask
+ *   writes the changed cells to the display at idle priority.
  *
- * Product_Output: State machine to process information from first 
- *   microcontroller and determines the validity of purchases. Updates global 
- *   variables productValid and currentCoins.
+ * Product_Output: State machine to process messages from first 
+ *   microcontroller and determines the validity of purchases. An order may
+ *   hold several products, bought in turn. Updates global variables
+ *   productStatus, productSlot and currentCoins and reports the balance
+ *   back. Also answers status and price requests.
+ *
+ * The credit, sales and dispenses in progress are journaled to EEPROM (see
+ *   eeprom_ledger.h) after every change by Ledger_Task at idle priority and
+ *   restored at reset; dispenses a reset cut off are refunded.
+ *
+ * The framed link to the first microcontroller (see link_protocol.h) runs in
+ *   its own task and hands received messages to Product_Output via
+ *   linkRxQueue.
+ *
+ * LCD_Logic and Product_Output are periodic tasks (see periodic.h),
+ *   released every 50 and 25 ms with rate monotonic priorities:
+ *   Product_Output above LCD_Logic.
+ *
+ * Trace_StreamTask owns USART0 at idle priority: it streams the kernel
+ *   trace when started with TRACE_START_REQUEST (see trace_recorder.h) and
+ *   answers run-time statistics requests (RUNTIME_REQUEST) and periodic
+ *   task statistics requests (PERIODIC_REQUEST) with a binary dump (see
+ *   runtime_stats.h and periodic.h).
  *
  */
 
 /************************* Global Functions *************************/
 
+void ADC_init() {
+	ADCSRA |= (1 << ADEN) | (1 << ADSC) | (1 << ADATE);
+	// ADEN: setting this bit enables analog-to-digital conversion.
+	// ADSC: setting this bit starts the first conversion.
+	// ADATE: setting this bit enables auto-triggering (Free Running Mode).
+}
+
+// Shows a product's name on the bottom row as <NAME>
+void LCD_DisplayProduct(unsigned char slot) {
+	char name[CATALOG_NAME_LENGTH + 1];
+
+	Catalog_Name(slot, name);
+	LCDBuf_WriteChar(17, '<');
+	LCDBuf_WriteString(18, name);
+	LCDBuf_WriteChar(18 + strlen(name), '>');
+}
+
 // NOTE: This function will fail to display values greater than or equal to $10
 void LCD_DisplayCoins(unsigned char coinCnt) {
 	// First position: Column 11
@@ -55,32 +122,48 @@ void LCD_DisplayCoins(unsigned char coinCnt) {
 	unsigned char cents = (coinCnt % 4) * 25; // Modulus gives how many quarters if  
 											// not rounded to whole dollar
 	
-	LCD_Cursor(11);
-	LCD_WriteData('0' + dollars);		// Writes dollar val
-	LCD_WriteData('.');					// Decimal pt
-	LCD_WriteData('0' + (cents / 10));	// 10's place of cents
-	LCD_WriteData('0' + (cents % 10));	// 1's place of cents
+	LCDBuf_WriteChar(11, '0' + dollars);		// Writes dollar val
+	LCDBuf_WriteChar(12, '.');					// Decimal pt
+	LCDBuf_WriteChar(13, '0' + (cents / 10));	// 10's place of cents
+	LCDBuf_WriteChar(14, '0' + (cents % 10));	// 1's place of cents
 }
 
 /************************* Global Variables *************************/
 unsigned char currentCoins = 0;
-unsigned char productValid = 0;
-unsigned char motorRunning = 0;
-const unsigned short PHASES_TO_DISPENSE = (360/11.25)*64;
-const unsigned char PRICE1 = 1;
-const unsigned char PRICE2 = 2;
-const unsigned char sequence1[4] = {0x30,0x60,0xC0,0x90}; // Full-step drive on upper nibble
-const unsigned char sequence2[4] = {0x03,0x06,0x0C,0x09}; // Full-step drive on lower nibble
+enum ProductStatus {PS_NONE,PS_NOFUNDS,PS_DISPENSING};
+unsigned char productStatus = PS_NONE;	// Outcome of the last selection, for LCD_Logic
+unsigned char productSlot;				// Slot productStatus is about
+unsigned char motorRunning = 0; // Dispenses queued or running
+LedgerState machine;			// Sales and dispenses in progress, kept in EEPROM with currentCoins
+Link link;
+xQueueHandle linkRxQueue;	// Link -> Product_Output (LinkMsg)
+xQueueHandle dispenseOrders[STEPPER_MOTORS];	// Product_Output -> Dispense_Controller (DispenseOrder), per motor
+CoinDetector dropBeams[STEPPER_MOTORS];		// IR drop beam under each coil
+unsigned char dcMoveDone[STEPPER_MOTORS];	// Set when the motor's move has run
+const unsigned short PHASES_TO_DISPENSE = (360/11.25)*64; // Full steps
+const unsigned short RETRY_PHASES = PHASES_TO_DISPENSE / 2; // Extra turn when nothing fell
+const unsigned char MAX_RETRIES = 1;
+// Motor 0 is on PB4-PB7 with its beam on ADC0, motor 1 on PB0-PB3 and ADC1
+// (see stepper.h)
+#define DC_ORDERS 4	// Orders that can wait per motor
+
+typedef struct _DispenseOrder
+{
+	unsigned short tag;		// Tick of the purchase
+	unsigned char slot;		// Product bought
+} DispenseOrder;
 
 /************************* State Machines *************************/
 
-enum SDState {SD_INIT,SD_PROCESS,SD_DRIVE1,SD_DRIVE2,SD_FINISH} sd_state;
-enum LCDState {LCD_INIT,LCD_WELCOME,LCD_COINCNT,LCD_DISPENSE1,LCD_DISPENSE2,
-				LCD_INSUFFICIENT,LCD_THANKYOU} lcd_state;
+enum DCState {DC_INIT,DC_IDLE,DC_TURN,DC_FINISH} dc_state[2];
+enum LCDState {LCD_INIT,LCD_WELCOME,LCD_COINCNT,LCD_DISPENSE,LCD_INSUFFICIENT,
+				LCD_THANKYOU} lcd_state;
 enum POState {PO_INIT,PO_RECEIVE} po_state;
 
-void SD_Init(){
-	sd_state = SD_INIT;
+void DC_Init(){
+	unsigned char motor;
+	for (motor = 0; motor < STEPPER_MOTORS; motor++)
+		dc_state[motor] = DC_INIT;
 }
 
 void LCD_Init(){
@@ -91,83 +174,113 @@ void PO_Init(){
 	po_state = PO_INIT;
 }
 
-void SD_Tick(){
+// Hands the credit, sales and dispenses in progress to Ledger_Task to record
+// machine is passed, not copied: it grows with CATALOG_SLOTS and both
+// callers run on small stacks. Ledger_Save copies it in one critical section
+void Machine_Save(){
+	portENTER_CRITICAL(); // Dispense_Controller and Product_Output both change them
+	machine.coins = currentCoins;
+	portEXIT_CRITICAL();
+	Ledger_Save(&machine);
+}
+
+// Queues a message for the first microcontroller, waiting for room
+void UC1_Send(unsigned char type, const unsigned char* data, unsigned char len){
+	// The link resends until uC1 answers, so its queue only fills while
+	// uC1 is down; wait it out rather than lose a result or a refund
+	while (!Link_Send(&link, type, data, len)) {
+		vTaskDelay(1);
+	}
+}
+
+void DC_Tick(unsigned char motor, const volatile unsigned short* samples){
 	//Local vars
-	static unsigned char stepperOut, pos1, pos2;
-	static unsigned short motorCount;
+	static DispenseOrder order[STEPPER_MOTORS];
+	static unsigned short drops[STEPPER_MOTORS];
+	static unsigned char retries[STEPPER_MOTORS];
+	CoinDetector* beam = &dropBeams[motor];
+	unsigned short elapsed;
+	unsigned char i, result[4];
 	//Actions
-	switch(sd_state){
-		case SD_INIT:
-			motorRunning = 0;
-			stepperOut = 0;
-			motorCount = 0;
-			pos1 = 0;
-			pos2 = 0;
-			break;
-		case SD_PROCESS:
+	if (dc_state[motor] != DC_INIT) {
+		// Watched in every state so the beam's idle level keeps being tracked
+		for (i = motor; i < ADC_BLOCK_SIZE; i += ADC_CHANNELS) {
+			CoinDetector_Feed(beam, samples[i]);
+		}
+	}
+	switch(dc_state[motor]){
+		case DC_INIT:
+			// Beam is assumed unblocked at power up
+			CoinDetector_Init(beam, samples[motor]);
 			break;
-		case SD_DRIVE1:
-			motorRunning = 1;
-			stepperOut = sequence1[pos1];
-			if (pos1 < 3)
-				pos1++;
-			else
-				pos1 = 0;
+		case DC_IDLE:
 			break;
-		case SD_DRIVE2:
-			motorRunning = 1;
-			stepperOut = sequence2[pos2];
-			if (pos2 < 3)
-				pos2++;
-			else
-				pos2 = 0;
+		case DC_TURN:
+			if (beam->coinCount != drops[motor])
+				Stepper_Stop(motor); // Item fell: no need to finish the turn
 			break;
-		case SD_FINISH:
-			motorRunning = 0;
-			productValid = 0; // Need to clear for rest of state machines (handshake)
+		case DC_FINISH:
+			portENTER_CRITICAL();
+			if (!--motorRunning)
+				productStatus = PS_NONE; // Need to clear for rest of state machines (handshake)
+			machine.pending[order[motor].slot - 1]--;
+			portEXIT_CRITICAL();
+			elapsed = xTaskGetTickCount() - order[motor].tag; // 1 ms ticks since the purchase
+			result[0] = order[motor].slot;
+			result[1] = LINK_DISPENSE_OK;
+			result[2] = elapsed >> 8;
+			result[3] = elapsed & 0xFF;
+			if (beam->coinCount == drops[motor]) {
+				// Jammed: give the money back
+				result[1] = LINK_DISPENSE_JAMMED;
+				portENTER_CRITICAL(); // Product_Output spends it too
+				currentCoins += Catalog_Price(order[motor].slot);
+				machine.refunds++;
+				portEXIT_CRITICAL();
+			} else {
+				machine.sold[order[motor].slot - 1]++;
+			}
+			Machine_Save();
+			UC1_Send(LINK_DISPENSE_RESULT, result, sizeof(result));
+			if (result[1] == LINK_DISPENSE_JAMMED)
+				UC1_Send(LINK_BALANCE, &currentCoins, 1);
 			break;
 		default:
 			break;
 	}
 
-	PORTB = stepperOut;
-
 	//Transitions
-	switch(sd_state){
-		case SD_INIT:
-			sd_state = SD_PROCESS;
-			break;
-		case SD_PROCESS:
-			if (productValid == 0 || productValid == 2 || productValid == 4)
-				sd_state = SD_PROCESS;
-			else if (productValid == 3)
-				sd_state = SD_DRIVE1;
-			else if (productValid == 5)
-				sd_state = SD_DRIVE2;
+	switch(dc_state[motor]){
+		case DC_INIT:
+			dc_state[motor] = DC_IDLE;
 			break;
-		case SD_DRIVE1:
-			if (motorCount < PHASES_TO_DISPENSE) {
-				sd_state = SD_DRIVE1;
-				motorCount++;
-			} else {
-				sd_state = SD_FINISH;
-				motorCount = 0;
+		case DC_IDLE:
+			if (xQueueReceive(dispenseOrders[motor], &order[motor], 0) == pdPASS) {
+				dc_state[motor] = DC_TURN;
+				drops[motor] = beam->coinCount;
+				retries[motor] = 0;
+				dcMoveDone[motor] = 0;
+				Stepper_Move(motor, STEPPER_FULL, STEPPER_FORWARD, PHASES_TO_DISPENSE, order[motor].tag, portMAX_DELAY);
 			}
 			break;
-		case SD_DRIVE2:
-			if (motorCount < PHASES_TO_DISPENSE) {
-				sd_state = SD_DRIVE2;
-				motorCount++;
+		case DC_TURN:
+			if (!dcMoveDone[motor]) {
+				dc_state[motor] = DC_TURN;
+			} else if (beam->coinCount != drops[motor] || retries[motor] >= MAX_RETRIES) {
+				dc_state[motor] = DC_FINISH;
 			} else {
-				sd_state = SD_FINISH;
-				motorCount = 0;
+				// Nothing fell: turn a bit further
+				dc_state[motor] = DC_TURN;
+				retries[motor]++;
+				dcMoveDone[motor] = 0;
+				Stepper_Move(motor, STEPPER_FULL, STEPPER_FORWARD, RETRY_PHASES, order[motor].tag, portMAX_DELAY);
 			}
 			break;
-		case SD_FINISH:
-			sd_state = SD_PROCESS;
+		case DC_FINISH:
+			dc_state[motor] = DC_IDLE;
 			break;
 		default:
-			sd_state = SD_INIT;
+			dc_state[motor] = DC_INIT;
 			break;
 	}
 }
@@ -187,8 +300,6 @@ void LCD_Tick(){
 			// First part of message written on transition
 			LCD_DisplayCoins(currentCoins);
 			break;
-		case LCD_DISPENSE1:
-			break;
 		default:
 			break;
 	}
@@ -196,8 +307,8 @@ void LCD_Tick(){
 	switch(lcd_state){
 		case LCD_INIT:
 			lcd_state = LCD_WELCOME;
-			LCD_DisplayString(1, "Welcome to ");
-			LCD_AppendString(17, "MiniVendi!");
+			LCDBuf_DisplayString(1, "Welcome to ");
+			LCDBuf_WriteString(17, "MiniVendi!");
 			break;
 		case LCD_WELCOME:
 			if (timer < 40) {
@@ -206,42 +317,29 @@ void LCD_Tick(){
 			} else {
 				lcd_state = LCD_COINCNT;
 				timer = 0;
-				LCD_DisplayString(1, "Balance: $");
+				LCDBuf_DisplayString(1, "Balance: $");
 			}
 			break;
 		case LCD_COINCNT:
-			if (productValid == 0x03) {
-				lcd_state = LCD_DISPENSE1;
-				LCD_DisplayString(1, "Dispensing");
-				LCD_AppendString(17, "<PRODUCT1>");
-			} else if (productValid == 0x05) {
-				lcd_state = LCD_DISPENSE2;
-				LCD_DisplayString(1, "Dispensing");
-				LCD_AppendString(17, "<PRODUCT2>");
-			} else if (productValid == 0x02 || productValid == 0x04) {
+			if (productStatus == PS_DISPENSING) {
+				lcd_state = LCD_DISPENSE;
+				LCDBuf_DisplayString(1, "Dispensing");
+				LCD_DisplayProduct(productSlot);
+			} else if (productStatus == PS_NOFUNDS) {
 				lcd_state = LCD_INSUFFICIENT;
-				LCD_DisplayString(1, "INSUFFICIENT");
-				LCD_AppendString(17, "FUNDS");
+				LCDBuf_DisplayString(1, "INSUFFICIENT");
+				LCDBuf_WriteString(17, "FUNDS");
 			} else {
 				lcd_state = LCD_COINCNT;
 			}
 			break;
-		case LCD_DISPENSE1:
+		case LCD_DISPENSE:
 			if (motorRunning) {
-				lcd_state = LCD_DISPENSE1;
+				lcd_state = LCD_DISPENSE;
 			} else {
 				lcd_state = LCD_THANKYOU;
-				LCD_DisplayString(1, "THANK YOU FOR");
-				LCD_AppendString(17, "YOUR PURCHASE!");
-			}
-			break;
-		case LCD_DISPENSE2:
-			if (motorRunning) {
-				lcd_state = LCD_DISPENSE2;
-			} else {
-				lcd_state = LCD_THANKYOU;
-				LCD_DisplayString(1, "THANK YOU FOR");
-				LCD_AppendString(17, "YOUR PURCHASE!");
+				LCDBuf_DisplayString(1, "THANK YOU FOR");
+				LCDBuf_WriteString(17, "YOUR PURCHASE!");
 			}
 			break;
 		case LCD_INSUFFICIENT:
@@ -251,8 +349,8 @@ void LCD_Tick(){
 			} else {
 				lcd_state = LCD_COINCNT;
 				timer = 0;
-				productValid = 0; // Reset from this state
-				LCD_DisplayString(1, "Balance: $");
+				productStatus = PS_NONE; // Reset from this state
+				LCDBuf_DisplayString(1, "Balance: $");
 			}
 			break;
 		case LCD_THANKYOU:
@@ -262,7 +360,7 @@ void LCD_Tick(){
 			} else {
 				lcd_state = LCD_COINCNT;
 				timer = 0;
-				LCD_DisplayString(1, "Balance: $");
+				LCDBuf_DisplayString(1, "Balance: $");
 			}
 			break;
 		default:
@@ -271,36 +369,84 @@ void LCD_Tick(){
 	}
 }
 
+// Hands messages from the link to Product_Output; runs in LinkSecTask
+void PO_Deliver(const LinkMsg* msg){
+	xQueueSend(linkRxQueue, msg, 0);
+}
+
+// Queues a dispense order for the slot's motor; 0 if its queue is full
+unsigned char PO_Dispense(unsigned char slot){
+	DispenseOrder order;
+
+	order.tag = xTaskGetTickCount();
+	order.slot = slot;
+	if (xQueueSend(dispenseOrders[Catalog_Motor(slot)], &order, 0) != pdPASS)
+		return 0;
+	portENTER_CRITICAL();
+	motorRunning++;
+	machine.pending[slot - 1]++;
+	portEXIT_CRITICAL();
+	SIM_PROBE(SIM_PROBE_DISPENSE);
+	return 1;
+}
+
+// Buys one product of an order if there is money and room for it
+void PO_Select(unsigned char slot){
+	unsigned char price = Catalog_Price(slot);
+	unsigned char result[4];
+
+	if (!price)
+		return; // No such product
+	result[0] = slot;
+	result[2] = result[3] = 0;
+	if (currentCoins < price) {
+		productStatus = PS_NOFUNDS;
+		productSlot = slot;
+		result[1] = LINK_DISPENSE_INSUFFICIENT;
+	} else if (PO_Dispense(slot)) {
+		productStatus = PS_DISPENSING;
+		productSlot = slot;
+		currentCoins -= price;
+		return;
+	} else {
+		result[1] = LINK_DISPENSE_BUSY;
+	}
+	UC1_Send(LINK_DISPENSE_RESULT, result, sizeof(result));
+}
+
 void PO_Tick(){
 	//Local variables
-	static unsigned char receivedControl;
+	LinkMsg msg;
+	unsigned char reply[2];
+	unsigned char i;
 	//Actions
 	switch(po_state){
 		case PO_INIT:
-			receivedControl = 0;
 			break;
 		case PO_RECEIVE:
-			if(USART_HasReceived(1)) {
-				receivedControl = USART_Receive(1);
-				if (receivedControl & 0x01) // Received coin
-					currentCoins++;
-				if (receivedControl & 0x02) { // Selected Product1
-					if (currentCoins >= PRICE1) {
-						productValid = 0x03; // Product1 valid to dispense
-						currentCoins -= PRICE1;
-					} else {
-						productValid = 0x02; // Product1 not valid to dispense
-					}
-				} else if (receivedControl & 0x04) { // Selected Product2
-					if (currentCoins >= PRICE2) {
-						productValid = 0x05; // Product2 valid to dispense
-						currentCoins -= PRICE2;
-					} else {
-						productValid = 0x04; // Product2 not valid to dispense
-					}
-				}
-				receivedControl = 0;
+			if (xQueueReceive(linkRxQueue, &msg, 0) != pdPASS)
+				break;
+			if (msg.type == LINK_COIN_INSERTED) { // Received coin
+				currentCoins++;
+				SIM_PROBE(SIM_PROBE_CREDIT);
+			} else if (msg.type == LINK_SELECTION) { // Selected products, in order
+				for (i = 0; i < msg.len; i++)
+					PO_Select(msg.data[i]);
+			} else if (msg.type == LINK_STATUS_REQUEST) {
+				reply[0] = currentCoins;
+				reply[1] = motorRunning;
+				UC1_Send(LINK_STATUS, reply, 2);
+				break;
+			} else if (msg.type == LINK_PRICE_REQUEST) {
+				reply[0] = msg.data[0];
+				reply[1] = Catalog_Price(msg.data[0]);
+				UC1_Send(LINK_PRICE, reply, 2);
+				break;
+			} else {
+				break;
 			}
+			Machine_Save();
+			UC1_Send(LINK_BALANCE, &currentCoins, 1);
 			break;
 		default:
 			break;
@@ -320,55 +466,100 @@ void PO_Tick(){
 }
 
 
-void StepperSecTask()
+void DispenseSecTask()
 {
-	SD_Init();
-	for(;;) 
-	{ 	
-		SD_Tick();
-		vTaskDelay(3); 
-	} 
-}
+	const volatile unsigned short* samples;
+	StepperMove done;
+	unsigned char motor;
 
-void LCDSecTask()
-{
-	LCD_Init();
+	DC_Init();
 	for(;;)
 	{
-		LCD_Tick();
-		vTaskDelay(50);
+		// Sleep until the ADC ISR has filled a block
+		samples = ADC_WaitForBlock(portMAX_DELAY);
+		if (samples) {
+			while (Stepper_WaitDone(&done, 0) == pdTRUE) {
+				dcMoveDone[done.motor] = 1;
+			}
+			for (motor = 0; motor < STEPPER_MOTORS; motor++)
+				DC_Tick(motor, samples);
+			ADC_ReleaseBlock();
+		}
 	}
 }
 
-void ProductOutputSecTask()
+// Periods and deadlines in ticks (ms)
+PeriodicTask periodicTable[] = {
+	PERIODIC_TASK("LCDSecTask", LCD_Init, LCD_Tick, 50, 50, configMINIMAL_STACK_SIZE * 2),
+	PERIODIC_TASK("ProductOutputSecTask", PO_Init, PO_Tick, 25, 25, configMINIMAL_STACK_SIZE * 2),
+};
+
+void LinkSecTask()
 {
-	PO_Init();
 	for(;;)
 	{
-		PO_Tick();
-		vTaskDelay(25);
+		Link_Service(&link); // Sleeps until there is link work to do
 	}
 }
 
-void StartSecPulse(unsigned portBASE_TYPE Priority)
+// Returns 1 if every task was created, 0 if the heap ran out
+unsigned char StartSecPulse(unsigned portBASE_TYPE Priority)
 {
-	xTaskCreate(StepperSecTask, (signed portCHAR *)"StepperSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
-	xTaskCreate(LCDSecTask, (signed portCHAR *)"LCDSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
-	xTaskCreate(ProductOutputSecTask, (signed portCHAR *)"ProductOutputSecTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
+	unsigned char created = 1;
+
+	// DC_Tick goes into UC1_Send, Stepper_Move and Ledger_Save
+	created &= xTaskCreate(DispenseSecTask, (signed portCHAR *)"DispenseSecTask", configMINIMAL_STACK_SIZE * 2, NULL, Priority, NULL ) == pdPASS;
+	created &= Periodic_Start(periodicTable, sizeof(periodicTable) / sizeof(periodicTable[0]), Priority);
+	created &= xTaskCreate(LinkSecTask, (signed portCHAR *)"LinkSecTask", configMINIMAL_STACK_SIZE * 2, NULL, Priority, NULL ) == pdPASS;
+	created &= xTaskCreate(LCDBuf_FlushTask, (signed portCHAR *)"LCDFlushTask", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL ) == pdPASS;
+	created &= xTaskCreate(Trace_StreamTask, (signed portCHAR *)"TraceTx", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL ) == pdPASS;
+	created &= xTaskCreate(Ledger_Task, (signed portCHAR *)"Ledger", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL ) == pdPASS;
+	return created;
 }	
  
 int main(void) 
 { 
-	DDRA = 0xFF; PORTA = 0x00; // LCD Control
+	unsigned char i, ready = 1;
+
+	DDRA = 0xFC; PORTA = 0x00; // LCD Control, ADC0-1 drop beams
 	DDRB = 0xFF; PORTB = 0x00; // For Steppers
 	DDRC = 0xFF; PORTC = 0x00; // LCD Data
 	DDRD = 0xFC; PORTD = 0x03; // USART input, SR for debugging
    
-	initUSART(1);
-	LCD_init();
+	Timing_Init();
+	ready &= USART_BufferedInit(0);
+	ready &= USART_BufferedInit(1);
+	Trace_Init(0);
+	ready &= Stepper_Init();
+	for (i = 0; i < STEPPER_MOTORS; i++) {
+		dispenseOrders[i] = xQueueCreate(DC_ORDERS, sizeof(DispenseOrder));
+		ready &= dispenseOrders[i] != NULL;
+	}
+	ADC_init();
+	ready &= ADC_SamplerInit();
+	// Short of heap (configTOTAL_HEAP_SIZE): do not run at all rather than
+	// run without a queue or a task
+	if (!ready || !Ledger_Init(&machine)) {
+		return 1;
+	}
+	// Dispenses a reset cut off never finished: give the money back
+	currentCoins = machine.coins;
+	for (i = 0; i < CATALOG_SLOTS; i++) {
+		currentCoins += machine.pending[i] * Catalog_Price(i + 1);
+		machine.refunds += machine.pending[i];
+		machine.pending[i] = 0;
+	}
+	machine.boots++;
+	Machine_Save();
+	linkRxQueue = xQueueCreate(4, sizeof(LinkMsg));
+	ready &= linkRxQueue != NULL;
+	ready &= Link_Init(&link, 1, PO_Deliver);
+	ready &= LCDBuf_Init();
 	
 	//Start Tasks  
-	StartSecPulse(1);
+	if (!ready || !StartSecPulse(1)) {
+		return 1;
+	}
 	//RunSchedular 
 	vTaskStartScheduler(); 
  